@@ -289,6 +289,8 @@ void AudioEngine::OnChangeModemClass()
 void AudioEngine::OnOpenOut()
 {
   EngineBase::OnOpenOut();
+
+  tonePlan = PString();
 }
 
 void AudioEngine::OnCloseOut()
@@ -309,6 +311,21 @@ void AudioEngine::OnChangeEnableFakeOut()
   (new FakeReadThread(*this))->Resume();
 }
 
+void AudioEngine::SetTonePlan(HOWNEROUT hOwner, const PString &plan)
+{
+  if (hOwnerOut != hOwner)
+    return;
+
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (hOwnerOut != hOwner)
+    return;
+
+  tonePlan = plan;
+
+  myPTRACE(3, name << " SetTonePlan " << tonePlan);
+}
+
 PBoolean AudioEngine::Read(HOWNEROUT hOwner, void * buffer, PINDEX amount)
 {
   if (hOwnerOut != hOwner || !IsModemOpen())
@@ -395,7 +412,7 @@ void AudioEngine::SendOnIdle(DataType _dataType)
   }
 
   if (pToneOut == NULL && toneType != ToneGenerator::ttSilence)
-    pToneOut = new ToneGenerator(toneType);
+    pToneOut = new ToneGenerator(toneType, tonePlan);
 }
 
 PBoolean AudioEngine::SendStart(DataType PTRACE_PARAM(_dataType), int PTRACE_PARAM(param))
@@ -410,7 +427,7 @@ PBoolean AudioEngine::SendStart(DataType PTRACE_PARAM(_dataType), int PTRACE_PAR
   if (sendAudio)
     delete sendAudio;
 
-  sendAudio = new DataStream(1024 * BYTES_PER_SIMPLE);
+  sendAudio = new RingStream(4 * 1024 * BYTES_PER_SIMPLE, 1024 * BYTES_PER_SIMPLE);
 
   PTRACE(3, name << " SendStart _dataType=" << _dataType
                  << " param=" << param);
@@ -425,8 +442,11 @@ int AudioEngine::Send(const void *pBuf, PINDEX count)
   if (!IsModemOpen())
     return -1;
 
-  PWaitAndSignal mutexWait(Mutex);
-
+  /*
+   * sendAudio is a single producer / single consumer ring and it's
+   * deleted by consumer only after SendStop(), so there is no need
+   * to lock Mutex here
+   */
   if (sendAudio)
     sendAudio->PutData(pBuf, count);
 
@@ -521,11 +541,15 @@ PBoolean AudioEngine::Write(HOWNERIN hOwner, const void * buffer, PINDEX len)
           return FALSE;
       }
 
-      if (t30ToneDetect && t30ToneDetect->Write(buffer, len)) {
-        OnUserInput('c');
+      if (t30ToneDetect) {
+        PString tones = t30ToneDetect->Write(buffer, len);
 
-        if (hOwnerIn != hOwner || !IsModemOpen())
-          return FALSE;
+        if (!tones.IsEmpty()) {
+          OnUserInput(tones);
+
+          if (hOwnerIn != hOwner || !IsModemOpen())
+            return FALSE;
+        }
       }
     } else {
       if (recvAudio && !recvAudio->isFull()) {
@@ -576,7 +600,7 @@ void AudioEngine::RecvOnIdle(DataType _dataType)
   }
 
   if (pToneIn == NULL && toneType != ToneGenerator::ttSilence)
-    pToneIn = new ToneGenerator(toneType);
+    pToneIn = new ToneGenerator(toneType, tonePlan);
 }
 
 PBoolean AudioEngine::RecvWait(DataType /*_dataType*/, int /*param*/, int /*_callbackParam*/, PBoolean &done)
@@ -591,7 +615,7 @@ PBoolean AudioEngine::RecvWait(DataType /*_dataType*/, int /*param*/, int /*_cal
   if (recvAudio)
     delete recvAudio;
 
-  recvAudio = new DataStream(1024 * BYTES_PER_SIMPLE);
+  recvAudio = new RingStream(4 * 1024 * BYTES_PER_SIMPLE, 1024 * BYTES_PER_SIMPLE);
 
   done = TRUE;
 
@@ -619,12 +643,17 @@ int AudioEngine::Recv(void * pBuf, PINDEX count)
 {
   PWaitAndSignal mutexWaitModem(MutexModem);
 
-  if (!recvAudio)
-    return -1;
+  /*
+   * recvAudio is a single producer / single consumer ring and it's
+   * created and deleted under MutexModem only, so there is no need
+   * to lock Mutex here
+   */
+  RingStream *audio = recvAudio;
 
-  PWaitAndSignal mutexWait(Mutex);
+  if (!audio)
+    return -1;
 
-  return recvAudio->GetData(pBuf, count);
+  return audio->GetData(pBuf, count);
 }
 
 void AudioEngine::RecvStop()
@@ -59,11 +59,11 @@
 #ifndef _PM_AUDIO_H
 #define _PM_AUDIO_H
 
-#include <ptclib/delaychan.h>
 #include "enginebase.h"
+#include "mediaclock.h"
 
 ///////////////////////////////////////////////////////////////
-class DataStream;
+class RingStream;
 class ToneGenerator;
 class T30ToneDetect;
 ///////////////////////////////////////////////////////////////
@@ -96,6 +96,10 @@ class AudioEngine : public EngineBase
     virtual void RecvStop();
   //@}
 
+    /**Set the tone plan (see ToneGenerator) for the next generated tones.
+      */
+    void SetTonePlan(HOWNEROUT hOwner, const PString &plan);
+
   protected:
 
     virtual void OnAttach();
@@ -109,17 +113,18 @@ class AudioEngine : public EngineBase
     virtual void OnChangeEnableFakeIn();
     virtual void OnChangeEnableFakeOut();
 
-    PAdaptiveDelay readDelay;
-    PAdaptiveDelay writeDelay;
+    MediaDelay readDelay;
+    MediaDelay writeDelay;
 
     int callbackParam;
 
-    DataStream *volatile sendAudio;
-    DataStream *volatile recvAudio;
+    RingStream *volatile sendAudio;
+    RingStream *volatile recvAudio;
 
     ToneGenerator *volatile pToneIn;
     ToneGenerator *volatile pToneOut;
     T30ToneDetect *volatile t30ToneDetect;
+    PString tonePlan;
 };
 ///////////////////////////////////////////////////////////////
 
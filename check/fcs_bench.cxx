@@ -0,0 +1,159 @@
+/*
+ * fcs_bench.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Speed of FCS::build() and of the previous bitwise code.
+ *
+ * Usage: fcs_bench
+ *
+ * Builds the FCS of the random buffers of several sizes by FCS and
+ * by the previous bitwise code, compares the results and reports the
+ * speed of both in MB/s.
+ */
+
+#include <ptlib.h>
+#include "../fcs.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+/*
+ * The previous bitwise FCS (see fcs_check.cxx)
+ */
+class OldFCS
+{
+  public:
+    OldFCS() : fcs(0xFFFF) {}
+
+    void build(const void *pBuf, PINDEX count);
+    operator WORD() const { return WORD(~fcs); }
+
+  protected:
+
+    DWORD fcs;
+};
+
+void OldFCS::build(const void *_pBuf, PINDEX count)
+{
+  const BYTE *pBuf = (const BYTE *)_pBuf;
+
+  for (PINDEX i = 0 ; i < count ; i++) {
+    BYTE c = *(pBuf++);
+    for (BYTE m = 0x80 ; m ; m >>= 1) {
+	fcs <<= 1;
+        if (c & m)
+	  fcs ^= 0x10000;
+	if (fcs & 0x10000)
+          fcs ^= 0x11021;
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+enum {
+  maxBufSize = 4096,
+  benchTime = 300,    // ms
+};
+
+static BYTE buf[maxBufSize];
+
+/*
+ * Returns MB/s
+ */
+template <class F> static double Bench(PINDEX size)
+{
+  // the FCS of each buffer depends on the previous ones
+  F fcs;
+  PINDEX batch = 16;
+  PInt64 bytes = 0;
+  PInt64 elapsed = 0;
+
+  while (elapsed < benchTime) {
+    PTimeInterval start = PTimer::Tick();
+
+    for (PINDEX n = 0 ; n < batch ; n++)
+      fcs.build(buf, size);
+
+    elapsed += (PTimer::Tick() - start).GetMilliSeconds();
+    bytes += PInt64(batch)*size;
+    batch *= 2;
+  }
+
+  return elapsed ? double(bytes)/1000/elapsed : 0;
+}
+///////////////////////////////////////////////////////////////
+class FcsBench : public PProcess
+{
+  PCLASSINFO(FcsBench, PProcess)
+
+  public:
+    FcsBench() : PProcess("Frolov,Holtschneider,Davidson", "fcs_bench") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(FcsBench);
+
+void FcsBench::Main()
+{
+  static const PINDEX sizes[] = { 3, 16, 64, 256, maxBufSize };
+
+  unsigned randomState = 1;
+
+  for (PINDEX i = 0 ; i < maxBufSize ; i++) {
+    // xorshift32
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+
+    buf[i] = BYTE(randomState);
+  }
+
+  unsigned failed = 0;
+
+  cout << "fcs_bench: MB/s (FCS / bitwise)" << endl;
+
+  for (PINDEX s = 0 ; s < PINDEX(PARRAYSIZE(sizes)) ; s++) {
+    FCS fcs;
+    OldFCS fcsOld;
+
+    fcs.build(buf, sizes[s]);
+    fcsOld.build(buf, sizes[s]);
+
+    PBoolean ok = (WORD)fcs == (WORD)fcsOld;
+
+    if (!ok)
+      failed++;
+
+    double mbNew = Bench<FCS>(sizes[s]);
+    double mbOld = Bench<OldFCS>(sizes[s]);
+
+    cout << "  " << sizes[s] << " bytes: "
+         << (ok ? "OK, " : "FAILED, ")
+         << mbNew << " / " << mbOld << endl;
+  }
+
+  SetTerminationValue(failed ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,196 @@
+/*
+ * fcs_check.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * FCS::build() against the previous bitwise code.
+ *
+ * Usage: fcs_check [count [seed]]
+ *
+ * Checks the FCS of "123456789" (0xD64E) and builds the FCS of count
+ * (10000 by default) random buffers fed by random splits and compares
+ * it with the FCS built by the previous bitwise code from the whole
+ * buffer.
+ */
+
+#include <ptlib.h>
+#include "../fcs.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+/*
+ * The previous bitwise FCS
+ */
+class OldFCS
+{
+  public:
+    OldFCS() : fcs(0xFFFF) {}
+
+    void build(const void *pBuf, PINDEX count);
+    operator WORD() const { return WORD(~fcs); }
+
+  protected:
+
+    DWORD fcs;
+};
+
+void OldFCS::build(const void *_pBuf, PINDEX count)
+{
+  const BYTE *pBuf = (const BYTE *)_pBuf;
+
+  for (PINDEX i = 0 ; i < count ; i++) {
+    BYTE c = *(pBuf++);
+    for (BYTE m = 0x80 ; m ; m >>= 1) {
+	fcs <<= 1;
+        if (c & m)
+	  fcs ^= 0x10000;
+	if (fcs & 0x10000)
+          fcs ^= 0x11021;
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+enum {
+  maxBufSize = 2048,
+  checkValue = 0xD64E,    // "123456789"
+};
+
+static unsigned randomState = 1;
+
+static unsigned Random(unsigned range)
+{
+  // xorshift32
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return randomState % range;
+}
+
+/*
+ * Returns the count of mismatches
+ */
+static unsigned CheckValue()
+{
+  unsigned failed = 0;
+  FCS fcs;
+  OldFCS fcsOld;
+
+  fcs.build("123456789", 9);
+  fcsOld.build("123456789", 9);
+
+  if ((WORD)fcs != checkValue) {
+    failed++;
+    cout << "FCS(\"123456789\") = " << hex << (WORD)fcs << " != " << checkValue << dec << endl;
+  }
+
+  if ((WORD)fcsOld != checkValue) {
+    failed++;
+    cout << "old FCS(\"123456789\") = " << hex << (WORD)fcsOld << " != " << checkValue << dec << endl;
+  }
+
+  return failed;
+}
+
+/*
+ * Returns the count of mismatches
+ */
+static unsigned CheckRandom(unsigned count)
+{
+  static BYTE buf[maxBufSize];
+  unsigned failed = 0;
+
+  for (unsigned n = 0 ; n < count ; n++) {
+    PINDEX size = Random(maxBufSize + 1);
+
+    for (PINDEX i = 0 ; i < size ; i++)
+      buf[i] = (BYTE)Random(256);
+
+    FCS fcs;
+    PINDEX done = 0;
+    PINDEX maxSplit = 1 + Random(32);
+
+    while (done < size) {
+      PINDEX len = Random(maxSplit + 1);
+
+      if (len > size - done)
+        len = size - done;
+
+      fcs.build(buf + done, len);
+      done += len;
+    }
+
+    OldFCS fcsOld;
+
+    fcsOld.build(buf, size);
+
+    if ((WORD)fcs != (WORD)fcsOld && failed++ < 8) {
+      cout << "buffer " << n << " (" << size << " bytes): FCS " << hex
+           << (WORD)fcs << " != " << (WORD)fcsOld << dec << endl;
+    }
+  }
+
+  return failed;
+}
+///////////////////////////////////////////////////////////////
+class FcsCheck : public PProcess
+{
+  PCLASSINFO(FcsCheck, PProcess)
+
+  public:
+    FcsCheck() : PProcess("Frolov,Holtschneider,Davidson", "fcs_check") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(FcsCheck);
+
+void FcsCheck::Main()
+{
+  PArgList &args = GetArguments();
+  unsigned count = args.GetCount() > 0 ? args[0].AsUnsigned() : 10000;
+
+  if (args.GetCount() > 1)
+    randomState = args[1].AsUnsigned();
+
+  if (!randomState)
+    randomState = 1;
+
+  cout << "fcs_check: count=" << count << " seed=" << randomState << endl;
+
+  unsigned failed;
+  unsigned failedTotal = 0;
+
+  failed = CheckValue();
+  cout << "check value: " << (failed ? "FAILED " : "OK ") << failed << endl;
+  failedTotal += failed;
+
+  failed = CheckRandom(count);
+  cout << "random:      " << (failed ? "FAILED " : "OK ") << failed << endl;
+  failedTotal += failed;
+
+  SetTerminationValue(failedTotal ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
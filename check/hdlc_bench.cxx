@@ -0,0 +1,351 @@
+/*
+ * hdlc_bench.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * HDLC framer against the previous bit-serial one.
+ *
+ * Usage: hdlc_bench [seed]
+ *
+ * Frames the random data, all ones and flag-like data (HDLC data to
+ * raw data with the bit stuffing, FCS and flags) by HDLC and by the
+ * previous bit-serial code of HDLC::pack(), compares the raw output
+ * bit by bit and measures the speed of both.
+ */
+
+#include <ptlib.h>
+#include "../pmutils.h"
+#include "../hdlc.h"
+#include "../enginebase.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+/*
+ * The previous bit-serial HDLC framer (HDLC data to raw data only)
+ */
+class OldHDLC
+{
+  public:
+    OldHDLC() : inData(NULL), rawByteLen(0), rawOnes(0) {}
+
+    void PutHdlcData(DataStream *_inData) { inData = _inData; }
+
+    void GetRawStart(PINDEX flags)
+    {
+      outData.Clean();
+      fcs = FCS();
+      while (flags--)
+        pack("\x7e", 1, TRUE);
+    }
+
+    int GetData(void *pBuf, PINDEX count);
+
+  private:
+    void pack(const void *pBuf, PINDEX count, PBoolean flag = FALSE);
+
+    DataStream *inData;
+    DataStream outData;
+    FCS fcs;
+
+    BYTE rawByte;
+    int rawByteLen;
+    int rawOnes;
+};
+
+void OldHDLC::pack(const void *_pBuf, PINDEX count, PBoolean flag)
+{
+  WORD w = WORD((WORD)rawByte << 8);
+  const BYTE *pBuf = (const BYTE *)_pBuf;
+
+  for (PINDEX i = 0 ; i < count ; i++) {
+    w |= *(pBuf++) & 0xFF;
+    for (PINDEX j = 0 ; j < 8 ; j++) {
+      w <<= 1;
+
+      if (++rawByteLen == 8) {
+        rawByte = BYTE(w >> 8);
+        outData.PutData(&rawByte, 1);
+        rawByteLen = 0;
+      }
+
+      if (!flag) {
+        if (w & 0x100) {
+          if (++rawOnes == 5) {
+            w = WORD((w & 0xFF00) << 1 | (w & 0xFF));
+
+            if (++rawByteLen == 8) {
+              rawByte = BYTE(w >> 8);
+              outData.PutData(&rawByte, 1);
+              rawByteLen = 0;
+            }
+            rawOnes = 0;
+          }
+        }
+        else
+          rawOnes = 0;
+      }
+    }
+  }
+  rawByte = BYTE(w >> 8);
+  if (flag)
+    rawOnes = 0;
+}
+
+int OldHDLC::GetData(void *_pBuf, PINDEX count)
+{
+  BYTE *pBuf = (BYTE *)_pBuf;
+  int outLen = outData.GetData(pBuf, count);
+
+  if (outLen < 0)
+    return -1;
+
+  int len = 0;
+
+  if (outLen > 0) {
+    pBuf += outLen;
+    count -= outLen;
+    len += outLen;
+  }
+
+  do {
+    if (inData) {
+      BYTE Buf[256];
+      int inLen = inData->GetData(Buf, sizeof(Buf));
+
+      if (inLen < 0) {
+        Buf[0] = BYTE(fcs >> 8);
+        Buf[1] = BYTE(fcs & 0xFF);
+        if (inData->GetDiag() & EngineBase::diagErrorMask)
+          Buf[0]++;
+        pack(Buf, 2);
+        pack("\x7e\x7e", 2, TRUE);
+        outData.PutEof();
+        inData = NULL;
+      }
+      else
+      if (inLen > 0) {
+        fcs.build(Buf, inLen);
+        pack(Buf, inLen);
+      }
+      else
+        break;
+    }
+
+    int outLen = outData.GetData(pBuf, count);
+
+    if (outLen < 0) {
+      if (len > 0)
+        break;
+      return -1;
+    }
+    else
+    if (outLen > 0) {
+      pBuf += outLen;
+      count -= outLen;
+      len += outLen;
+    }
+  } while (count);
+
+  return len;
+}
+///////////////////////////////////////////////////////////////
+enum {
+  maxFrameSize = 300,
+  maxRawSize = (maxFrameSize + 2)*10/8 + 8*4,
+  benchFrameSize = 256,
+  benchTime = 300,    // ms
+};
+
+static unsigned randomState = 1;
+
+static unsigned Random(unsigned range)
+{
+  // xorshift32
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return randomState % range;
+}
+
+/*
+ * Frames the data and returns the length of the raw data or -1
+ */
+template <class H> static int Frame(H &hdlc, const BYTE *data, PINDEX size, PINDEX flags, BYTE *raw, PINDEX chunk)
+{
+  DataStream inData;
+
+  inData.PutData(data, size);
+  inData.PutEof();
+
+  hdlc.PutHdlcData(&inData);
+  hdlc.GetRawStart(flags);
+
+  int rawLen = 0;
+
+  for (;;) {
+    PINDEX count = maxRawSize - rawLen;
+
+    if (count > chunk)
+      count = chunk;
+
+    if (count == 0)
+      return -1;
+
+    int len = hdlc.GetData(raw + rawLen, count);
+
+    if (len < 0)
+      break;
+
+    if (len == 0)
+      return -1;
+
+    rawLen += len;
+  }
+
+  return rawLen;
+}
+
+/*
+ * Returns the count of mismatches
+ */
+static unsigned Check(const char *name, unsigned frames, BYTE (*fill)(PINDEX))
+{
+  static BYTE data[maxFrameSize];
+  static BYTE raw[maxRawSize];
+  static BYTE rawOld[maxRawSize];
+  unsigned failed = 0;
+
+  // the state is kept between the frames
+  HDLC hdlc;
+  OldHDLC hdlcOld;
+
+  for (unsigned n = 0 ; n < frames ; n++) {
+    PINDEX size = 1 + Random(maxFrameSize);
+    PINDEX flags = Random(4);
+    PINDEX chunk = 1 + Random(64);
+
+    for (PINDEX i = 0 ; i < size ; i++)
+      data[i] = fill(i);
+
+    int len = Frame(hdlc, data, size, flags, raw, chunk);
+    int lenOld = Frame(hdlcOld, data, size, flags, rawOld, chunk);
+
+    if (len < 0 || len != lenOld || memcmp(raw, rawOld, len) != 0) {
+      if (failed++ < 8)
+        cout << name << " frame " << n << " (" << size << " bytes): raw " << len << " != " << lenOld << " bytes or differs" << endl;
+    }
+  }
+
+  return failed;
+}
+
+static BYTE FillRandom(PINDEX) { return (BYTE)Random(256); }
+static BYTE FillOnes(PINDEX) { return 0xFF; }
+static BYTE FillFlags(PINDEX) { return 0x7E; }
+static BYTE FillMixed(PINDEX) { static const BYTE b[] = { 0x7E, 0x3F, 0xFC, 0x1F, 0xF8, 0xFF, 0x7F, 0xFE }; return b[Random(PARRAYSIZE(b))]; }
+
+/*
+ * Returns MB/s of the HDLC data
+ */
+template <class H> static double Bench(const BYTE *data)
+{
+  static BYTE raw[maxRawSize];
+  H hdlc;
+  PINDEX batch = 16;
+  PInt64 bytes = 0;
+  PInt64 elapsed = 0;
+
+  while (elapsed < benchTime) {
+    PTimeInterval start = PTimer::Tick();
+
+    for (PINDEX n = 0 ; n < batch ; n++)
+      Frame(hdlc, data, benchFrameSize, 1, raw, sizeof(raw));
+
+    elapsed += (PTimer::Tick() - start).GetMilliSeconds();
+    bytes += PInt64(batch)*benchFrameSize;
+    batch *= 2;
+  }
+
+  return elapsed ? double(bytes)/1000/elapsed : 0;
+}
+///////////////////////////////////////////////////////////////
+class HdlcBench : public PProcess
+{
+  PCLASSINFO(HdlcBench, PProcess)
+
+  public:
+    HdlcBench() : PProcess("Frolov,Holtschneider,Davidson", "hdlc_bench") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(HdlcBench);
+
+void HdlcBench::Main()
+{
+  static const struct {
+    const char *name;
+    BYTE (*fill)(PINDEX);
+  } inputs[] = {
+    { "random", FillRandom },
+    { "all ones", FillOnes },
+    { "flags", FillFlags },
+    { "mixed", FillMixed },
+  };
+
+  PArgList &args = GetArguments();
+
+  if (args.GetCount() > 0)
+    randomState = args[0].AsUnsigned();
+
+  if (!randomState)
+    randomState = 1;
+
+  cout << "hdlc_bench: seed=" << randomState << ", MB/s (HDLC / bit-serial)" << endl;
+
+  unsigned failedTotal = 0;
+
+  for (PINDEX i = 0 ; i < PINDEX(PARRAYSIZE(inputs)) ; i++) {
+    static BYTE data[benchFrameSize];
+
+    unsigned failed = Check(inputs[i].name, 1000, inputs[i].fill);
+
+    failedTotal += failed;
+
+    for (PINDEX j = 0 ; j < benchFrameSize ; j++)
+      data[j] = inputs[i].fill(j);
+
+    double mbNew = Bench<HDLC>(data);
+    double mbOld = Bench<OldHDLC>(data);
+
+    cout << "  " << inputs[i].name << ": "
+         << (failed ? "FAILED " : "OK ") << failed << ", "
+         << mbNew << " / " << mbOld << endl;
+  }
+
+  SetTerminationValue(failedTotal ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
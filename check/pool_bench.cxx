@@ -0,0 +1,276 @@
+/*
+ * pool_bench.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Multi-channel throughput of FreeListPool against the previous pool
+ * with one PMutex and against heap.
+ *
+ * Usage: pool_bench
+ *
+ * For 1, 4 and 16 channels runs a producer and a consumer thread per
+ * channel. The producer allocates ChunkStream sized blocks and passes
+ * them to the consumer through RingStream, the consumer frees them
+ * (the same as DataStream does with ChunkStream). Reports the total
+ * count of the allocated and freed blocks per microsecond and the
+ * statistics of FreeListPool (all blocks should be returned, used=0).
+ */
+
+#include <ptlib.h>
+#include "../pmutils.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+enum {
+  blockSize = sizeof(ChunkStream),
+  batchSize = 16,             // blocks passed at once
+  benchTime = 300,            // ms
+  maxChannels = 16,
+};
+///////////////////////////////////////////////////////////////
+class Allocator
+{
+  public:
+    virtual ~Allocator() {}
+
+    virtual void *Alloc() = 0;
+    virtual void Free(void *ptr) = 0;
+};
+
+static FreeListPool pool("bench", blockSize);
+
+class PoolAllocator : public Allocator
+{
+  public:
+    void *Alloc() { return pool.Alloc(blockSize); }
+    void Free(void *ptr) { pool.Free(ptr, blockSize); }
+};
+
+/*
+ * The previous pool with one PMutex
+ */
+class LockedAllocator : public Allocator
+{
+  public:
+    LockedAllocator() : freeBlocks(NULL) {}
+
+    ~LockedAllocator()
+    {
+      while (freeBlocks) {
+        Block *block = freeBlocks;
+
+        freeBlocks = block->next;
+        ::operator delete(block);
+      }
+    }
+
+    void *Alloc()
+    {
+      PWaitAndSignal mutexWait(mutex);
+
+      Block *block = freeBlocks;
+
+      if (block) {
+        freeBlocks = block->next;
+        return block;
+      }
+
+      return ::operator new(blockSize);
+    }
+
+    void Free(void *ptr)
+    {
+      PWaitAndSignal mutexWait(mutex);
+
+      Block *block = (Block *)ptr;
+
+      block->next = freeBlocks;
+      freeBlocks = block;
+    }
+
+  protected:
+    struct Block { Block *next; };
+
+    Block *freeBlocks;
+    PMutex mutex;
+};
+
+class HeapAllocator : public Allocator
+{
+  public:
+    void *Alloc() { return ::operator new(blockSize); }
+    void Free(void *ptr) { ::operator delete(ptr); }
+};
+///////////////////////////////////////////////////////////////
+class Producer : public PThread
+{
+    PCLASSINFO(Producer, PThread);
+  public:
+    Producer(Allocator &_allocator, DataStream &_stream, volatile PBoolean &_stop)
+      : PThread(0x4000, NoAutoDeleteThread), allocator(_allocator), stream(_stream), stop(_stop) { Resume(); }
+
+  protected:
+    void Main()
+    {
+      void *blocks[batchSize];
+
+      while (!stop) {
+        if (stream.isFull()) {
+          PThread::Yield();
+          continue;
+        }
+
+        for (PINDEX i = 0 ; i < batchSize ; i++) {
+          blocks[i] = allocator.Alloc();
+          memset(blocks[i], 0x55, sizeof(void *));
+        }
+
+        stream.PutData(blocks, sizeof(blocks));
+      }
+
+      stream.PutEof();
+    }
+
+    Allocator &allocator;
+    DataStream &stream;
+    volatile PBoolean &stop;
+};
+
+class Consumer : public PThread
+{
+    PCLASSINFO(Consumer, PThread);
+  public:
+    Consumer(Allocator &_allocator, DataStream &_stream)
+      : PThread(0x4000, NoAutoDeleteThread), allocator(_allocator), stream(_stream), count(0) { Resume(); }
+
+    PInt64 Count() const { return count; }
+
+  protected:
+    void Main()
+    {
+      void *blocks[batchSize];
+      PINDEX done = 0;
+
+      for (;;) {
+        int len = stream.GetData((BYTE *)blocks + done, sizeof(blocks) - done);
+
+        if (len < 0)
+          break;
+
+        if (len == 0) {
+          PThread::Yield();
+          continue;
+        }
+
+        done += len;
+
+        if (done < PINDEX(sizeof(blocks)))
+          continue;
+
+        for (PINDEX i = 0 ; i < batchSize ; i++)
+          allocator.Free(blocks[i]);
+
+        count += batchSize;
+        done = 0;
+      }
+    }
+
+    Allocator &allocator;
+    DataStream &stream;
+    PInt64 count;
+};
+///////////////////////////////////////////////////////////////
+/*
+ * Returns the total count of blocks per microsecond
+ */
+static double Bench(Allocator &allocator, PINDEX channels)
+{
+  DataStream *streams[maxChannels];
+  Producer *producers[maxChannels];
+  Consumer *consumers[maxChannels];
+  volatile PBoolean stop = FALSE;
+
+  PTimeInterval start = PTimer::Tick();
+
+  for (PINDEX i = 0 ; i < channels ; i++) {
+    streams[i] = new RingStream(64*batchSize*sizeof(void *), 16*batchSize*sizeof(void *));
+    consumers[i] = new Consumer(allocator, *streams[i]);
+    producers[i] = new Producer(allocator, *streams[i], stop);
+  }
+
+  PThread::Sleep(benchTime);
+  stop = TRUE;
+
+  PInt64 count = 0;
+
+  for (PINDEX i = 0 ; i < channels ; i++) {
+    producers[i]->WaitForTermination();
+    consumers[i]->WaitForTermination();
+    count += consumers[i]->Count();
+    delete producers[i];
+    delete consumers[i];
+    delete streams[i];
+  }
+
+  PInt64 elapsed = (PTimer::Tick() - start).GetMilliSeconds();
+
+  return elapsed ? double(count)/1000/elapsed : 0;
+}
+///////////////////////////////////////////////////////////////
+class PoolBench : public PProcess
+{
+  PCLASSINFO(PoolBench, PProcess)
+
+  public:
+    PoolBench() : PProcess("Frolov,Holtschneider,Davidson", "pool_bench") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(PoolBench);
+
+void PoolBench::Main()
+{
+  static const PINDEX channelCounts[] = { 1, 4, maxChannels };
+
+  cout << "pool_bench: blocks/us (FreeListPool / one PMutex / heap)" << endl;
+
+  PoolAllocator pooled;
+  LockedAllocator locked;
+  HeapAllocator heap;
+
+  for (PINDEX c = 0 ; c < PINDEX(PARRAYSIZE(channelCounts)) ; c++) {
+    PINDEX channels = channelCounts[c];
+
+    double rPool = Bench(pooled, channels);
+    double rLocked = Bench(locked, channels);
+    double rHeap = Bench(heap, channels);
+
+    cout << "  " << channels << " channels: " << rPool << " / " << rLocked << " / " << rHeap << endl;
+  }
+
+  cout << "  " << pool << endl;
+}
+///////////////////////////////////////////////////////////////
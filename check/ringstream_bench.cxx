@@ -0,0 +1,225 @@
+/*
+ * ringstream_bench.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Multi-channel throughput of RingStream against DataStream with
+ * PMutex.
+ *
+ * Usage: ringstream_bench
+ *
+ * For 1, 4 and 16 channels runs a producer and a consumer thread per
+ * channel passing 20 ms audio chunks with the flow control of the
+ * AudioEngine send path (the producer waits while isFull()) through
+ * RingStream and through DataStream locked by PMutex (the previous
+ * AudioEngine path) and reports the total throughput of both.
+ */
+
+#include <ptlib.h>
+#include "../pmutils.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+enum {
+  chunkSize = 320,            // 20 ms of 8000 Hz 16-bit samples
+  threshold = 1024*2,         // the same as AudioEngine
+  benchTime = 300,            // ms
+  maxChannels = 16,
+};
+///////////////////////////////////////////////////////////////
+/*
+ * The previous AudioEngine path
+ */
+class LockedStream : public DataStream
+{
+    PCLASSINFO(LockedStream, DataStream);
+  public:
+    LockedStream(PINDEX _threshold) : DataStream(_threshold) {}
+
+    virtual int PutData(const void *pBuf, PINDEX count)
+    {
+      PWaitAndSignal mutexWait(mutex);
+      return DataStream::PutData(pBuf, count);
+    }
+
+    virtual int GetData(void *pBuf, PINDEX count)
+    {
+      PWaitAndSignal mutexWait(mutex);
+      return DataStream::GetData(pBuf, count);
+    }
+
+    virtual void PutEof()
+    {
+      PWaitAndSignal mutexWait(mutex);
+      DataStream::PutEof();
+    }
+
+    virtual PBoolean isFull() const
+    {
+      PWaitAndSignal mutexWait(mutex);
+      return DataStream::isFull();
+    }
+
+  protected:
+    PMutex mutex;
+};
+///////////////////////////////////////////////////////////////
+class Producer : public PThread
+{
+    PCLASSINFO(Producer, PThread);
+  public:
+    Producer(DataStream &_stream, volatile PBoolean &_stop)
+      : PThread(0x4000, NoAutoDeleteThread), stream(_stream), stop(_stop) { Resume(); }
+
+  protected:
+    void Main()
+    {
+      BYTE buf[chunkSize];
+
+      memset(buf, 0x55, sizeof(buf));
+
+      while (!stop) {
+        if (stream.isFull()) {
+          PThread::Yield();
+          continue;
+        }
+
+        stream.PutData(buf, sizeof(buf));
+      }
+
+      stream.PutEof();
+    }
+
+    DataStream &stream;
+    volatile PBoolean &stop;
+};
+
+class Consumer : public PThread
+{
+    PCLASSINFO(Consumer, PThread);
+  public:
+    Consumer(DataStream &_stream)
+      : PThread(0x4000, NoAutoDeleteThread), stream(_stream), bytes(0) { Resume(); }
+
+    PInt64 Bytes() const { return bytes; }
+
+  protected:
+    void Main()
+    {
+      BYTE buf[chunkSize];
+
+      for (;;) {
+        int len = stream.GetData(buf, sizeof(buf));
+
+        if (len < 0)
+          break;
+
+        if (len == 0)
+          PThread::Yield();
+        else
+          bytes += len;
+      }
+    }
+
+    DataStream &stream;
+    PInt64 bytes;
+};
+///////////////////////////////////////////////////////////////
+/*
+ * Returns the total MB/s of channels
+ */
+static double Bench(DataStream **streams, PINDEX channels)
+{
+  Producer *producers[maxChannels];
+  Consumer *consumers[maxChannels];
+  volatile PBoolean stop = FALSE;
+
+  PTimeInterval start = PTimer::Tick();
+
+  for (PINDEX i = 0 ; i < channels ; i++) {
+    consumers[i] = new Consumer(*streams[i]);
+    producers[i] = new Producer(*streams[i], stop);
+  }
+
+  PThread::Sleep(benchTime);
+  stop = TRUE;
+
+  PInt64 bytes = 0;
+
+  for (PINDEX i = 0 ; i < channels ; i++) {
+    producers[i]->WaitForTermination();
+    consumers[i]->WaitForTermination();
+    bytes += consumers[i]->Bytes();
+    delete producers[i];
+    delete consumers[i];
+  }
+
+  PInt64 elapsed = (PTimer::Tick() - start).GetMilliSeconds();
+
+  return elapsed ? double(bytes)/1000/elapsed : 0;
+}
+///////////////////////////////////////////////////////////////
+class RingStreamBench : public PProcess
+{
+  PCLASSINFO(RingStreamBench, PProcess)
+
+  public:
+    RingStreamBench() : PProcess("Frolov,Holtschneider,Davidson", "ringstream_bench") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(RingStreamBench);
+
+void RingStreamBench::Main()
+{
+  static const PINDEX channelCounts[] = { 1, 4, maxChannels };
+
+  cout << "ringstream_bench: MB/s (RingStream / DataStream+PMutex)" << endl;
+
+  for (PINDEX c = 0 ; c < PINDEX(PARRAYSIZE(channelCounts)) ; c++) {
+    PINDEX channels = channelCounts[c];
+    DataStream *streams[maxChannels];
+
+    // the same capacities as AudioEngine
+    for (PINDEX i = 0 ; i < channels ; i++)
+      streams[i] = new RingStream(4*threshold, threshold);
+
+    double mbRing = Bench(streams, channels);
+
+    for (PINDEX i = 0 ; i < channels ; i++) {
+      delete streams[i];
+      streams[i] = new LockedStream(threshold);
+    }
+
+    double mbLocked = Bench(streams, channels);
+
+    for (PINDEX i = 0 ; i < channels ; i++)
+      delete streams[i];
+
+    cout << "  " << channels << " channels: " << mbRing << " / " << mbLocked << endl;
+  }
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,248 @@
+/*
+ * ringstream_check.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Producer/consumer stress check of RingStream.
+ *
+ * Usage: ringstream_check [kbytes [seed]]
+ *
+ * For each round a producer thread puts kbytes (1024 by default) of
+ * the position dependent data by random chunks followed by EOF and
+ * the consumer (main thread) gets them by random chunks and checks
+ *
+ *  - the data (no lost, duplicated or reordered bytes);
+ *  - the EOF ordering (-1 only after the last byte and then again);
+ *  - the spill path (the rounds with the chunks larger than the ring
+ *    or with the slow consumer should overflow the ring).
+ *
+ * Each round is run twice by the same RingStream reused after Clean().
+ */
+
+#include <ptlib.h>
+#include "../pmutils.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+enum {
+  maxChunk = 1024,
+};
+
+static unsigned Random(unsigned &state, unsigned range)
+{
+  // xorshift32
+  state ^= state << 13;
+  state ^= state >> 17;
+  state ^= state << 5;
+
+  return state % range;
+}
+
+static BYTE Pattern(unsigned pos)
+{
+  pos ^= pos >> 7;
+  pos *= 0x9E3779B1;
+
+  return BYTE(pos >> 24);
+}
+
+struct Round {
+  const char *name;
+  PINDEX size;            // ring size
+  PINDEX threshold;       // if equal to size then isFull() is TRUE only if spilled
+  unsigned maxPut;        // max producer chunk
+  unsigned maxGet;        // max consumer chunk
+  PBoolean flowControl;   // producer waits while isFull()
+  unsigned slowConsumer;  // consumer sleeps 1 ms per N chunks (0 - never)
+  PBoolean spill;         // the ring should overflow
+};
+///////////////////////////////////////////////////////////////
+class Producer : public PThread
+{
+    PCLASSINFO(Producer, PThread);
+  public:
+    Producer(RingStream &_stream, const Round &_round, unsigned _total, unsigned _randomState)
+      : PThread(0x4000, NoAutoDeleteThread)
+      , stream(_stream)
+      , round(_round)
+      , total(_total)
+      , randomState(_randomState)
+      , spills(0)
+    {
+      Resume();
+    }
+
+    unsigned Spills() const { return spills; }
+
+  protected:
+    void Main();
+
+    RingStream &stream;
+    const Round &round;
+    unsigned total;
+    unsigned randomState;
+    unsigned spills;
+};
+
+void Producer::Main()
+{
+  BYTE buf[maxChunk];
+  unsigned pos = 0;
+
+  while (pos < total) {
+    unsigned count = 1 + Random(randomState, round.maxPut);
+
+    if (count > total - pos)
+      count = total - pos;
+
+    for (unsigned i = 0 ; i < count ; i++)
+      buf[i] = Pattern(pos + i);
+
+    if (round.flowControl) {
+      while (stream.isFull())
+        PThread::Yield();
+    }
+
+    stream.PutData(buf, count);
+    pos += count;
+
+    if (round.threshold == round.size && stream.isFull())
+      spills++;
+  }
+
+  stream.PutEof();
+}
+///////////////////////////////////////////////////////////////
+/*
+ * Returns the count of failures
+ */
+static unsigned CheckRound(RingStream &stream, const Round &round, unsigned total, unsigned &randomState, unsigned &spills)
+{
+  BYTE buf[maxChunk];
+  unsigned failed = 0;
+  unsigned pos = 0;
+  unsigned chunks = 0;
+
+  stream.Clean();
+
+  Producer producer(stream, round, total, Random(randomState, 0xFFFFFFFF) | 1);
+
+  for (;;) {
+    int len = stream.GetData(buf, 1 + Random(randomState, round.maxGet));
+
+    if (len < 0)
+      break;
+
+    if (len == 0) {
+      PThread::Yield();
+      continue;
+    }
+
+    for (int i = 0 ; i < len ; i++) {
+      if (buf[i] != Pattern(pos + i)) {
+        if (failed++ < 8)
+          cout << round.name << ": wrong data at " << (pos + i) << endl;
+        break;
+      }
+    }
+
+    pos += len;
+
+    if (pos > total)
+      break;
+
+    if (round.slowConsumer && ++chunks % round.slowConsumer == 0)
+      PThread::Sleep(1);
+  }
+
+  producer.WaitForTermination();
+
+  if (pos != total && failed++ < 8)
+    cout << round.name << ": EOF after " << pos << " bytes of " << total << endl;
+
+  if (stream.GetData(buf, sizeof(buf)) != -1 && failed++ < 8)
+    cout << round.name << ": no EOF after EOF" << endl;
+
+  if (stream.PutData(buf, 1) != -1 && failed++ < 8)
+    cout << round.name << ": put after EOF" << endl;
+
+  spills = producer.Spills();
+
+  if (round.spill && spills == 0 && failed++ < 8)
+    cout << round.name << ": the ring never overflowed" << endl;
+
+  return failed;
+}
+///////////////////////////////////////////////////////////////
+class RingStreamCheck : public PProcess
+{
+  PCLASSINFO(RingStreamCheck, PProcess)
+
+  public:
+    RingStreamCheck() : PProcess("Frolov,Holtschneider,Davidson", "ringstream_check") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(RingStreamCheck);
+
+void RingStreamCheck::Main()
+{
+  static const Round rounds[] = {
+    { "small chunks",  256,  256,  64,       64,       FALSE, 0,   FALSE },
+    { "flow control",  4096, 1024, maxChunk, maxChunk, TRUE,  0,   FALSE },
+    { "large chunks",  256,  256,  maxChunk, 64,       FALSE, 0,   TRUE  },
+    { "slow consumer", 256,  256,  128,      128,      FALSE, 100, TRUE  },
+    { "1 byte gets",   256,  256,  maxChunk, 1,        FALSE, 0,   TRUE  },
+  };
+
+  PArgList &args = GetArguments();
+  unsigned total = (args.GetCount() > 0 ? args[0].AsUnsigned() : 1024)*1024;
+  unsigned randomState = args.GetCount() > 1 ? args[1].AsUnsigned() : 1;
+
+  if (!randomState)
+    randomState = 1;
+
+  cout << "ringstream_check: " << total/1024 << " kbytes seed=" << randomState << endl;
+
+  unsigned failedTotal = 0;
+
+  for (PINDEX r = 0 ; r < PINDEX(PARRAYSIZE(rounds)) ; r++) {
+    RingStream stream(rounds[r].size, rounds[r].threshold);
+    unsigned spills, spills2;
+    unsigned failed = CheckRound(stream, rounds[r], total, randomState, spills);
+
+    failed += CheckRound(stream, rounds[r], total, randomState, spills2);
+    spills += spills2;
+
+    cout << rounds[r].name << ": " << (failed ? "FAILED " : "OK ") << failed
+         << " (spilled puts " << spills << ")" << endl;
+
+    failedTotal += failed;
+  }
+
+  SetTerminationValue(failedTotal ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
@@ -0,0 +1,242 @@
+/*
+ * route_bench.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Routing throughput of PseudoModemQ.
+ *
+ * Usage: route_bench [modems]
+ *
+ * Queues the modems (10000 by default) with distinct route prefixes
+ * and measures the incoming call routing (DequeueWithRoute() of a
+ * random called number followed by Enqueue() of the selected modem)
+ * by the route prefix trie and by the queue scan with CheckRoute()
+ * used before it. The modems are fake ones, so no modem drivers are
+ * involved.
+ */
+
+#include <ptlib.h>
+#include "../pmodem.h"
+#include "../drivers.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+/*
+ * The bench never creates the modems by the drivers
+ */
+PseudoModem *PseudoModemDrivers::CreateModem(
+    const PString &,
+    const PString &,
+    const PConfigArgs &,
+    const PNotifier &)
+{
+  return NULL;
+}
+///////////////////////////////////////////////////////////////
+class BenchModem : public PseudoModem
+{
+    PCLASSINFO(BenchModem, PseudoModem);
+  public:
+    BenchModem(const PString &_tty, const PString &_route)
+      : PseudoModem(_tty), route(_route) { ptyname = _tty; valid = TRUE; }
+
+    PBoolean IsReady() const { return TRUE; }
+    PBoolean CheckRoute(const PString &number) const { return route.IsEmpty() || number.Find(route) == 0; }
+    const PString &routePrefix() const { return route; }
+    PBoolean Request(PStringToString &) const { return FALSE; }
+    T38Engine *NewPtrT38Engine() const { return NULL; }
+    AudioEngine *NewPtrAudioEngine() const { return NULL; }
+    EngineBase *NewPtrUserInputEngine() const { return NULL; }
+
+  protected:
+    void Main() {}
+
+    PString route;
+};
+///////////////////////////////////////////////////////////////
+/*
+ * The queue scan of the previous PseudoModemQ
+ */
+PQUEUE(_BenchModemQ, PseudoModem);
+
+class BenchModemQ : public _BenchModemQ
+{
+    PCLASSINFO(BenchModemQ, _BenchModemQ);
+  public:
+    BenchModemQ() { DisallowDeleteObjects(); }
+
+    PseudoModem *DequeueWithRoute(const PString &number)
+    {
+      PWaitAndSignal mutexWait(Mutex);
+      PObject *object;
+
+      for (PINDEX i = 0 ; (object = GetAt(i)) != NULL ; i++) {
+        PseudoModem *modem = (PseudoModem *)object;
+
+        if (modem->CheckRoute(number) && modem->IsReady()) {
+          Remove(modem);
+          return modem;
+        }
+      }
+
+      return NULL;
+    }
+
+    void Enqueue(PseudoModem *modem)
+    {
+      PWaitAndSignal mutexWait(Mutex);
+      _BenchModemQ::Enqueue(modem);
+    }
+
+  protected:
+    PMutex Mutex;
+};
+///////////////////////////////////////////////////////////////
+static unsigned randomState = 1;
+
+static unsigned Random(unsigned range)
+{
+  // xorshift32
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return randomState % range;
+}
+
+static PString Route(PINDEX i)
+{
+  return PString(PString::Unsigned, 100000 + i);
+}
+
+/*
+ * The called numbers are prepared out of the measured loop
+ */
+enum { maxCalls = 4096 };
+
+static PINDEX callModem[maxCalls];
+static PString callNumber[maxCalls];
+
+/*
+ * Runs the calls by batches for one second at least and returns
+ * ns per call or 0 if a call was routed to a wrong modem
+ */
+template <class Q> static double Bench(Q &queue, BenchModem **modems)
+{
+  PINDEX batch = 16;
+  PINDEX calls = 0;
+  PInt64 elapsed = 0;
+
+  while (elapsed < 1000) {
+    PTimeInterval start = PTimer::Tick();
+
+    for (PINDEX n = 0 ; n < batch ; n++) {
+      PINDEX call = (calls + n) % maxCalls;
+      PseudoModem *modem = queue.DequeueWithRoute(callNumber[call]);
+
+      if (modem != modems[callModem[call]]) {
+        cout << "call " << callNumber[call] << " routed to "
+             << (modem ? modem->ptyName() : PString("NULL")) << endl;
+        return 0;
+      }
+
+      queue.Enqueue(modem);
+    }
+
+    elapsed += (PTimer::Tick() - start).GetMilliSeconds();
+    calls += batch;
+
+    if (batch < 1000000)
+      batch *= 2;
+  }
+
+  return double(elapsed)*1000000/calls;
+}
+///////////////////////////////////////////////////////////////
+class RouteBench : public PProcess
+{
+  PCLASSINFO(RouteBench, PProcess)
+
+  public:
+    RouteBench() : PProcess("Frolov,Holtschneider,Davidson", "route_bench") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(RouteBench);
+
+void RouteBench::Main()
+{
+  PArgList &args = GetArguments();
+  PINDEX count = args.GetCount() > 0 ? (PINDEX)args[0].AsUnsigned() : 10000;
+
+  if (count < 1)
+    count = 1;
+
+  BenchModem **modems = new BenchModem *[count];
+
+  for (PINDEX i = 0 ; i < count ; i++)
+    modems[i] = new BenchModem(psprintf("bench%u", (unsigned)i), Route(i));
+
+  for (PINDEX call = 0 ; call < maxCalls ; call++) {
+    callModem[call] = Random(count);
+    callNumber[call] = Route(callModem[call]) + "5550100";
+  }
+
+  double nsTrie;
+  double nsScan;
+
+  {
+    PseudoModemQ queue;
+
+    for (PINDEX i = 0 ; i < count ; i++)
+      queue.Enqueue(modems[i]);
+
+    nsTrie = Bench(queue, modems);
+  }
+
+  {
+    BenchModemQ queue;
+
+    for (PINDEX i = 0 ; i < count ; i++)
+      queue.Enqueue(modems[i]);
+
+    nsScan = Bench(queue, modems);
+  }
+
+  cout << "route_bench: " << count << " modems\n"
+       << "  routing: " << (nsTrie && nsScan ? "OK" : "FAILED") << "\n"
+       << "  route prefix trie: " << nsTrie << " ns/call\n"
+       << "  queue scan:        " << nsScan << " ns/call" << endl;
+
+  for (PINDEX i = 0 ; i < count ; i++)
+    delete modems[i];
+
+  delete [] modems;
+
+  SetTerminationValue(nsTrie && nsScan ? 0 : 1);
+}
+///////////////////////////////////////////////////////////////
+
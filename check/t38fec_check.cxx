@@ -0,0 +1,332 @@
+/*
+ * t38fec_check.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Round trip check of the UDPTL FEC error recovery (T38PerFec).
+ *
+ * Usage: t38fec_check [seed]
+ *
+ * For several span/entries values encodes a stream of random IFP
+ * packets with FEC, passes the UDPTL packets through the UDPTL codec
+ * and drops some of them. The receiver recovers the lost IFP packets
+ * the same way as T38ModemMediaStream::WritePacket() (including
+ * re-Put() of the recovered packets). Each recovered packet should be
+ * the original one padded by zeros and the following losses should be
+ * recovered completely:
+ *
+ *  - single packets (including the wind-up packets seq < span*entries
+ *    at the beginning of the stream, except seq < span - 1 which are
+ *    followed by the packets without fec-info);
+ *  - bursts up to entries packets after the wind-up;
+ *  - pairs seq and seq + entries after the wind-up (the packet seq
+ *    is recovered and used for the recovery of seq + entries).
+ *
+ * The random losses are checked for the correctness of the recovered
+ * packets only.
+ */
+
+#include <ptlib.h>
+#include "../t38per.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+enum {
+  streamSize = 400,
+  tailSize = 2*T38PerFec::historySize,  // without losses
+  maxIfpSize = 40,
+  maxRawSize = 2048,
+};
+
+static unsigned randomState = 1;
+
+static unsigned Random(unsigned range)
+{
+  // xorshift32
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return randomState % range;
+}
+///////////////////////////////////////////////////////////////
+/*
+ * Loss patterns
+ */
+enum {
+  lossNone,
+  lossSingle,     // single packets with period span*entries + 1
+  lossBurst,      // bursts of 2..entries packets after the wind-up
+  lossPair,       // packets seq and seq + entries after the wind-up
+  lossRandom,     // 5% (the recovered packets are checked only)
+};
+
+static const char * const lossNames[] = {
+  "none",
+  "single",
+  "burst",
+  "pair",
+  "random",
+};
+
+struct Stream {
+  int span;       // span and entries after the clamping by Encode()
+  int entries;
+  int loss;
+  long phase;
+  int burst;
+};
+
+static PBoolean IsLost(const Stream &stream, long seq)
+{
+  if (seq >= streamSize)
+    return FALSE;
+
+  long windUp = stream.span*stream.entries;
+
+  switch (stream.loss) {
+    case lossSingle:
+      return seq >= stream.phase && (seq - stream.phase) % (windUp + 1) == 0;
+    case lossBurst:
+      return seq >= windUp && (seq - windUp) % (windUp + stream.entries) < stream.burst;
+    case lossPair:
+      if (seq < windUp)
+        return FALSE;
+      seq = (seq - windUp) % (windUp + 2*stream.entries + 1);
+      return seq == 0 || seq == stream.entries;
+    case lossRandom:
+      return Random(100) < 5;
+  }
+
+  return FALSE;
+}
+
+/*
+ * Returns TRUE if the lost packet seq should be recovered from the
+ * first received packet after it
+ */
+static PBoolean IsRecoverable(const Stream &stream, long seq)
+{
+  switch (stream.loss) {
+    case lossSingle:
+      // the packets before seq = span - 1 have no fec-info
+      return seq + 1 >= stream.span;
+    case lossBurst:
+    case lossPair:
+      return TRUE;
+  }
+
+  return FALSE;
+}
+
+/*
+ * Returns the count of failures
+ */
+static unsigned CheckStream(const Stream &stream, unsigned &lostTotal, unsigned &recoveredTotal)
+{
+  static PBYTEArray ifps[streamSize + tailSize];
+  static BYTE raw[maxRawSize];
+  unsigned failed = 0;
+  long count = streamSize + tailSize;
+
+  for (long seq = 0 ; seq < count ; seq++) {
+    PINDEX size = 1 + Random(maxIfpSize);
+    BYTE *p = ifps[seq].GetPointer(size);
+
+    ifps[seq].SetSize(size);
+
+    for (PINDEX i = 0 ; i < size ; i++)
+      p[i] = (BYTE)Random(256);
+  }
+
+  T38PerFec txFec;
+  T38PerFec rxFec;
+
+  // the result should not depend on the previous content
+  PBYTEArray recovered(maxIfpSize*2);
+
+  memset(recovered.GetPointer(), 0xFF, recovered.GetSize());
+
+  long current = 0;
+
+  for (long seq = 0 ; seq < count ; seq++) {
+    T38PerUDPTL udptl;
+
+    udptl.seq = (unsigned)(seq & 0xFFFF);
+    udptl.primary = ifps[seq];
+    udptl.primarySize = ifps[seq].GetSize();
+
+    txFec.Encode(seq, stream.span, stream.entries, udptl);
+    txFec.Put(seq, ifps[seq], ifps[seq].GetSize());
+
+    PINDEX len = T38Per::EncodeUDPTL(udptl, raw, sizeof(raw));
+
+    if (len == 0) {
+      if (failed++ < 8)
+        cout << "seq=" << seq << ": can't encode" << endl;
+      continue;
+    }
+
+    if (IsLost(stream, seq)) {
+      lostTotal++;
+      continue;
+    }
+
+    T38PerUDPTL rx;
+
+    if (!T38Per::DecodeUDPTL(raw, len, rx) || rx.seq != udptl.seq || rx.primarySize != udptl.primarySize ||
+        rx.fecNPackets != udptl.fecNPackets || rx.count != udptl.count)
+    {
+      if (failed++ < 8)
+        cout << "seq=" << seq << ": can't decode" << endl;
+      continue;
+    }
+
+    // the same as T38ModemMediaStream::WritePacket() without holding
+    long s = current;
+
+    if (s < seq - T38PerFec::historySize)
+      s = seq - T38PerFec::historySize;
+
+    for (; s < seq ; s++) {
+      if (!rxFec.Recover(s, seq, rx, recovered)) {
+        if (IsRecoverable(stream, s) && failed++ < 8)
+          cout << "seq=" << s << ": not recovered from " << seq << endl;
+        continue;
+      }
+
+      const PBYTEArray &ifp = ifps[s];
+      PBoolean ok = recovered.GetSize() >= ifp.GetSize();
+
+      for (PINDEX i = 0 ; ok && i < recovered.GetSize() ; i++)
+        ok = recovered[i] == (i < ifp.GetSize() ? ifp[i] : 0);
+
+      if (!ok && failed++ < 8) {
+        cout << "seq=" << s << ": recovered from " << seq << " size " << recovered.GetSize()
+             << " (original size " << ifp.GetSize() << ")" << endl;
+      }
+
+      recoveredTotal++;
+      rxFec.Put(s, recovered, recovered.GetSize());
+    }
+
+    rxFec.Put(seq, rx.primary, rx.primarySize);
+    current = seq + 1;
+  }
+
+  return failed;
+}
+///////////////////////////////////////////////////////////////
+class T38FecCheck : public PProcess
+{
+  PCLASSINFO(T38FecCheck, PProcess)
+
+  public:
+    T38FecCheck() : PProcess("Frolov,Holtschneider,Davidson", "t38fec_check") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(T38FecCheck);
+
+void T38FecCheck::Main()
+{
+  static const struct {
+    int span;
+    int entries;
+  } configs[] = {
+    { 1, 1 },
+    { 1, 4 },
+    { 2, 1 },
+    { 2, 3 },
+    { 3, 2 },
+    { 3, 5 },
+    { 5, 4 },
+    { 20, 4 },    // clamped to the history size
+    { 4, 20 },    // clamped to maxEntries
+  };
+
+  PArgList &args = GetArguments();
+
+  if (args.GetCount() > 0)
+    randomState = args[0].AsUnsigned();
+
+  if (!randomState)
+    randomState = 1;
+
+  cout << "t38fec_check: seed=" << randomState << endl;
+
+  unsigned failedTotal = 0;
+
+  for (PINDEX c = 0 ; c < PINDEX(PARRAYSIZE(configs)) ; c++) {
+    Stream stream;
+
+    stream.span = configs[c].span;
+    stream.entries = configs[c].entries;
+
+    // the same clamping as by T38PerFec::Encode()
+    if (stream.entries > T38PerUDPTL::maxEntries)
+      stream.entries = T38PerUDPTL::maxEntries;
+
+    if (stream.span*stream.entries > T38PerFec::historySize)
+      stream.span = T38PerFec::historySize/stream.entries;
+
+    for (stream.loss = lossNone ; stream.loss <= lossRandom ; stream.loss++) {
+      unsigned failed = 0;
+      unsigned lost = 0;
+      unsigned recovered = 0;
+
+      if (stream.loss == lossPair && (stream.span < 2 || stream.entries < 2))
+        continue;
+
+      stream.phase = 0;
+      stream.burst = 1;
+
+      switch (stream.loss) {
+        case lossSingle:
+          // the first loss inside the wind-up
+          for (; stream.phase <= stream.span*stream.entries ; stream.phase++)
+            failed += CheckStream(stream, lost, recovered);
+          break;
+        case lossBurst:
+          for (stream.burst = 2 ; stream.burst <= stream.entries ; stream.burst++)
+            failed += CheckStream(stream, lost, recovered);
+          break;
+        default:
+          failed += CheckStream(stream, lost, recovered);
+      }
+
+      cout << "span=" << configs[c].span << " entries=" << configs[c].entries
+           << " " << lossNames[stream.loss] << ": "
+           << (failed ? "FAILED " : "OK ") << failed
+           << " (recovered " << recovered << " of " << lost << ")" << endl;
+
+      failedTotal += failed;
+    }
+  }
+
+  SetTerminationValue(failedTotal ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
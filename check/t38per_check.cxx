@@ -0,0 +1,536 @@
+/*
+ * t38per_check.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Conformance check of T38Per against the generic ASN codec.
+ *
+ * Usage: t38per_check [count [seed]]
+ *
+ * Encodes and decodes by both codecs all the packets copied from
+ * the T38Per cache and count random IFP and UDPTL packets for both
+ * variants of the field-type and requires byte-identical output and
+ * equal decoded values.
+ */
+
+#include <ptlib.h>
+
+#ifdef USE_OPAL
+  #include <opal/buildopts.h>
+  #include <asn/t38.h>
+#else
+  #include <t38.h>
+#endif
+
+#include "../t38per.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+#ifdef OPTIMIZE_CORRIGENDUM_IFP
+  #define T38_IFP_OTHER               T38_PreCorrigendum_IFPPacket
+#else
+  #define T38_IFP_OTHER               T38_IFPPacket
+#endif
+
+enum {
+  maxRawSize = 2048,
+  maxFields = 4,
+  maxFieldData = 300,
+  maxUdptlData = 200,
+};
+///////////////////////////////////////////////////////////////
+static unsigned randomState = 1;
+
+static unsigned Random(unsigned range)
+{
+  // xorshift32
+  randomState ^= randomState << 13;
+  randomState ^= randomState >> 17;
+  randomState ^= randomState << 5;
+
+  return range ? randomState % range : randomState;
+}
+
+static void RandomBytes(PBYTEArray &bytes, PINDEX size)
+{
+  BYTE *p = bytes.GetPointer(size);
+
+  for (PINDEX i = 0 ; i < size ; i++)
+    p[i] = (BYTE)Random(256);
+
+  bytes.SetSize(size);
+}
+///////////////////////////////////////////////////////////////
+/*
+ * Canonical text of the IFP value (the same for both variants)
+ */
+template <class IFP> static PString DumpIFP(const IFP &ifp)
+{
+  PStringStream dump;
+
+  dump << "tag=" << ifp.m_type_of_msg.GetTag()
+       << " type=" << ((const PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).GetValue();
+
+  if (ifp.HasOptionalField(T38_IFPPacket::e_data_field)) {
+    dump << " fields=" << ifp.m_data_field.GetSize();
+
+    for (PINDEX i = 0 ; i < ifp.m_data_field.GetSize() ; i++) {
+      dump << " [" << ifp.m_data_field[i].m_field_type.GetValue();
+
+      if (ifp.m_data_field[i].HasOptionalField(T38_Data_Field_subtype::e_field_data)) {
+        const PASN_OctetString &data = ifp.m_data_field[i].m_field_data;
+
+        dump << ":" << hex << setfill('0');
+
+        for (PINDEX j = 0 ; j < data.GetSize() ; j++)
+          dump << setw(2) << (unsigned)data[j];
+
+        dump << dec << setfill(' ');
+      }
+
+      dump << "]";
+    }
+  }
+
+  return dump;
+}
+
+template <class IFP> static void SetIFP(
+    IFP &ifp,
+    unsigned tag,
+    unsigned type,
+    int count,                  // < 0 if there is no data field
+    const unsigned *fieldTypes,
+    const PBYTEArray *fieldData)
+{
+  ifp.m_type_of_msg.SetTag(tag);
+  ((PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).SetValue(type);
+
+  if (count < 0) {
+    ifp.RemoveOptionalField(T38_IFPPacket::e_data_field);
+    return;
+  }
+
+  ifp.IncludeOptionalField(T38_IFPPacket::e_data_field);
+  ifp.m_data_field.SetSize(count);
+
+  for (int i = 0 ; i < count ; i++) {
+    ifp.m_data_field[i].m_field_type.SetValue(fieldTypes[i]);
+
+    if (fieldData[i].GetSize()) {
+      ifp.m_data_field[i].IncludeOptionalField(T38_Data_Field_subtype::e_field_data);
+      ifp.m_data_field[i].m_field_data.SetValue(fieldData[i], fieldData[i].GetSize());
+    } else {
+      ifp.m_data_field[i].RemoveOptionalField(T38_Data_Field_subtype::e_field_data);
+    }
+  }
+}
+
+static void DumpBytes(const char *name, const BYTE *buf, PINDEX size)
+{
+  cout << "  " << name << ":" << hex << setfill('0');
+
+  for (PINDEX i = 0 ; i < size ; i++)
+    cout << ' ' << setw(2) << (unsigned)buf[i];
+
+  cout << dec << setfill(' ') << endl;
+}
+///////////////////////////////////////////////////////////////
+/*
+ * IFP is the variant of the IFP packet with the native field-type
+ * extendable as fieldTypeExtendable
+ */
+template <class IFP> static PBoolean CheckIFP(
+    unsigned tag,
+    unsigned type,
+    int count,
+    const unsigned *fieldTypes,
+    const PBYTEArray *fieldData,
+    PBoolean fieldTypeExtendable)
+{
+  T38_IFP ifp;
+  IFP ref;
+
+  SetIFP(ifp, tag, type, count, fieldTypes, fieldData);
+  SetIFP(ref, tag, type, count, fieldTypes, fieldData);
+
+  PString value = DumpIFP(ref);
+
+  PPER_Stream refStrm;
+
+  ref.Encode(refStrm);
+  refStrm.CompleteEncoding();
+
+  BYTE buf[maxRawSize];
+  PINDEX len = T38Per::EncodeIFP(ifp, buf, sizeof(buf), fieldTypeExtendable);
+
+  if (len != refStrm.GetSize() || memcmp(buf, (const BYTE *)refStrm, len) != 0) {
+    cout << "IFP encoding mismatch (extendable=" << fieldTypeExtendable << ") " << value << endl;
+    DumpBytes("T38Per", buf, len);
+    DumpBytes("PPER_Stream", refStrm, refStrm.GetSize());
+    return FALSE;
+  }
+
+  T38_IFP ifpPer;
+
+  if (!T38Per::DecodeIFP(refStrm, refStrm.GetSize(), ifpPer, fieldTypeExtendable)) {
+    cout << "IFP decoding failed by T38Per (extendable=" << fieldTypeExtendable << ") " << value << endl;
+    DumpBytes("packet", refStrm, refStrm.GetSize());
+    return FALSE;
+  }
+
+  IFP ifpRef;
+  PPER_Stream decStrm((const BYTE *)refStrm, refStrm.GetSize());
+
+  if (!ifpRef.Decode(decStrm)) {
+    cout << "IFP decoding failed by PPER_Stream (extendable=" << fieldTypeExtendable << ") " << value << endl;
+    DumpBytes("packet", refStrm, refStrm.GetSize());
+    return FALSE;
+  }
+
+  if (DumpIFP(ifpPer) != value || DumpIFP(ifpRef) != value) {
+    cout << "IFP decoding mismatch (extendable=" << fieldTypeExtendable << ")\n"
+         << "  value:       " << value << "\n"
+         << "  T38Per:      " << DumpIFP(ifpPer) << "\n"
+         << "  PPER_Stream: " << DumpIFP(ifpRef) << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static PBoolean CheckIFP(
+    unsigned tag,
+    unsigned type,
+    int count,
+    const unsigned *fieldTypes,
+    const PBYTEArray *fieldData)
+{
+  return CheckIFP<T38_IFP>(tag, type, count, fieldTypes, fieldData, T38_FIELD_TYPE_EXTENDABLE) &&
+         CheckIFP<T38_IFP_OTHER>(tag, type, count, fieldTypes, fieldData, !T38_FIELD_TYPE_EXTENDABLE);
+}
+///////////////////////////////////////////////////////////////
+/*
+ * All the indicator packets and the data packets with one data field
+ * without data (the entries of the T38Per cache and the values next
+ * to them)
+ */
+static unsigned CheckCachedIFP()
+{
+  T38_IFP ifp;
+  unsigned failed = 0;
+
+  ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_t30_indicator);
+
+  unsigned maxIndicator = ((PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).GetMaximum();
+
+  for (unsigned i = 0 ; i <= maxIndicator ; i++) {
+    if (!CheckIFP(T38_Type_of_msg::e_t30_indicator, i, -1, NULL, NULL))
+      failed++;
+  }
+
+  ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_data);
+
+  unsigned maxDataType = ((PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).GetMaximum();
+
+  ifp.m_data_field.SetSize(1);
+
+  unsigned maxFieldType = ifp.m_data_field[0].m_field_type.GetMaximum();
+  PBYTEArray noData[1];
+
+  for (unsigned t = 0 ; t <= maxDataType ; t++) {
+    for (unsigned f = 0 ; f <= maxFieldType ; f++) {
+      if (!CheckIFP(T38_Type_of_msg::e_data, t, 1, &f, noData))
+        failed++;
+    }
+  }
+
+  return failed;
+}
+
+static unsigned CheckRandomIFP(unsigned count)
+{
+  T38_IFP ifp;
+
+  ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_t30_indicator);
+  unsigned maxIndicator = ((PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).GetMaximum();
+
+  ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_data);
+  unsigned maxDataType = ((PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).GetMaximum();
+
+  ifp.m_data_field.SetSize(1);
+  unsigned maxFieldType = ifp.m_data_field[0].m_field_type.GetMaximum();
+
+  unsigned failed = 0;
+
+  for (unsigned n = 0 ; n < count ; n++) {
+    unsigned tag = Random(2);
+    unsigned type = Random((tag == T38_Type_of_msg::e_data ? maxDataType : maxIndicator) + 1);
+    int fields = Random(4) ? int(Random(maxFields + 1)) : -1;
+    unsigned fieldTypes[maxFields];
+    PBYTEArray fieldData[maxFields];
+
+    for (int i = 0 ; i < fields ; i++) {
+      fieldTypes[i] = Random(maxFieldType + 1);
+
+      if (Random(3))
+        RandomBytes(fieldData[i], Random(maxFieldData) + 1);
+    }
+
+    if (!CheckIFP(tag, type, fields, fieldTypes, fieldData))
+      failed++;
+  }
+
+  return failed;
+}
+///////////////////////////////////////////////////////////////
+static PString DumpUDPTL(const T38PerUDPTL &udptl)
+{
+  PStringStream dump;
+
+  dump << "seq=" << udptl.seq
+       << " primary=" << PBYTEArray(udptl.primary, udptl.primarySize)
+       << " recovery=" << udptl.recovery;
+
+  if (udptl.recovery == T38PerUDPTL::e_fec_info)
+    dump << " npackets=" << udptl.fecNPackets;
+
+  dump << " count=" << udptl.count;
+
+  for (PINDEX i = 0 ; i < udptl.count ; i++)
+    dump << " [" << PBYTEArray(udptl.entry[i], udptl.entrySize[i]) << "]";
+
+  return dump;
+}
+
+static void SetUDPTL(T38_UDPTLPacket &udptl, const T38PerUDPTL &per)
+{
+  udptl.m_seq_number = per.seq;
+  udptl.m_primary_ifp_packet.SetValue(per.primary, per.primarySize);
+
+  if (per.recovery == T38PerUDPTL::e_secondary_ifp_packets) {
+    udptl.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
+
+    T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = udptl.m_error_recovery;
+
+    secondary.SetSize(per.count);
+
+    for (PINDEX i = 0 ; i < per.count ; i++)
+      secondary[i].SetValue(per.entry[i], per.entrySize[i]);
+  } else {
+    udptl.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_fec_info);
+
+    T38_UDPTLPacket_error_recovery_fec_info &fec = udptl.m_error_recovery;
+
+    fec.m_fec_npackets = per.fecNPackets;
+    fec.m_fec_data.SetSize(per.count);
+
+    for (PINDEX i = 0 ; i < per.count ; i++)
+      fec.m_fec_data[i].SetValue(per.entry[i], per.entrySize[i]);
+  }
+}
+
+static void GetUDPTL(const T38_UDPTLPacket &udptl, T38PerUDPTL &per)
+{
+  per.seq = udptl.m_seq_number;
+  per.primary = udptl.m_primary_ifp_packet;
+  per.primarySize = udptl.m_primary_ifp_packet.GetSize();
+  per.fecNPackets = 0;
+  per.count = 0;
+
+  const T38_UDPTLPacket_error_recovery &recovery = udptl.m_error_recovery;
+
+  if (recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
+    const T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = recovery;
+
+    per.recovery = T38PerUDPTL::e_secondary_ifp_packets;
+
+    for (PINDEX i = 0 ; i < secondary.GetSize() && per.count < T38PerUDPTL::maxEntries ; i++) {
+      per.entry[per.count] = secondary[i];
+      per.entrySize[per.count] = secondary[i].GetSize();
+      per.count++;
+    }
+  } else {
+    const T38_UDPTLPacket_error_recovery_fec_info &fec = recovery;
+
+    per.recovery = T38PerUDPTL::e_fec_info;
+    per.fecNPackets = fec.m_fec_npackets;
+
+    for (PINDEX i = 0 ; i < fec.m_fec_data.GetSize() && per.count < T38PerUDPTL::maxEntries ; i++) {
+      per.entry[per.count] = fec.m_fec_data[i];
+      per.entrySize[per.count] = fec.m_fec_data[i].GetSize();
+      per.count++;
+    }
+  }
+}
+
+static PBoolean CheckUDPTL(const T38PerUDPTL &udptl)
+{
+  PString value = DumpUDPTL(udptl);
+
+  T38_UDPTLPacket ref;
+  PPER_Stream refStrm;
+
+  SetUDPTL(ref, udptl);
+  ref.Encode(refStrm);
+  refStrm.CompleteEncoding();
+
+  BYTE buf[maxRawSize];
+  PINDEX len = T38Per::EncodeUDPTL(udptl, buf, sizeof(buf));
+
+  if (len != refStrm.GetSize() || memcmp(buf, (const BYTE *)refStrm, len) != 0) {
+    cout << "UDPTL encoding mismatch " << value << endl;
+    DumpBytes("T38Per", buf, len);
+    DumpBytes("PPER_Stream", refStrm, refStrm.GetSize());
+    return FALSE;
+  }
+
+  T38PerUDPTL udptlPer;
+
+  if (!T38Per::DecodeUDPTL(refStrm, refStrm.GetSize(), udptlPer)) {
+    cout << "UDPTL decoding failed by T38Per " << value << endl;
+    DumpBytes("packet", refStrm, refStrm.GetSize());
+    return FALSE;
+  }
+
+  T38_UDPTLPacket udptlRef;
+  PPER_Stream decStrm((const BYTE *)refStrm, refStrm.GetSize());
+
+  if (!udptlRef.Decode(decStrm)) {
+    cout << "UDPTL decoding failed by PPER_Stream " << value << endl;
+    DumpBytes("packet", refStrm, refStrm.GetSize());
+    return FALSE;
+  }
+
+  T38PerUDPTL udptlRefPer;
+
+  GetUDPTL(udptlRef, udptlRefPer);
+
+  if (DumpUDPTL(udptlPer) != value || DumpUDPTL(udptlRefPer) != value) {
+    cout << "UDPTL decoding mismatch\n"
+         << "  value:       " << value << "\n"
+         << "  T38Per:      " << DumpUDPTL(udptlPer) << "\n"
+         << "  PPER_Stream: " << DumpUDPTL(udptlRefPer) << endl;
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static unsigned CheckRandomUDPTL(unsigned count)
+{
+  static const int npackets[] = {
+    0, 1, 2, 3, 127, 128, 255, 256, 32767, 32768, 65535, 65536, 0x7FFFFF, 0x800000,
+  };
+
+  unsigned failed = 0;
+
+  for (unsigned n = 0 ; n < count ; n++) {
+    T38PerUDPTL udptl;
+    PBYTEArray primary;
+    PBYTEArray entries[T38PerUDPTL::maxEntries];
+
+    RandomBytes(primary, Random(maxUdptlData));
+
+    udptl.seq = Random(65536);
+    udptl.primary = primary;
+    udptl.primarySize = primary.GetSize();
+    udptl.recovery = Random(2);
+
+    if (udptl.recovery == T38PerUDPTL::e_fec_info) {
+      // each fourth packet is with the fec-npackets 0
+      switch (n % 4) {
+        case 0:
+          udptl.fecNPackets = 0;
+          break;
+        case 1:
+          udptl.fecNPackets = npackets[Random(PARRAYSIZE(npackets))];
+          break;
+        default:
+          udptl.fecNPackets = Random(0x1000000);
+      }
+    } else {
+      udptl.fecNPackets = 0;
+    }
+
+    udptl.count = Random(T38PerUDPTL::maxEntries + 1);
+
+    for (PINDEX i = 0 ; i < udptl.count ; i++) {
+      RandomBytes(entries[i], Random(maxUdptlData));
+      udptl.entry[i] = entries[i];
+      udptl.entrySize[i] = entries[i].GetSize();
+    }
+
+    if (!CheckUDPTL(udptl))
+      failed++;
+  }
+
+  return failed;
+}
+///////////////////////////////////////////////////////////////
+class T38PerCheck : public PProcess
+{
+  PCLASSINFO(T38PerCheck, PProcess)
+
+  public:
+    T38PerCheck() : PProcess("Frolov,Holtschneider,Davidson", "t38per_check") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(T38PerCheck);
+
+void T38PerCheck::Main()
+{
+  PArgList &args = GetArguments();
+  unsigned count = args.GetCount() > 0 ? args[0].AsUnsigned() : 10000;
+
+  if (args.GetCount() > 1)
+    randomState = args[1].AsUnsigned();
+
+  if (!randomState)
+    randomState = 1;
+
+  cout << "t38per_check: count=" << count << " seed=" << randomState << endl;
+
+  unsigned failed;
+  unsigned failedTotal = 0;
+
+  failed = CheckCachedIFP();
+  cout << "cached IFP:  " << (failed ? "FAILED " : "OK ") << failed << endl;
+  failedTotal += failed;
+
+  failed = CheckRandomIFP(count);
+  cout << "random IFP:  " << (failed ? "FAILED " : "OK ") << failed << endl;
+  failedTotal += failed;
+
+  failed = CheckRandomUDPTL(count);
+  cout << "random UDPTL: " << (failed ? "FAILED " : "OK ") << failed << endl;
+  failedTotal += failed;
+
+  SetTerminationValue(failedTotal ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
+
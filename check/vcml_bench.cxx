@@ -0,0 +1,264 @@
+/*
+ * vcml_bench.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * VcmlCodec against the per sample conversions by g711.c.
+ *
+ * Usage: vcml_bench
+ *
+ * For each +VSM compression method compares the conversions of all
+ * 256 coded and all 65536 linear values with the previous per sample
+ * code of ModemEngineBody and measures the speed of both.
+ */
+
+#include <ptlib.h>
+#include <math.h>
+#include "../vcml.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+/*
+ * Defined by g711.c included in vcml.cxx
+ */
+int linear2alaw(int pcm_val);
+int alaw2linear(int a_val);
+int linear2ulaw(int pcm_val);
+int ulaw2linear(int u_val);
+///////////////////////////////////////////////////////////////
+/*
+ * The previous per sample conversions of ModemEngineBody
+ */
+static PINDEX DecodeOld(int cml, const BYTE *_pb, PInt16 *ps, PINDEX count)
+{
+  const signed char *pb = (const signed char *)_pb;
+
+  switch (cml) {
+    case 0:
+      while (count--)
+        *ps++ = (PInt16)((PInt16)(*pb++)*256);
+      break;
+    case 1:
+    case 128:
+    case 130:
+      while (count--)
+        *ps++ = (PInt16)((PInt16)(*pb++)*256 - 0x8000);
+      break;
+    case 4:
+    case 131:
+      while (count--)
+        *ps++ = (PInt16)ulaw2linear(*pb++);
+      break;
+    case 5:
+    case 132:
+      while (count--)
+        *ps++ = (PInt16)alaw2linear(*pb++);
+      break;
+  }
+
+  return PINDEX(pb - (const signed char *)_pb);
+}
+
+static PINDEX EncodeOld(int cml, const PInt16 *ps, BYTE *_pb, PINDEX count)
+{
+  signed char *pb = (signed char *)_pb;
+
+  switch (cml) {
+    case 0:
+      while (count--)
+        *pb++ = (signed char)((*ps++)/256);
+      break;
+    case 1:
+    case 128:
+    case 130:
+      while (count--)
+        *pb++ = (signed char)((*ps++ + 0x8000)/256);
+      break;
+    case 4:
+    case 131:
+      while (count--)
+        *pb++ = (signed char)linear2ulaw(*ps++);
+      break;
+    case 5:
+    case 132:
+      while (count--)
+        *pb++ = (signed char)linear2alaw(*ps++);
+      break;
+  }
+
+  return PINDEX(pb - (signed char *)_pb);
+}
+///////////////////////////////////////////////////////////////
+enum {
+  benchSamples = 4096,
+  benchTime = 300,    // ms
+};
+
+static BYTE coded[benchSamples];
+static PInt16 linear[benchSamples];
+
+/*
+ * Returns the count of mismatches
+ */
+static unsigned Check(int cml, const VcmlCodec &codec)
+{
+  static BYTE codes[256];
+  static PInt16 values[0x10000];
+  static PInt16 ps[256], psOld[256];
+  static BYTE pb[0x10000], pbOld[0x10000];
+  unsigned failed = 0;
+
+  for (PINDEX i = 0 ; i < 256 ; i++)
+    codes[i] = (BYTE)i;
+
+  for (PINDEX i = 0 ; i < 0x10000 ; i++)
+    values[i] = (PInt16)(i - 0x8000);
+
+  if (codec.Decode(codes, ps, 256) != 256 || DecodeOld(cml, codes, psOld, 256) != 256)
+    return 1;
+
+  for (PINDEX i = 0 ; i < 256 ; i++) {
+    if (ps[i] != psOld[i] && failed++ < 8)
+      cout << "cml=" << cml << " decode " << i << ": " << ps[i] << " != " << psOld[i] << endl;
+  }
+
+  if (codec.Encode(values, pb, 0x10000) != 0x10000 || EncodeOld(cml, values, pbOld, 0x10000) != 0x10000)
+    return failed + 1;
+
+  for (PINDEX i = 0 ; i < 0x10000 ; i++) {
+    if (pb[i] != pbOld[i] && failed++ < 8)
+      cout << "cml=" << cml << " encode " << values[i] << ": "
+           << (unsigned)pb[i] << " != " << (unsigned)pbOld[i] << endl;
+  }
+
+  return failed;
+}
+
+/*
+ * Returns ns per sample
+ */
+template <class F> static double Bench(F f)
+{
+  PINDEX batch = 16;
+  PInt64 samples = 0;
+  PInt64 elapsed = 0;
+
+  while (elapsed < benchTime) {
+    PTimeInterval start = PTimer::Tick();
+
+    for (PINDEX n = 0 ; n < batch ; n++)
+      f();
+
+    elapsed += (PTimer::Tick() - start).GetMilliSeconds();
+    samples += PInt64(batch)*benchSamples;
+    batch *= 2;
+  }
+
+  return double(elapsed)*1000000/samples;
+}
+
+struct DecodeNew {
+  DecodeNew(const VcmlCodec &_codec) : codec(_codec) {}
+  void operator()() const { codec.Decode(coded, linear, benchSamples); }
+  const VcmlCodec &codec;
+};
+
+struct EncodeNew {
+  EncodeNew(const VcmlCodec &_codec) : codec(_codec) {}
+  void operator()() const { codec.Encode(linear, coded, benchSamples); }
+  const VcmlCodec &codec;
+};
+
+struct DecodeG711 {
+  DecodeG711(int _cml) : cml(_cml) {}
+  void operator()() const { DecodeOld(cml, coded, linear, benchSamples); }
+  int cml;
+};
+
+struct EncodeG711 {
+  EncodeG711(int _cml) : cml(_cml) {}
+  void operator()() const { EncodeOld(cml, linear, coded, benchSamples); }
+  int cml;
+};
+///////////////////////////////////////////////////////////////
+class VcmlBench : public PProcess
+{
+  PCLASSINFO(VcmlBench, PProcess)
+
+  public:
+    VcmlBench() : PProcess("Frolov,Holtschneider,Davidson", "vcml_bench") {}
+
+    void Main();
+};
+
+PCREATE_PROCESS(VcmlBench);
+
+void VcmlBench::Main()
+{
+  static const struct {
+    int cml;
+    const char *name;
+  } methods[] = {
+    { 0, "signed linear" },
+    { 1, "unsigned linear" },
+    { 4, "u-law" },
+    { 5, "A-law" },
+  };
+
+  unsigned failedTotal = 0;
+
+  cout << "vcml_bench: ns/sample (VcmlCodec / g711.c)" << endl;
+
+  for (PINDEX m = 0 ; m < PINDEX(PARRAYSIZE(methods)) ; m++) {
+    int cml = methods[m].cml;
+    VcmlCodec codec;
+
+    codec.Select(cml);
+
+    unsigned failed = Check(cml, codec);
+
+    failedTotal += failed;
+
+    // a voice-like signal for the speed measuring
+    for (PINDEX i = 0 ; i < benchSamples ; i++)
+      linear[i] = (PInt16)(10000*sin(i*0.05) + 3000*sin(i*0.31));
+
+    EncodeOld(cml, linear, coded, benchSamples);
+
+    double encodeNew = Bench(EncodeNew(codec));
+    double encodeOld = Bench(EncodeG711(cml));
+    double decodeNew = Bench(DecodeNew(codec));
+    double decodeOld = Bench(DecodeG711(cml));
+
+    cout << "  " << methods[m].name << ": "
+         << (failed ? "FAILED " : "OK ") << failed << "\n"
+         << "    encode: " << encodeNew << " / " << encodeOld << "\n"
+         << "    decode: " << decodeNew << " / " << decodeOld << endl;
+  }
+
+  SetTerminationValue(failedTotal ? 1 : 0);
+}
+///////////////////////////////////////////////////////////////
+
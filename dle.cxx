@@ -75,29 +75,152 @@
 #define new PNEW
 
 ///////////////////////////////////////////////////////////////
-static BYTE BitRevTable[256];
-
-static PBoolean initBitRevTable()
-{
-  for( unsigned i = 0 ; i < sizeof(BitRevTable) ; i++ ) {
-    unsigned in = i, out = 0;
-    for( int j = 0 ; j < 8 ; j++ ) {
-      out <<= 1;
-      out += in & 1;
-      in >>= 1;
-    }
-    BitRevTable[i] = (BYTE)out;
-  }
-  return TRUE;
-}
-
-static const PBoolean ___InitBitRevTable = initBitRevTable();
+static const BYTE BitRevTable[256] = {
+  0x00, 0x80, 0x40, 0xC0, 0x20, 0xA0, 0x60, 0xE0,
+  0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0,
+  0x08, 0x88, 0x48, 0xC8, 0x28, 0xA8, 0x68, 0xE8,
+  0x18, 0x98, 0x58, 0xD8, 0x38, 0xB8, 0x78, 0xF8,
+  0x04, 0x84, 0x44, 0xC4, 0x24, 0xA4, 0x64, 0xE4,
+  0x14, 0x94, 0x54, 0xD4, 0x34, 0xB4, 0x74, 0xF4,
+  0x0C, 0x8C, 0x4C, 0xCC, 0x2C, 0xAC, 0x6C, 0xEC,
+  0x1C, 0x9C, 0x5C, 0xDC, 0x3C, 0xBC, 0x7C, 0xFC,
+  0x02, 0x82, 0x42, 0xC2, 0x22, 0xA2, 0x62, 0xE2,
+  0x12, 0x92, 0x52, 0xD2, 0x32, 0xB2, 0x72, 0xF2,
+  0x0A, 0x8A, 0x4A, 0xCA, 0x2A, 0xAA, 0x6A, 0xEA,
+  0x1A, 0x9A, 0x5A, 0xDA, 0x3A, 0xBA, 0x7A, 0xFA,
+  0x06, 0x86, 0x46, 0xC6, 0x26, 0xA6, 0x66, 0xE6,
+  0x16, 0x96, 0x56, 0xD6, 0x36, 0xB6, 0x76, 0xF6,
+  0x0E, 0x8E, 0x4E, 0xCE, 0x2E, 0xAE, 0x6E, 0xEE,
+  0x1E, 0x9E, 0x5E, 0xDE, 0x3E, 0xBE, 0x7E, 0xFE,
+  0x01, 0x81, 0x41, 0xC1, 0x21, 0xA1, 0x61, 0xE1,
+  0x11, 0x91, 0x51, 0xD1, 0x31, 0xB1, 0x71, 0xF1,
+  0x09, 0x89, 0x49, 0xC9, 0x29, 0xA9, 0x69, 0xE9,
+  0x19, 0x99, 0x59, 0xD9, 0x39, 0xB9, 0x79, 0xF9,
+  0x05, 0x85, 0x45, 0xC5, 0x25, 0xA5, 0x65, 0xE5,
+  0x15, 0x95, 0x55, 0xD5, 0x35, 0xB5, 0x75, 0xF5,
+  0x0D, 0x8D, 0x4D, 0xCD, 0x2D, 0xAD, 0x6D, 0xED,
+  0x1D, 0x9D, 0x5D, 0xDD, 0x3D, 0xBD, 0x7D, 0xFD,
+  0x03, 0x83, 0x43, 0xC3, 0x23, 0xA3, 0x63, 0xE3,
+  0x13, 0x93, 0x53, 0xD3, 0x33, 0xB3, 0x73, 0xF3,
+  0x0B, 0x8B, 0x4B, 0xCB, 0x2B, 0xAB, 0x6B, 0xEB,
+  0x1B, 0x9B, 0x5B, 0xDB, 0x3B, 0xBB, 0x7B, 0xFB,
+  0x07, 0x87, 0x47, 0xC7, 0x27, 0xA7, 0x67, 0xE7,
+  0x17, 0x97, 0x57, 0xD7, 0x37, 0xB7, 0x77, 0xF7,
+  0x0F, 0x8F, 0x4F, 0xCF, 0x2F, 0xAF, 0x6F, 0xEF,
+  0x1F, 0x9F, 0x5F, 0xDF, 0x3F, 0xBF, 0x7F, 0xFF,
+};
 ///////////////////////////////////////////////////////////////
 enum {
   ETX = 0x03,
   DLE = 0x10,
 };
 ///////////////////////////////////////////////////////////////
+/*
+ * The kernels below process 8 bytes at a time in a 64-bit word
+ * (SIMD within a register) and fall back to the byte loop only
+ * for the words that contain a DLE character.
+ */
+#define SWAR(b)   ((PUInt64(0x01010101U * (b)) << 32) | (0x01010101U * (b)))
+
+static const PUInt64 swarOnes = SWAR(0x01);
+static const PUInt64 swarHighs = SWAR(0x80);
+static const PUInt64 swarDle = SWAR(DLE);
+
+inline static PBoolean HasDle(PUInt64 w)
+{
+  w ^= swarDle;
+  return ((w - swarOnes) & ~w & swarHighs) != 0;
+}
+
+inline static PUInt64 BitRev(PUInt64 w)
+{
+  w = ((w >> 4) & SWAR(0x0F)) | ((w & SWAR(0x0F)) << 4);
+  w = ((w >> 2) & SWAR(0x33)) | ((w & SWAR(0x33)) << 2);
+  w = ((w >> 1) & SWAR(0x55)) | ((w & SWAR(0x55)) << 1);
+  return w;
+}
+
+/*
+ * Copies (and bit reverses if bitRev) bytes from pSrc to pDst
+ * while there is no DLE in the source, up to count bytes.
+ * Returns the number of copied bytes.
+ */
+static PINDEX CopyNoDle(BYTE *pDst, const BYTE *pSrc, PINDEX count, PBoolean bitRev)
+{
+  PINDEX done = 0;
+
+  for ( ; count - done >= 8 ; done += 8) {
+    PUInt64 w;
+
+    memcpy(&w, pSrc + done, sizeof(w));
+
+    if (HasDle(w))
+      break;
+
+    if (bitRev)
+      w = BitRev(w);
+
+    memcpy(pDst + done, &w, sizeof(w));
+  }
+
+  for ( ; done < count ; done++) {
+    BYTE b = pSrc[done];
+
+    if (b == DLE)
+      break;
+
+    pDst[done] = bitRev ? BitRevTable[b] : b;
+  }
+
+  return done;
+}
+
+/*
+ * Copies (and bit reverses if bitRev) count bytes from pSrc to pDst
+ * doubling the DLE characters (after bit reversing).
+ * The destination can overlap the source if pDst <= pSrc and
+ * there is a room for doubling.
+ * Returns the pointer to the end of the destination.
+ */
+static BYTE *CopyDoubleDle(BYTE *pDst, const BYTE *pSrc, PINDEX count, PBoolean bitRev)
+{
+  const BYTE *pEnd = pSrc + count;
+
+  while (pEnd - pSrc >= 8) {
+    PUInt64 w;
+
+    memcpy(&w, pSrc, sizeof(w));
+
+    if (bitRev)
+      w = BitRev(w);
+
+    if (!HasDle(w)) {
+      memcpy(pDst, &w, sizeof(w));
+      pDst += sizeof(w);
+      pSrc += sizeof(w);
+      continue;
+    }
+
+    for (int i = 0 ; i < 8 ; i++) {
+      BYTE b = bitRev ? BitRevTable[*pSrc++] : *pSrc++;
+
+      if (b == DLE)
+        *pDst++ = DLE;
+      *pDst++ = b;
+    }
+  }
+
+  while (pSrc < pEnd) {
+    BYTE b = bitRev ? BitRevTable[*pSrc++] : *pSrc++;
+
+    if (b == DLE)
+      *pDst++ = DLE;
+    *pDst++ = b;
+  }
+
+  return pDst;
+}
+///////////////////////////////////////////////////////////////
 int DLEData::PutDleData(const void *pBuf, PINDEX count)
 {
   if (PutData(NULL, 0) < 0)
@@ -105,11 +228,8 @@ int DLEData::PutDleData(const void *pBuf, PINDEX count)
 
   PINDEX cRest = count;
   const BYTE *p = (const BYTE *)pBuf;
-  
-  while( cRest > 0 ) {
-    const BYTE *pScan = p;
-    PINDEX cScan = cRest;
 
+  while (cRest > 0) {
     if (dle) {
       dle = FALSE;
       if (*p != DLE) {
@@ -121,43 +241,43 @@ int DLEData::PutDleData(const void *pBuf, PINDEX count)
 
         p++;
         cRest--;
+        continue;
       }
-      pScan++;
-      cScan--;
+
+      PutData(bitRev ? &BitRevTable[DLE] : p, 1);
+      p++;
+      cRest--;
+      continue;
     }
 
-    const BYTE *pDle = (const BYTE *)memchr(pScan, DLE, cScan);
-    
     PINDEX cPut;
-    PINDEX cDone;
-  
-    if( pDle ) {
-      dle = TRUE;
-      cPut = PINDEX(pDle - p);
-      cDone = cPut + 1;	// skip DLE
+
+    if (bitRev) {
+      BYTE tmp[1024];
+
+      cPut = CopyNoDle(tmp, p, cRest > PINDEX(sizeof(tmp)) ? PINDEX(sizeof(tmp)) : cRest, TRUE);
+
+      if (cPut)
+        PutData(tmp, cPut);
     } else {
-      cDone = cPut = cRest;
-    }
-  
-    if( cPut ) {
-      if( bitRev ) {
-        BYTE tmp[1024];
-        while( cPut ) {
-          PINDEX cTmp = cPut > 1024 ? 1024 : cPut;
-          for( PINDEX i = 0 ; i < cTmp ; i++ ) {
-            tmp[i] = BitRevTable[p[i]];
-          }
-          PutData(tmp, cTmp);
-          cPut -= cTmp;
-        }
-      } else {
+      const BYTE *pDle = (const BYTE *)memchr(p, DLE, cRest);
+
+      cPut = pDle ? PINDEX(pDle - p) : cRest;
+
+      if (cPut)
         PutData(p, cPut);
-      }
     }
-    p += cDone;
-    cRest -= cDone;
+
+    p += cPut;
+    cRest -= cPut;
+
+    if (cRest > 0 && *p == DLE) {
+      dle = TRUE;
+      p++;
+      cRest--;
+    }
   }
-  
+
   return count - cRest;
 }
 
@@ -171,12 +291,14 @@ int DLEData::GetDleData(void *pBuf, PINDEX count)
 
   for (done = 0 ; (count - done) >= 4 ; done = int(p - (BYTE *)pBuf)) {
     PINDEX cGet = (count - done - 2) / 2;
-    BYTE tmp[1024];
 
-    if (cGet > (PINDEX)sizeof(tmp))
-      cGet = sizeof(tmp);
+    /*
+     * Get the data to the tail of the buffer and expand it in place,
+     * the read position is always ahead of the write one
+     */
+    BYTE *pGet = (BYTE *)pBuf + count - cGet;
 
-    switch( cGet = GetData(tmp, cGet) ) {
+    switch( cGet = GetData(pGet, cGet) ) {
       case -1:
         *p++ = DLE;
         *p++ = ETX;
@@ -185,15 +307,9 @@ int DLEData::GetDleData(void *pBuf, PINDEX count)
       case 0:
         return int(p - (BYTE *)pBuf);
       default:
-        for( PINDEX i = 0 ; i < cGet ; i++ ) {
-          BYTE b = bitRev ? BitRevTable[tmp[i]] : tmp[i];
-          if( b == DLE )
-            *p++ = DLE;
-          *p++ = b;
-        }
+        p = CopyDoubleDle(p, pGet, cGet, bitRev);
     }
   }
   return done;
 }
 ///////////////////////////////////////////////////////////////
-
@@ -46,6 +46,7 @@
 #include "drivers.h"
 #include "drv_pty.h"
 #include "drv_c0c.h"
+#include "drv_api.h"
 
 ///////////////////////////////////////////////////////////////
 
@@ -125,6 +126,9 @@ static int addDriver(
 #ifdef MODEM_DRIVER_C0C
   DECLARE_MODEM_DRIVER("C0C", C0C)
 #endif
+#ifdef MODEM_DRIVER_Api
+  DECLARE_MODEM_DRIVER("API", Api)
+#endif
 ///////////////////////////////////////////////////////////////
 PseudoModem *PseudoModemDrivers::CreateModem(
     const PString &tty,
@@ -163,7 +167,9 @@ PseudoModem *PseudoModemDrivers::CreateModem(
 
 PString PseudoModemDrivers::ArgSpec()
 {
-  PString argSpec;
+  PString argSpec =
+    "-pty-queue:"
+  ;
 
   for (int i = 0 ; i < numDrivers ; i++)
     argSpec += drivers[i].ArgSpec();
@@ -173,7 +179,15 @@ PString PseudoModemDrivers::ArgSpec()
 
 PStringArray PseudoModemDrivers::Descriptions()
 {
-  PStringArray descriptions;
+  PStringArray descriptions = PString(
+    "Options for all drivers:\n"
+    "  --pty-queue [tty=]high[:low][,...]\n"
+    "                        : Block the writer to the tty queues while\n"
+    "                          they have high bytes till they have low bytes.\n"
+    "                          Default is 2048:1024, default low is high/2.\n"
+    "                          The values without tty= are for all ttys.\n"
+    "                          Can be used multiple times.\n"
+  ).Lines();
 
   for (int i = 0 ; i < numDrivers ; i++) {
     descriptions.Append(new PString(drivers[i].name));
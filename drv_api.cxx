@@ -0,0 +1,258 @@
+/*
+ * drv_api.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#include <ptlib.h>
+#include "drv_api.h"
+#include "t38modem_api.h"
+
+#ifdef MODEM_DRIVER_Api
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+#define TTY_PREFIX "api:"
+
+PDICTIONARY(_PseudoModemApiIndex, PString, PseudoModemApi);
+
+static PMutex apiIndexMutex;
+
+static _PseudoModemApiIndex &ApiIndex()
+{
+  static _PseudoModemApiIndex *index = NULL;
+
+  if (index == NULL) {
+    index = new _PseudoModemApiIndex;
+    index->DisallowDeleteObjects();
+  }
+
+  return *index;
+}
+///////////////////////////////////////////////////////////////
+PseudoModemApi::PseudoModemApi(
+    const PString &_tty,
+    const PString &_route,
+    const PConfigArgs &args,
+    const PNotifier &_callbackEndPoint)
+
+  : PseudoModemBody(_tty, _route, args, _callbackEndPoint),
+    ttypath(_tty),
+    readyCallback(NULL),
+    readyArg(NULL)
+{
+  if (!CheckTty(_tty)) {
+    myPTRACE(1, "PseudoModemApi::PseudoModemApi bad on " << _tty);
+    return;
+  }
+
+  ptyname = _tty.Mid(sizeof(TTY_PREFIX) - 1);
+
+  PWaitAndSignal mutexWait(apiIndexMutex);
+
+  if (ApiIndex().Contains(ptyname)) {
+    myPTRACE(1, "PseudoModemApi::PseudoModemApi " << _tty << " already exists");
+    return;
+  }
+
+  ApiIndex().SetAt(ptyname, this);
+  valid = TRUE;
+}
+
+PseudoModemApi::~PseudoModemApi()
+{
+  StopAll();
+
+  if (valid) {
+    PWaitAndSignal mutexWait(apiIndexMutex);
+    ApiIndex().RemoveAt(ptyname);
+  }
+}
+
+PBoolean PseudoModemApi::CheckTty(const PString &_tty)
+{
+  return _tty.GetLength() > (PINDEX)(sizeof(TTY_PREFIX) - 1) &&
+         _tty.Left(sizeof(TTY_PREFIX) - 1) == TTY_PREFIX;
+}
+
+PString PseudoModemApi::ArgSpec()
+{
+  return "";
+}
+
+PStringArray PseudoModemApi::Description()
+{
+  PStringArray descriptions = PString(
+        "Uses the buffers handed off in the same process to communicate with\n"
+        "a fax application linked with t38modem (see drv_api.h and\n"
+        "t38modem_api.h).\n"
+        "The tty should be '" TTY_PREFIX "name', where name is used by the application\n"
+        "to find the modem.\n"
+  ).Lines();
+
+  return descriptions;
+}
+
+PseudoModemApi *PseudoModemApi::Find(const PString &name)
+{
+  PWaitAndSignal mutexWait(apiIndexMutex);
+  return ApiIndex().GetAt(name);
+}
+
+PBoolean PseudoModemApi::Write(PBYTEArray *buf)
+{
+  if (buf == NULL)
+    return FALSE;
+
+  return PassToInPtyQ(buf);
+}
+
+PBYTEArray *PseudoModemApi::Read(const PTimeInterval &timeout)
+{
+  PTime timeStart;
+
+  for (;;) {
+    PBYTEArray *buf = FromOutPtyQ();
+
+    if (buf != NULL || stop)
+      return buf;
+
+    PTimeInterval left = timeout - (PTime() - timeStart);
+
+    if (left <= 0 || !outReady.Wait(left))
+      return FromOutPtyQ();
+  }
+}
+
+void PseudoModemApi::SetReadyCallback(ReadyCallback callback, void *arg)
+{
+  PWaitAndSignal mutexWait(Mutex);
+
+  readyCallback = callback;
+  readyArg = arg;
+}
+
+const PString &PseudoModemApi::ttyPath() const
+{
+  return ttypath;
+}
+
+ModemThreadChild *PseudoModemApi::GetPtyNotifier()
+{
+  return NULL;
+}
+
+PBoolean PseudoModemApi::SignalOutPtyQ()
+{
+  // called with locked Mutex
+
+  outReady.Signal();
+
+  if (readyCallback != NULL)
+    readyCallback(readyArg);
+
+  return TRUE;
+}
+
+void PseudoModemApi::StopAll()
+{
+  PseudoModemBody::StopAll();
+
+  // wake up the blocked reader
+  outReady.Signal();
+}
+
+void PseudoModemApi::MainLoop()
+{
+  if (AddModem()) {
+    while (!stop && StartAll()) {
+      while (!stop && !childstop) {
+        WaitDataReady();
+      }
+      StopAll();
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+extern "C" {
+
+t38modem_dte *t38modem_dte_find(const char *name)
+{
+  return (t38modem_dte *)PseudoModemApi::Find(name);
+}
+
+t38modem_buf *t38modem_buf_alloc(int size, unsigned char **data)
+{
+  PBYTEArray *buf = new PBYTEArray(size > 0 ? size : 0);
+
+  if (data != NULL)
+    *data = buf->GetPointer();
+
+  return (t38modem_buf *)buf;
+}
+
+const unsigned char *t38modem_buf_data(const t38modem_buf *buf, int *size)
+{
+  const PBYTEArray *array = (const PBYTEArray *)buf;
+
+  if (size != NULL)
+    *size = array->GetSize();
+
+  return *array;
+}
+
+void t38modem_buf_free(t38modem_buf *buf)
+{
+  delete (PBYTEArray *)buf;
+}
+
+int t38modem_dte_write(t38modem_dte *dte, t38modem_buf *buf, int size)
+{
+  PBYTEArray *array = (PBYTEArray *)buf;
+
+  if (size >= 0 && size < array->GetSize())
+    array->SetSize(size);
+
+  return ((PseudoModemApi *)dte)->Write(array) ? 0 : -1;
+}
+
+int t38modem_dte_write_free(t38modem_dte *dte)
+{
+  return ((PseudoModemApi *)dte)->WriteFree();
+}
+
+t38modem_buf *t38modem_dte_read(t38modem_dte *dte, int timeout_ms)
+{
+  return (t38modem_buf *)((PseudoModemApi *)dte)->Read(timeout_ms > 0 ? timeout_ms : 0);
+}
+
+void t38modem_dte_set_notify(t38modem_dte *dte, void (*notify)(void *arg), void *arg)
+{
+  ((PseudoModemApi *)dte)->SetReadyCallback(notify, arg);
+}
+
+} // extern "C"
+///////////////////////////////////////////////////////////////
+
+#endif // MODEM_DRIVER_Api
+
@@ -0,0 +1,126 @@
+/*
+ * drv_api.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#ifndef _DRV_API_H
+#define _DRV_API_H
+
+#define MODEM_DRIVER_Api
+
+#ifdef MODEM_DRIVER_Api
+
+#include "pmodemi.h"
+
+///////////////////////////////////////////////////////////////
+/*
+ * In-process DTE.
+ *
+ * Instead of a tty the fax application of the same process
+ * exchanges the DTE data (AT commands and Class 1 DLE streams)
+ * with the modem engine by the buffers handed off to and from the
+ * modem queues without copying (see also t38modem_api.h for the
+ * plain C interface).
+ */
+class PseudoModemApi : public PseudoModemBody
+{
+    PCLASSINFO(PseudoModemApi, PseudoModemBody);
+
+  public:
+    typedef void (*ReadyCallback)(void *arg);
+
+  /**@name Construction */
+  //@{
+    PseudoModemApi(
+      const PString &_tty,
+      const PString &_route,
+      const PConfigArgs &args,
+      const PNotifier &_callbackEndPoint
+    );
+    ~PseudoModemApi();
+  //@}
+
+  /**@name static functions */
+  //@{
+    static PBoolean CheckTty(const PString &_tty);
+    static PString ArgSpec();
+    static PStringArray Description();
+
+    /*
+     * Returns the modem created for the tty api:name or NULL
+     * (the modem lives till the end point is destroyed)
+     */
+    static PseudoModemApi *Find(const PString &name);
+  //@}
+
+  /**@name DTE operations */
+  //@{
+    /*
+     * Hands off the DTE data to the modem (buf is deleted by the
+     * modem). Blocks while the modem queue is at the pty-queue high
+     * watermark till it's drained to the low one.
+     * Returns FALSE if the modem is not started.
+     */
+    PBoolean Write(PBYTEArray *buf);
+
+    /*
+     * Returns the number of bytes the modem can accept without
+     * blocking Write()
+     */
+    PINDEX WriteFree() const { return InPtyQFree(); }
+
+    /*
+     * Takes the data from the modem (the caller should delete buf)
+     * or returns NULL on timeout
+     */
+    PBYTEArray *Read(const PTimeInterval &timeout);
+
+    /*
+     * Sets the function called by the modem engine thread when the
+     * data from the modem is ready to read (should not block)
+     */
+    void SetReadyCallback(ReadyCallback callback, void *arg);
+  //@}
+
+  protected:
+  /**@name Overrides from class PseudoModemBody */
+  //@{
+    const PString &ttyPath() const;
+    ModemThreadChild *GetPtyNotifier();
+    PBoolean SignalOutPtyQ();
+    void StopAll();
+    void MainLoop();
+  //@}
+
+  private:
+    PString ttypath;
+    PSyncPoint outReady;
+    ReadyCallback readyCallback;
+    void *readyArg;
+};
+///////////////////////////////////////////////////////////////
+
+#endif // MODEM_DRIVER_Api
+
+#endif // _DRV_API_H
+
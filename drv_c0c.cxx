@@ -468,10 +468,10 @@ void OutC0C::Main()
 PseudoModemC0C::PseudoModemC0C(
     const PString &_tty,
     const PString &_route,
-    const PConfigArgs &/*args*/,
+    const PConfigArgs &args,
     const PNotifier &_callbackEndPoint)
 
-  : PseudoModemBody(_tty, _route, _callbackEndPoint),
+  : PseudoModemBody(_tty, _route, args, _callbackEndPoint),
     hC0C(INVALID_HANDLE_VALUE),
     inC0C(NULL),
     outC0C(NULL),
@@ -98,6 +98,11 @@
 
 #include <sys/poll.h>
 
+#ifdef PTY_REACTOR
+  #include <sys/epoll.h>
+  #include <sys/eventfd.h>
+#endif
+
 #define new PNEW
 
 ///////////////////////////////////////////////////////////////
@@ -258,6 +263,511 @@ void OutPty::Main()
   myPTRACE(1, "<-- Stopped" << GetThreadTimes(", CPU usage: "));
 }
 ///////////////////////////////////////////////////////////////
+#ifdef PTY_REACTOR
+/*
+ * Reactor thread multiplexing the pty masters of many modems by epoll
+ * (instead of own InPty and OutPty threads for each modem).
+ */
+class PtyReactor : public PThread
+{
+    PCLASSINFO(PtyReactor, PThread);
+  public:
+    static PtyReactor *Get(unsigned threads);
+
+    PBoolean Add(ReactorPty &pty);
+    void Remove(ReactorPty &pty);
+
+  protected:
+    PtyReactor(unsigned _num);
+    ~PtyReactor();
+    PBoolean IsValid() const { return hEpoll >= 0 && hEvent >= 0; }
+    virtual void Main();
+
+    const unsigned num;
+    int hEpoll;
+    int hEvent;
+
+    PMutex Mutex;
+    ReactorPty *first;		// all added ptys
+    ReactorPty *removed;	// removed ptys waiting for acknowledgement
+    unsigned count;
+    unsigned countThrottled;
+
+    static PMutex poolMutex;
+    static PtyReactor **pool;
+    static unsigned poolSize;
+
+    friend class ReactorPty;
+};
+///////////////////////////////////////////////////////////////
+class ReactorPty : public PObject
+{
+    PCLASSINFO(ReactorPty, PObject);
+  public:
+    ReactorPty(PseudoModemPty &_parent, int _hPty);
+    ~ReactorPty();
+
+    PBoolean Start(unsigned threads);
+    void Stop();
+    void SignalOutData();
+    void SignalInDrained();
+
+  protected:
+    void OnEvents(DWORD events);
+    void OnThrottled();
+    PBoolean Read();
+    PBoolean Write();
+    void UpdateEvents();
+    void Fail();
+
+    PseudoModemPty &parent;
+    const int hPty;
+    PtyReactor *reactor;
+
+    PMutex Mutex;
+    PBoolean outArmed;		// waiting for EPOLLOUT
+    PBoolean inThrottled;	// inPtyQ is full, not waiting for EPOLLIN
+    PBoolean failed;		// removed from epoll
+
+    PBYTEArray *buf;
+    PINDEX done;
+
+    ReactorPty *next;
+    ReactorPty *nextRemoved;
+    PSyncPoint removedSyncPoint;
+
+    friend class PtyReactor;
+};
+///////////////////////////////////////////////////////////////
+PMutex PtyReactor::poolMutex;
+PtyReactor **PtyReactor::pool = NULL;
+unsigned PtyReactor::poolSize = 0;
+
+PtyReactor *PtyReactor::Get(unsigned threads)
+{
+  PWaitAndSignal mutexWait(poolMutex);
+
+  if (!pool) {
+    pool = new PtyReactor *[threads];
+
+    for (unsigned i = 0 ; i < threads ; i++) {
+      PtyReactor *reactor = new PtyReactor(i);
+
+      if (!reactor->IsValid()) {
+        delete reactor;
+        continue;
+      }
+
+      reactor->Resume();
+      pool[poolSize++] = reactor;
+    }
+  }
+
+  PtyReactor *reactor = NULL;
+
+  for (unsigned i = 0 ; i < poolSize ; i++) {
+    if (!reactor || reactor->count > pool[i]->count)
+      reactor = pool[i];
+  }
+
+  return reactor;
+}
+
+PtyReactor::PtyReactor(unsigned _num)
+  : PThread(30000,
+            NoAutoDeleteThread,
+            HighPriority),
+    num(_num),
+    hEpoll(-1),
+    hEvent(-1),
+    first(NULL),
+    removed(NULL),
+    count(0),
+    countThrottled(0)
+{
+  if ((hEpoll = ::epoll_create(64)) < 0) {
+    int err = errno;
+    myPTRACE(1, "PtyReactor::PtyReactor epoll_create ERROR: " << strerror(err));
+    return;
+  }
+
+  if ((hEvent = ::eventfd(0, 0)) < 0) {
+    int err = errno;
+    myPTRACE(1, "PtyReactor::PtyReactor eventfd ERROR: " << strerror(err));
+    return;
+  }
+
+  epoll_event event;
+
+  event.events = EPOLLIN;
+  event.data.ptr = this;
+
+  if (::epoll_ctl(hEpoll, EPOLL_CTL_ADD, hEvent, &event) != 0) {
+    int err = errno;
+    myPTRACE(1, "PtyReactor::PtyReactor epoll_ctl ERROR: " << strerror(err));
+    ::close(hEvent);
+    hEvent = -1;
+  }
+}
+
+PtyReactor::~PtyReactor()
+{
+  if (hEvent >= 0)
+    ::close(hEvent);
+
+  if (hEpoll >= 0)
+    ::close(hEpoll);
+}
+
+PBoolean PtyReactor::Add(ReactorPty &pty)
+{
+  PWaitAndSignal mutexWait(Mutex);
+
+  epoll_event event;
+
+  event.events = EPOLLIN | EPOLLOUT;
+  event.data.ptr = &pty;
+
+  if (::epoll_ctl(hEpoll, EPOLL_CTL_ADD, pty.hPty, &event) != 0) {
+    int err = errno;
+    myPTRACE(1, "PtyReactor::Add epoll_ctl ERROR: " << strerror(err));
+    return FALSE;
+  }
+
+  pty.next = first;
+  first = &pty;
+  count++;
+
+  return TRUE;
+}
+
+void PtyReactor::Remove(ReactorPty &pty)
+{
+  {
+    PWaitAndSignal mutexWait(Mutex);
+
+    for (ReactorPty **pp = &first ; *pp ; pp = &(*pp)->next) {
+      if (*pp == &pty) {
+        *pp = pty.next;
+        break;
+      }
+    }
+
+    count--;
+
+    if (pty.inThrottled)
+      countThrottled--;
+
+    PBoolean failed = pty.failed;
+
+    {
+      PWaitAndSignal mutexWait(pty.Mutex);
+      pty.failed = TRUE;	// disable SignalOutData()
+    }
+
+    if (failed)
+      return;	// already removed from epoll by reactor thread
+
+    ::epoll_ctl(hEpoll, EPOLL_CTL_DEL, pty.hPty, NULL);
+
+    /*
+     * The events for pty could be already got by epoll_wait(),
+     * so wait for reactor thread to forget them
+     */
+    pty.nextRemoved = removed;
+    removed = &pty;
+    ::eventfd_write(hEvent, 1);
+  }
+
+  pty.removedSyncPoint.Wait();
+}
+
+void PtyReactor::Main()
+{
+  RenameCurrentThread(PString("reactor") + PString(PString::Unsigned, num));
+  myPTRACE(1, "Started");
+
+  for (;;) {
+    epoll_event events[64];
+
+    int n = ::epoll_wait(hEpoll, events, PARRAYSIZE(events), -1);
+
+    if (n < 0) {
+      int err = errno;
+
+      if (err != EINTR) {
+        myPTRACE(1, "epoll_wait ERROR: " << strerror(err));
+        PThread::Sleep(10);
+      }
+
+      n = 0;
+    }
+
+    PWaitAndSignal mutexWait(Mutex);
+
+    while (removed) {
+      ReactorPty *pty = removed;
+
+      removed = pty->nextRemoved;
+
+      for (int i = 0 ; i < n ; i++) {
+        if (events[i].data.ptr == pty)
+          events[i].data.ptr = NULL;
+      }
+
+      pty->removedSyncPoint.Signal();
+    }
+
+    for (int i = 0 ; i < n ; i++) {
+      if (events[i].data.ptr == this) {
+        eventfd_t value;
+        ::eventfd_read(hEvent, &value);
+      }
+      else
+      if (events[i].data.ptr != NULL) {
+        ((ReactorPty *)events[i].data.ptr)->OnEvents(events[i].events);
+      }
+    }
+
+    if (countThrottled) {
+      for (ReactorPty *pty = first ; pty ; pty = pty->next) {
+        if (pty->inThrottled)
+          pty->OnThrottled();
+      }
+    }
+  }
+}
+///////////////////////////////////////////////////////////////
+ReactorPty::ReactorPty(PseudoModemPty &_parent, int _hPty)
+  : parent(_parent),
+    hPty(_hPty),
+    reactor(NULL),
+    outArmed(TRUE),
+    inThrottled(FALSE),
+    failed(FALSE),
+    buf(NULL),
+    done(0),
+    next(NULL),
+    nextRemoved(NULL)
+{
+}
+
+ReactorPty::~ReactorPty()
+{
+  Stop();
+
+  if (buf) {
+    if (buf->GetSize() != done)
+      myPTRACE(1, parent.ptyName() << " <-- Not sent " << PRTHEX(PBYTEArray((const BYTE *)*buf + done, buf->GetSize() - done)));
+    delete buf;
+  }
+}
+
+PBoolean ReactorPty::Start(unsigned threads)
+{
+  if ((reactor = PtyReactor::Get(threads)) == NULL)
+    return FALSE;
+
+  int flags = ::fcntl(hPty, F_GETFL);
+
+  if (flags < 0 || ::fcntl(hPty, F_SETFL, flags | O_NONBLOCK) < 0) {
+    int err = errno;
+    myPTRACE(1, parent.ptyName() << " ReactorPty::Start fcntl ERROR: " << strerror(err));
+    reactor = NULL;
+    return FALSE;
+  }
+
+  if (!reactor->Add(*this)) {
+    reactor = NULL;
+    return FALSE;
+  }
+
+  myPTRACE(1, parent.ptyName() << " ReactorPty::Start reactor" << reactor->num);
+
+  return TRUE;
+}
+
+void ReactorPty::Stop()
+{
+  if (reactor) {
+    reactor->Remove(*this);
+    reactor = NULL;
+  }
+}
+
+void ReactorPty::SignalOutData()
+{
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (failed || outArmed)
+    return;
+
+  outArmed = TRUE;
+  UpdateEvents();
+}
+
+/*
+ * Called by the consumer of inPtyQ if it was drained to the low
+ * watermark, wakes up the reactor thread to resume reading
+ */
+void ReactorPty::SignalInDrained()
+{
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (failed || !inThrottled)
+    return;
+
+  ::eventfd_write(reactor->hEvent, 1);
+}
+
+void ReactorPty::UpdateEvents()
+{
+  epoll_event event;
+
+  event.events = (inThrottled ? 0 : EPOLLIN) | (outArmed ? EPOLLOUT : 0);
+  event.data.ptr = this;
+
+  if (::epoll_ctl(reactor->hEpoll, EPOLL_CTL_MOD, hPty, &event) != 0) {
+    int err = errno;
+    myPTRACE(1, parent.ptyName() << " ReactorPty::UpdateEvents epoll_ctl ERROR: " << strerror(err));
+  }
+}
+
+void ReactorPty::Fail()
+{
+  {
+    PWaitAndSignal mutexWait(Mutex);
+    failed = TRUE;
+    ::epoll_ctl(reactor->hEpoll, EPOLL_CTL_DEL, hPty, NULL);
+  }
+
+  parent.SignalChildStop();
+}
+
+void ReactorPty::OnEvents(DWORD events)
+{
+  if (failed)
+    return;
+
+  if (inThrottled) {
+    if (events & (EPOLLHUP | EPOLLERR)) {
+      Fail();
+      return;
+    }
+  }
+  else
+  if (events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+    if (!Read()) {
+      Fail();
+      return;
+    }
+  }
+
+  if (events & EPOLLOUT) {
+    if (!Write()) {
+      Fail();
+      return;
+    }
+  }
+}
+
+void ReactorPty::OnThrottled()
+{
+  if (failed || parent.InPtyQFree() == 0)
+    return;
+
+  PWaitAndSignal mutexWait(Mutex);
+
+  inThrottled = FALSE;
+  reactor->countThrottled--;
+  UpdateEvents();
+}
+
+PBoolean ReactorPty::Read()
+{
+  PINDEX len = parent.InPtyQFree();
+
+  if (len == 0) {
+    PWaitAndSignal mutexWait(Mutex);
+
+    /*
+     * Recheck under Mutex, else the consumer could drain the queue
+     * before inThrottled is set and SignalInDrained() would miss it
+     */
+    if (parent.InPtyQFree() == 0) {
+      inThrottled = TRUE;
+      reactor->countThrottled++;
+      UpdateEvents();
+    }
+
+    return TRUE;
+  }
+
+  char cbuf[1024];
+
+  if (len > PINDEX(sizeof(cbuf)))
+    len = sizeof(cbuf);
+
+  len = ::read(hPty, cbuf, len);
+
+  if (len < 0) {
+    int err = errno;
+
+    if (err == EAGAIN || err == EINTR)
+      return TRUE;
+
+    myPTRACE(1, parent.ptyName() << " --> read ERROR " << len << " " << strerror(err));
+    return FALSE;
+  }
+
+  if (len == 0)
+    return FALSE;
+
+  parent.ToInPtyQ(cbuf, len);
+
+  return TRUE;
+}
+
+PBoolean ReactorPty::Write()
+{
+  for (;;) {
+    if (!buf) {
+      PWaitAndSignal mutexWait(Mutex);
+
+      buf = parent.FromOutPtyQ();
+
+      if (!buf) {
+        outArmed = FALSE;
+        UpdateEvents();
+        return TRUE;
+      }
+
+      done = 0;
+    }
+
+    int len = ::write(hPty, (const BYTE *)*buf + done, buf->GetSize() - done);
+
+    if (len < 0) {
+      int err = errno;
+
+      if (err == EAGAIN || err == EINTR)
+        return TRUE;
+
+      myPTRACE(1, parent.ptyName() << " <-- write ERROR " << len << " " << strerror(err));
+      return FALSE;
+    }
+
+    done += len;
+
+    if (buf->GetSize() > done)
+      return TRUE;
+
+    delete buf;
+    buf = NULL;
+  }
+}
+#endif // PTY_REACTOR
+///////////////////////////////////////////////////////////////
 #ifdef USE_LEGACY_PTY
 static const char *ttyPatternLegacy()
 {
@@ -315,20 +825,29 @@ static void ttyUnlinkUnix98(const char *ttypath)
 PseudoModemPty::PseudoModemPty(
     const PString &_tty,
     const PString &_route,
-#ifdef USE_UNIX98_PTY
     const PConfigArgs &args,
-#else
-    const PConfigArgs &/*args*/,
-#endif
     const PNotifier &_callbackEndPoint)
 
-  : PseudoModemBody(_tty, _route, _callbackEndPoint),
+  : PseudoModemBody(_tty, _route, args, _callbackEndPoint),
     hPty(-1),
     inPty(NULL),
     outPty(NULL)
+#ifdef PTY_REACTOR
+    , reactorPty(NULL)
+    , reactorThreads(0)
+#endif
 {
   valid = TRUE;
 
+#ifdef PTY_REACTOR
+  if (args.HasOption("pty-reactor")) {
+    reactorThreads = args.GetOptionString("pty-reactor").AsUnsigned();
+
+    if (reactorThreads == 0)
+      reactorThreads = 1;
+  }
+#endif
+
 #ifdef USE_LEGACY_PTY
   if (ttyCheckLegacy(_tty)) {
     if (_tty[0] != '/')
@@ -396,6 +915,9 @@ PString PseudoModemPty::ArgSpec()
   return
 #ifdef USE_UNIX98_PTY
         "-pts-dir:"
+#endif
+#ifdef PTY_REACTOR
+        "-pty-reactor:"
 #endif
         "";
 }
@@ -415,6 +937,14 @@ PStringArray PseudoModemPty::Description()
         "Options:\n"
         "  --pts-dir dir         : Set a base directory for Unix98 scheme,\n"
         "                          default is empty.\n"
+#endif
+#ifdef PTY_REACTOR
+#ifndef USE_UNIX98_PTY
+        "Options:\n"
+#endif
+        "  --pty-reactor num     : Serve the ptys of all modems by num threads\n"
+        "                          with epoll instead of two own threads for\n"
+        "                          each modem.\n"
 #endif
   ).Lines();
 
@@ -431,8 +961,45 @@ ModemThreadChild *PseudoModemPty::GetPtyNotifier()
   return outPty;
 }
 
+#ifdef PTY_REACTOR
+PBoolean PseudoModemPty::SignalOutPtyQ()
+{
+  if (reactorPty) {
+    reactorPty->SignalOutData();
+    return TRUE;
+  }
+
+  return PseudoModemBody::SignalOutPtyQ();
+}
+
+void PseudoModemPty::SignalInPtyQDrained()
+{
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (reactorPty)
+    reactorPty->SignalInDrained();
+}
+#endif
+
 PBoolean PseudoModemPty::StartAll()
 {
+#ifdef PTY_REACTOR
+  if (reactorThreads) {
+    if (IsOpenPty()) {
+      {
+        PWaitAndSignal mutexWait(Mutex);
+        reactorPty = new ReactorPty(*this, hPty);
+      }
+
+      if (PseudoModemBody::StartAll() && reactorPty->Start(reactorThreads))
+        return TRUE;
+    }
+    StopAll();
+    ClosePty();
+    return FALSE;
+  }
+#endif
+
   if (IsOpenPty()
      && (inPty = new InPty(*this, hPty))
      && (outPty = new OutPty(*this, hPty))
@@ -449,6 +1016,14 @@ PBoolean PseudoModemPty::StartAll()
 
 void PseudoModemPty::StopAll()
 {
+#ifdef PTY_REACTOR
+  if (reactorPty) {
+    reactorPty->Stop();
+    PWaitAndSignal mutexWait(Mutex);
+    delete reactorPty;
+    reactorPty = NULL;
+  }
+#endif
   if (inPty) {
     inPty->SignalStop();
     inPty->WaitForTermination();
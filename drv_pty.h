@@ -62,11 +62,18 @@
 
 #ifdef MODEM_DRIVER_Pty
 
+#ifdef P_LINUX
+  #define PTY_REACTOR
+#endif
+
 #include "pmodemi.h"
 
 ///////////////////////////////////////////////////////////////
 class InPty;
 class OutPty;
+#ifdef PTY_REACTOR
+class ReactorPty;
+#endif
 
 class PseudoModemPty : public PseudoModemBody
 {
@@ -96,6 +103,10 @@ class PseudoModemPty : public PseudoModemBody
   //@{
     const PString &ttyPath() const;
     ModemThreadChild *GetPtyNotifier();
+#ifdef PTY_REACTOR
+    PBoolean SignalOutPtyQ();
+    void SignalInPtyQDrained();
+#endif
     PBoolean StartAll();
     void StopAll();
     void MainLoop();
@@ -109,12 +120,19 @@ class PseudoModemPty : public PseudoModemBody
     int hPty;
     InPty *inPty;
     OutPty *outPty;
+#ifdef PTY_REACTOR
+    ReactorPty *reactorPty;
+    unsigned reactorThreads;	// 0 - use own InPty and OutPty threads
+#endif
 
     PString ptypath;
     PString ttypath;
 
     friend class InPty;
     friend class OutPty;
+#ifdef PTY_REACTOR
+    friend class ReactorPty;
+#endif
 };
 ///////////////////////////////////////////////////////////////
 
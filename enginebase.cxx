@@ -146,6 +146,9 @@ EngineBase::~EngineBase()
 
   if (!modemCallback.IsNULL())
     myPTRACE(1, name << " ~EngineBase WARNING: !modemCallback.IsNULL()");
+
+  for (const FreeListPool *pool = FreeListPool::First() ; pool != NULL ; pool = pool->Next())
+    PTRACE(2, name << " " << *pool);
 }
 
 PBoolean EngineBase::Attach(const PNotifier &callback)
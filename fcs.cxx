@@ -47,20 +47,56 @@
 #define new PNEW
 
 ///////////////////////////////////////////////////////////////
-void FCS::build(const void *_pBuf, PINDEX count)
+/*
+ * Slicing-by-8 tables for CRC-16/CCITT (x^16 + x^12 + x^5 + 1, MSB first).
+ *
+ * FcsTable[0][i] is the CRC of the byte i, FcsTable[k][i] is the CRC of
+ * the byte i followed by k zero bytes.
+ */
+static WORD FcsTable[8][256];
+
+static PBoolean initFcsTable()
 {
-  const BYTE *pBuf = (const BYTE *)_pBuf;
+  for (unsigned i = 0 ; i < 256 ; i++) {
+    WORD crc = WORD(i << 8);
+
+    for (int j = 0 ; j < 8 ; j++)
+      crc = WORD((crc & 0x8000) ? (crc << 1) ^ 0x1021 : (crc << 1));
+
+    FcsTable[0][i] = crc;
+  }
+
+  for (int k = 1 ; k < 8 ; k++) {
+    for (unsigned i = 0 ; i < 256 ; i++) {
+      WORD crc = FcsTable[k - 1][i];
 
-  for (PINDEX i = 0 ; i < count ; i++) {
-    BYTE c = *(pBuf++);
-    for (BYTE m = 0x80 ; m ; m >>= 1) {
-	fcs <<= 1;
-        if (c & m)
-	  fcs ^= 0x10000;
-	if (fcs & 0x10000)
-          fcs ^= 0x11021;
+      FcsTable[k][i] = WORD((crc << 8) ^ FcsTable[0][crc >> 8]);
     }
   }
+  return TRUE;
 }
+
+static const PBoolean ___InitFcsTable = initFcsTable();
 ///////////////////////////////////////////////////////////////
+void FCS::build(const void *_pBuf, PINDEX count)
+{
+  const BYTE *pBuf = (const BYTE *)_pBuf;
+  WORD crc = WORD(fcs);
 
+  for ( ; count >= 8 ; count -= 8, pBuf += 8) {
+    crc = WORD(FcsTable[7][BYTE(crc >> 8) ^ pBuf[0]] ^
+               FcsTable[6][BYTE(crc) ^ pBuf[1]] ^
+               FcsTable[5][pBuf[2]] ^
+               FcsTable[4][pBuf[3]] ^
+               FcsTable[3][pBuf[4]] ^
+               FcsTable[2][pBuf[5]] ^
+               FcsTable[1][pBuf[6]] ^
+               FcsTable[0][pBuf[7]]);
+  }
+
+  for ( ; count > 0 ; count--)
+    crc = WORD((crc << 8) ^ FcsTable[0][BYTE(crc >> 8) ^ *(pBuf++)]);
+
+  fcs = crc;
+}
+///////////////////////////////////////////////////////////////
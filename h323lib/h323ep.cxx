@@ -235,7 +235,11 @@ PString MyH323EndPoint::ArgSpec()
              "p-ptty:"
              "-route:"
              "-redundancy:"
+             "-max-redundancy:"
              "-repeat:"
+             "-fec:"
+             "-aggregate:"
+             "-packet-interval:"
              "-old-asn."
 
              "F-fastenable."
@@ -257,12 +261,21 @@ PString MyH323EndPoint::ArgSpec()
 PStringArray MyH323EndPoint::Descriptions()
 {
   PStringArray descriptions = PString(
-        "  -p --ptty [num@]tty[,...] : Pseudo ttys (mandatory).\n"
+        "  -p --ptty [num[:policy]@]tty[*weight][,...]\n"
+        "                            : Pseudo ttys (mandatory).\n"
         "                              Can be used multiple times.\n"
         "                              If tty prefixed by num@ then tty will\n"
         "                              accept incoming calls only\n"
         "                              for numbers with prefix num.\n"
         "                              Use none@tty to disable incoming calls.\n"
+        "                              The policy selects a ready tty for incoming\n"
+        "                              calls with prefix num:\n"
+        "                                fifo   - first enqueued (default),\n"
+        "                                rr     - round-robin,\n"
+        "                                lru    - least recently called,\n"
+        "                                weight - weighted round-robin by weight\n"
+        "                                         of tty (default is 1),\n"
+        "                                load   - least count of recent calls.\n"
         "                              See Drivers section for supported tty's formats.\n"
         "  --route prefix@host[,...] : Route numbers with prefix num to host.\n"
         "                              Can be used multiple times.\n"
@@ -272,8 +285,19 @@ PStringArray MyH323EndPoint::Descriptions()
         "  --redundancy I[L[H]]      : Set redundancy for error recovery for\n"
         "                              (I)ndication, (L)ow speed and (H)igh\n"
         "                              speed IFP packets. I, L and H are digits.\n"
+        "  --max-redundancy I[L[H]]  : Adapt redundancy to the loss rate of the\n"
+        "                              received packets up to I, L and H. The values\n"
+        "                              of --redundancy are used as the minimums.\n"
         "  --repeat ms               : Continuously resend last UDPTL packet each ms\n"
         "                              milliseconds.\n"
+        "  --fec S[:E]               : Use FEC error recovery instead of redundancy.\n"
+        "                              Each UDPTL packet carries E (default 1) parity\n"
+        "                              entries over S previous IFP packets.\n"
+        "  --aggregate size          : Send the last data of HDLC frame, FCS and\n"
+        "                              sig-end in one IFP packet up to size bytes.\n"
+        "  --packet-interval {ms|auto}\n"
+        "                            : Send T.38 data each ms milliseconds (default 30)\n"
+        "                              or select the interval by bitrate (auto).\n"
         "  --old-asn                 : Use original ASN.1 sequence in T.38 (06/98)\n"
         "                              Annex A (w/o CORRIGENDUM No. 1 fix).\n"
         "  -i --interface ip         : Bind to a specific interface.\n"
@@ -393,7 +417,14 @@ MyH323EndPoint::MyH323EndPoint()
   in_redundancy = -1;
   ls_redundancy = -1;
   hs_redundancy = -1;
+  in_max_redundancy = -1;
+  ls_max_redundancy = -1;
+  hs_max_redundancy = -1;
   re_interval = -1;
+  fec_span = -1;
+  fec_entries = -1;
+  max_datagram = -1;
+  ms_per_out = -1;
   old_asn = FALSE;
 }
 
@@ -545,6 +576,18 @@ void MyH323EndPoint::SetOptions(MyH323Connection &/*conn*/, OpalT38Protocol *t38
         hs_redundancy,
         re_interval);
 
+    ((T38Protocol *)t38handler)->SetMaxRedundancy(
+        in_max_redundancy,
+        ls_max_redundancy,
+        hs_max_redundancy);
+
+    ((T38Protocol *)t38handler)->SetFec(
+        fec_span,
+        fec_entries);
+
+    ((T38Protocol *)t38handler)->SetMaxDatagram(max_datagram);
+    ((T38Protocol *)t38handler)->SetMsPerOut(ms_per_out);
+
     if (old_asn)
       ((T38Protocol *)t38handler)->SetOldASN();
   }
@@ -664,9 +707,40 @@ PBoolean MyH323EndPoint::Initialise(const PConfigArgs &args)
     }
   }
 
+  if (args.HasOption("max-redundancy")) {
+    const char *r = args.GetOptionString("max-redundancy");
+    if (isdigit(r[0])) {
+      in_max_redundancy = r[0] - '0';
+      if (isdigit(r[1])) {
+        ls_max_redundancy = r[1] - '0';
+        if (isdigit(r[2])) {
+          hs_max_redundancy = r[2] - '0';
+        }
+      }
+    }
+  }
+
   if (args.HasOption("repeat"))
     re_interval = (int)args.GetOptionString("repeat").AsInteger();
 
+  if (args.HasOption("aggregate"))
+    max_datagram = (int)args.GetOptionString("aggregate").AsInteger();
+
+  if (args.HasOption("packet-interval")) {
+    PString interval = args.GetOptionString("packet-interval");
+
+    ms_per_out = (interval *= "auto") ? 0 : (int)interval.AsInteger();
+  }
+
+  if (args.HasOption("fec")) {
+    PStringArray fec = args.GetOptionString("fec").Tokenise(":", FALSE);
+
+    if (fec.GetSize() > 0) {
+      fec_span = (int)fec[0].AsInteger();
+      fec_entries = fec.GetSize() > 1 ? (int)fec[1].AsInteger() : 1;
+    }
+  }
+
   if (args.HasOption("old-asn"))
     old_asn = TRUE;
 
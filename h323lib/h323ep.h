@@ -140,7 +140,14 @@ class MyH323EndPoint : public H323EndPoint
     int in_redundancy;
     int ls_redundancy;
     int hs_redundancy;
+    int in_max_redundancy;
+    int ls_max_redundancy;
+    int hs_max_redundancy;
     int re_interval;
+    int fec_span;
+    int fec_entries;
+    int max_datagram;
+    int ms_per_out;
     PBoolean old_asn;
 
     PDECLARE_NOTIFIER(PObject, MyH323EndPoint, OnMyCallback);
@@ -44,6 +44,7 @@
 
 #include "t38protocol.h"
 #include "../t38engine.h"
+#include "../t38per.h"
 #include "../pmodem.h"
 
 #define new PNEW
@@ -55,7 +56,14 @@ T38Protocol::T38Protocol(PseudoModem * pmodem)
   , ls_redundancy(0)
   , hs_redundancy(0)
   , re_interval(-1)
+  , fec_span(0)
+  , fec_entries(0)
+  , max_datagram(0)
+  , ms_per_out(-1)
+  , lossRate(0)
 {
+  for (PINDEX i = 0 ; i < numClasses ; i++)
+    max_redundancy[i] = -1;
 }
 
 T38Protocol::~T38Protocol()
@@ -82,6 +90,96 @@ void T38Protocol::SetRedundancy(int indication, int low_speed, int high_speed, i
   );
 }
 
+void T38Protocol::SetMaxRedundancy(int indication, int low_speed, int high_speed)
+{
+  max_redundancy[classIndication] = indication;
+  max_redundancy[classLowSpeed] = low_speed;
+  max_redundancy[classHighSpeed] = high_speed;
+
+  myPTRACE(3, t38engine->Name() << " T38Protocol::SetMaxRedundancy indication=" << indication
+                                            << " low_speed=" << low_speed
+                                            << " high_speed=" << high_speed
+  );
+}
+
+void T38Protocol::OnReceived(long lost)
+{
+  // exponentially weighted moving average of the loss rate (1/64 per packet)
+
+  PWaitAndSignal mutexWait(lossMutex);
+
+  for (long i = 0 ; i < lost && i < 64 ; i++)
+    lossRate += (1 - lossRate)/64;
+
+  lossRate -= lossRate/64;
+}
+
+int T38Protocol::GetRedundancy(int packetClass, int redundancy)
+{
+  /*
+   * The target rate of loss of all copies of the packet
+   * (the indication and low speed packets can't be recovered
+   * by ECM retransmission)
+   */
+  static const double targetLoss[numClasses] = { 1e-4, 1e-4, 1e-3 };
+
+  int maxRedundancy = max_redundancy[packetClass];
+
+  if (maxRedundancy <= redundancy)
+    return redundancy;
+
+  double loss;
+
+  {
+    PWaitAndSignal mutexWait(lossMutex);
+    loss = lossRate;
+  }
+
+  // assuming independent losses, all copies are lost with rate loss^(redundancy + 1)
+
+  double allLost = loss;
+
+  for (PINDEX i = 0 ; i < redundancy ; i++)
+    allLost *= loss;
+
+  while (redundancy < maxRedundancy && allLost > targetLoss[packetClass]) {
+    allLost *= loss;
+    redundancy++;
+  }
+
+  return redundancy;
+}
+
+void T38Protocol::SetMaxDatagram(int size)
+{
+  if (size >= 0)
+    max_datagram = size;
+
+  myPTRACE(3, t38engine->Name() << " T38Protocol::SetMaxDatagram size=" << max_datagram);
+}
+
+void T38Protocol::SetMsPerOut(int ms)
+{
+  ms_per_out = ms;
+
+  myPTRACE(3, t38engine->Name() << " T38Protocol::SetMsPerOut ms=" << ms_per_out);
+}
+
+void T38Protocol::SetFec(int span, int entries)
+{
+  if (span >= 0)
+    fec_span = span;
+  if (entries >= 0)
+    fec_entries = entries;
+
+  if (fec_entries > T38PerUDPTL::maxEntries)
+    fec_entries = T38PerUDPTL::maxEntries;
+
+  myPTRACE(3, t38engine->Name() << " T38Protocol::SetFec span=" << fec_span
+                                            << " entries=" << fec_entries
+  );
+}
+
 #ifdef OPTIMIZE_CORRIGENDUM_IFP
   #define T38_IFP_NOT_NATIVE       T38_PreCorrigendum_IFPPacket
   #define T38_IFP_NOT_NATIVE_NAME  "Pre-corrigendum IFP"
@@ -94,8 +192,19 @@ void T38Protocol::SetRedundancy(int indication, int low_speed, int high_speed, i
   #define IS_EXTENDABLE            TRUE
 #endif
 
+#define maxRawSize 2048
+
 static void EncodeIFPPacket(PASN_OctetString &ifp_packet, const T38_IFP &T38_ifp, PBoolean nativeASN)
 {
+  BYTE buf[maxRawSize];
+  PINDEX size = T38Per::EncodeIFP(T38_ifp, buf, sizeof(buf),
+                                  nativeASN ? T38_FIELD_TYPE_EXTENDABLE : !T38_FIELD_TYPE_EXTENDABLE);
+
+  if (size > 0) {
+    ifp_packet.SetValue(buf, size);
+    return;
+  }
+
   if (!nativeASN && T38_ifp.HasOptionalField(T38_IFPPacket::e_data_field)) {
     T38_IFP ifp = T38_ifp;
     PINDEX count = ifp.m_data_field.GetSize();
@@ -109,6 +218,109 @@ static void EncodeIFPPacket(PASN_OctetString &ifp_packet, const T38_IFP &T38_ifp
   }
 }
 
+static PBoolean EncodeUDPTLPacket(PBYTEArray &rawData, const T38_UDPTLPacket &udptl)
+{
+  T38PerUDPTL per;
+
+  per.seq = udptl.m_seq_number;
+  per.primary = udptl.m_primary_ifp_packet;
+  per.primarySize = udptl.m_primary_ifp_packet.GetSize();
+
+  const T38_UDPTLPacket_error_recovery &recovery = udptl.m_error_recovery;
+
+  if (recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
+    const T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = recovery;
+
+    per.recovery = T38PerUDPTL::e_secondary_ifp_packets;
+    per.count = secondary.GetSize();
+
+    if (per.count > T38PerUDPTL::maxEntries)
+      return FALSE;
+
+    for (PINDEX i = 0 ; i < per.count ; i++) {
+      per.entry[i] = secondary[i];
+      per.entrySize[i] = secondary[i].GetSize();
+    }
+  } else {
+    const T38_UDPTLPacket_error_recovery_fec_info &fec = recovery;
+
+    per.recovery = T38PerUDPTL::e_fec_info;
+    per.fecNPackets = fec.m_fec_npackets;
+    per.count = fec.m_fec_data.GetSize();
+
+    if (per.count > T38PerUDPTL::maxEntries)
+      return FALSE;
+
+    for (PINDEX i = 0 ; i < per.count ; i++) {
+      per.entry[i] = fec.m_fec_data[i];
+      per.entrySize[i] = fec.m_fec_data[i].GetSize();
+    }
+  }
+
+  PINDEX size = T38Per::EncodeUDPTL(per, rawData.GetPointer(maxRawSize), maxRawSize);
+
+  rawData.SetSize(size);
+
+  return size > 0;
+}
+
+static PBoolean DecodeUDPTLPacket(const PBYTEArray &rawData, T38_UDPTLPacket &udptl, T38PerUDPTL &per)
+{
+  if (T38Per::DecodeUDPTL(rawData, rawData.GetSize(), per))
+    return TRUE;
+
+  PPER_Stream strm(rawData);
+
+  if (!udptl.Decode(strm))
+    return FALSE;
+
+  per.seq = udptl.m_seq_number;
+  per.primary = udptl.m_primary_ifp_packet;
+  per.primarySize = udptl.m_primary_ifp_packet.GetSize();
+  per.fecNPackets = 0;
+  per.count = 0;
+
+  const T38_UDPTLPacket_error_recovery &recovery = udptl.m_error_recovery;
+
+  if (recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
+    const T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = recovery;
+
+    per.recovery = T38PerUDPTL::e_secondary_ifp_packets;
+
+    for (PINDEX i = 0 ; i < secondary.GetSize() && per.count < T38PerUDPTL::maxEntries ; i++) {
+      per.entry[per.count] = secondary[i];
+      per.entrySize[per.count] = secondary[i].GetSize();
+      per.count++;
+    }
+  } else {
+    const T38_UDPTLPacket_error_recovery_fec_info &fec = recovery;
+
+    per.recovery = T38PerUDPTL::e_fec_info;
+    per.fecNPackets = fec.m_fec_npackets;
+
+    // the truncated FEC data can't be used
+    if (fec.m_fec_data.GetSize() <= T38PerUDPTL::maxEntries) {
+      for (PINDEX i = 0 ; i < fec.m_fec_data.GetSize() ; i++) {
+        per.entry[per.count] = fec.m_fec_data[i];
+        per.entrySize[per.count] = fec.m_fec_data[i].GetSize();
+        per.count++;
+      }
+    }
+  }
+
+  return TRUE;
+}
+
+PBoolean T38Protocol::HandleRawIFP(const BYTE *buf, PINDEX size)
+{
+  T38_IFP ifp;
+
+  if (T38Per::DecodeIFP(buf, size, ifp, corrigendumASN))
+    return t38engine->HandlePacket(EngineBase::HOWNERIN(this), ifp);
+
+  return HandleRawIFP(PASN_OctetString((const char *)buf, size));
+}
+
 PBoolean T38Protocol::HandleRawIFP(const PASN_OctetString & pdu)
 {
   T38_IFP ifp;
@@ -154,16 +366,26 @@ PBoolean T38Protocol::Originate()
   int maxRedundancy = 0;
 #if PTRACING
   int repeated = 0;
+  long countClass[numClasses] = { 0, 0, 0 };
+  long sumRedundancy[numClasses] = { 0, 0, 0 };
+  int maxUsedRedundancy[numClasses] = { 0, 0, 0 };
 #endif
 
   T38_UDPTLPacket udptl;
-  udptl.m_error_recovery.SetTag(T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
+  T38PerFec fec;
+  PBoolean useFec = (fec_span > 0 && fec_entries > 0);
+
+  udptl.m_error_recovery.SetTag(useFec
+      ? T38_UDPTLPacket_error_recovery::e_fec_info
+      : T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets);
 
 #if REPEAT_INDICATOR_SENDING
   T38_IFP lastifp;
 #endif
 
   t38engine->OpenOut(EngineBase::HOWNEROUT(this));
+  t38engine->SetMaxDatagram(EngineBase::HOWNEROUT(this), max_datagram);
+  t38engine->SetMsPerOut(EngineBase::HOWNEROUT(this), ms_per_out);
 
   for (;;) {
     T38_IFP ifp;
@@ -176,7 +398,7 @@ PBoolean T38Protocol::Originate()
 #ifdef REPEAT_INDICATOR_SENDING
         lastifp.m_type_of_msg.GetTag() == T38_Type_of_msg::e_t30_indicator ||
 #endif
-        maxRedundancy > 0) ? t38engine->msPerOut * 3 : -1;
+        maxRedundancy > 0) ? t38engine->GetMsPerOut() * 3 : -1;
 
       if (re_interval > 0 && (timeout <= 0 || timeout > re_interval))
         timeout = re_interval;
@@ -214,32 +436,59 @@ PBoolean T38Protocol::Originate()
           }
           secondary[0].SetValue(udptl.m_primary_ifp_packet.GetValue());
         }
-      } else {
-        PTRACE_IF(3, maxRedundancy > 0, "T38\tNot implemented yet " << recovery.GetTagName());
       }
 
       udptl.m_seq_number = ++seq & 0xFFFF;
 
       EncodeIFPPacket(udptl.m_primary_ifp_packet, ifp, IS_NATIVE_ASN);
 
+      if (useFec) {
+        T38_UDPTLPacket_error_recovery_fec_info &fecInfo = recovery;
+        T38PerUDPTL per;
+
+        fec.Encode(seq, fec_span, fec_entries, per);
+
+        fecInfo.m_fec_npackets = per.fecNPackets;
+        fecInfo.m_fec_data.SetSize(per.count);
+
+        for (PINDEX i = 0 ; i < per.count ; i++)
+          fecInfo.m_fec_data[i].SetValue(per.entry[i], per.entrySize[i]);
+
+        fec.Put(seq, udptl.m_primary_ifp_packet, udptl.m_primary_ifp_packet.GetSize());
+      }
+
       /*
        * Calculate maxRedundancy for current ifp packet
        */
+      int packetClass = classHighSpeed;
+
       maxRedundancy = hs_redundancy;
 
       switch( ifp.m_type_of_msg.GetTag() ) {
         case T38_Type_of_msg::e_t30_indicator:
+          packetClass = classIndication;
           maxRedundancy = in_redundancy;
           break;
         case T38_Type_of_msg::e_data:
           switch( (T38_Type_of_msg_data)ifp.m_type_of_msg ) {
             case T38_Type_of_msg_data::e_v21:
+              packetClass = classLowSpeed;
               maxRedundancy = ls_redundancy;
               break;
           }
           break;
       }
 
+      maxRedundancy = GetRedundancy(packetClass, maxRedundancy);
+
+#if PTRACING
+      countClass[packetClass]++;
+      sumRedundancy[packetClass] += maxRedundancy;
+
+      if (maxUsedRedundancy[packetClass] < maxRedundancy)
+        maxUsedRedundancy[packetClass] = maxRedundancy;
+#endif
+
 #if 0
       // recovery test
       if (seq % 2)
@@ -263,9 +512,6 @@ PBoolean T38Protocol::Originate()
           nRedundancy = 0;
         secondary.SetSize(nRedundancy);
       }
-      else {
-        PTRACE(3, "T38\tNot implemented yet " << recovery.GetTagName());
-      }
 #endif
 #if PTRACING
       repeated++;
@@ -275,8 +521,11 @@ PBoolean T38Protocol::Originate()
       break;
 
     PPER_Stream rawData;
-    udptl.Encode(rawData);
-    rawData.CompleteEncoding();
+
+    if (!EncodeUDPTLPacket(rawData, udptl)) {
+      udptl.Encode(rawData);
+      rawData.CompleteEncoding();
+    }
 
 #if PTRACING
     if (res > 0) {
@@ -310,8 +559,21 @@ PBoolean T38Protocol::Originate()
     }
   }
 
+#if PTRACING
+  static const char *classNames[numClasses] = { "indication", "low_speed", "high_speed" };
+  PStringStream redundancyStat;
+
+  for (PINDEX i = 0 ; i < numClasses ; i++) {
+    redundancyStat << " " << classNames[i] << "="
+                   << (countClass[i] ? double(sumRedundancy[i])/countClass[i] : 0.0)
+                   << "/" << maxUsedRedundancy[i];
+  }
+#endif
+
   myPTRACE(2, "T38\tSend statistics: sequence=" << seq
       << " repeated=" << repeated
+      << " redundancy(avg/max):" << redundancyStat
+      << " loss(rx)=" << lossRate*100 << "%"
       << GetThreadTimes(", CPU usage: "));
 
   return FALSE;
@@ -328,6 +590,7 @@ PBoolean T38Protocol::Answer()
 
   int consecutiveBadPackets = 0;
   long expectedSequenceNumber = 0;
+  T38PerFec fec;
 #if PTRACING
   int totalrecovered = 0;
   int totallost = 0;
@@ -344,8 +607,9 @@ PBoolean T38Protocol::Answer()
     }
 
     T38_UDPTLPacket udptl;
+    T38PerUDPTL per;
 
-    if (udptl.Decode(rawData)) {
+    if (DecodeUDPTLPacket(rawData, udptl, per)) {
       consecutiveBadPackets = 0;
 
       // When we get the first packet, we know sender's address and port,
@@ -357,8 +621,7 @@ PBoolean T38Protocol::Answer()
     } else {
       consecutiveBadPackets++;
       PTRACE(2, "T38\tRaw data decode failure:\n  "
-             << setprecision(2) << rawData << "\n  UDPTL = "
-             << setprecision(2) << udptl);
+             << setprecision(2) << rawData);
       if (consecutiveBadPackets > 3) {
         PTRACE(1, "T38\tRaw data decode failed multiple times, aborting!");
         break;
@@ -366,7 +629,7 @@ PBoolean T38Protocol::Answer()
       continue;
     }
 
-    long receivedSequenceNumber = (udptl.m_seq_number & 0xFFFF) + (expectedSequenceNumber & ~0xFFFFL);
+    long receivedSequenceNumber = (per.seq & 0xFFFF) + (expectedSequenceNumber & ~0xFFFFL);
     long lost = receivedSequenceNumber - expectedSequenceNumber;
 
     if (lost < -0x10000L/2) {
@@ -378,9 +641,10 @@ PBoolean T38Protocol::Answer()
       receivedSequenceNumber -= 0x10000L;
     }
 
-    PTRACE(4, "T38\tReceived PDU:\n  "
-           << setprecision(2) << rawData << "\n  UDPTL = "
-           << setprecision(2) << udptl);
+    PTRACE(4, "T38\tReceived PDU: seq=" << per.seq << "\n  "
+           << setprecision(2) << rawData);
+
+    OnReceived(lost > 0 ? lost : 0);
 
     if (lost < 0) {
       PTRACE(4, "T38\tRepeated packet " << receivedSequenceNumber);
@@ -390,10 +654,8 @@ PBoolean T38Protocol::Answer()
       continue;
     }
     else if(lost > 0) {
-      const T38_UDPTLPacket_error_recovery &recovery = udptl.m_error_recovery;
-      if (recovery.GetTag() == T38_UDPTLPacket_error_recovery::e_secondary_ifp_packets) {
-        const T38_UDPTLPacket_error_recovery_secondary_ifp_packets &secondary = recovery;
-        int nRedundancy = secondary.GetSize();
+      if (per.recovery == T38PerUDPTL::e_secondary_ifp_packets) {
+        int nRedundancy = per.count;
         if (lost > nRedundancy) {
           if (!t38engine->HandlePacketLost(EngineBase::HOWNERIN(this), lost - nRedundancy))
             break;
@@ -410,7 +672,7 @@ PBoolean T38Protocol::Answer()
         for (int i = nRedundancy - 1 ; i >= 0 ; i--) {
           PTRACE(3, "T38\tReceived ifp seq=" << receivedSequenceNumber << " (secondary)");
 
-          if (!HandleRawIFP(secondary[i]))
+          if (!HandleRawIFP(per.entry[i], per.entrySize[i]))
             goto done;
 
 #if PTRACING
@@ -422,7 +684,39 @@ PBoolean T38Protocol::Answer()
         receivedSequenceNumber += lost;
       }
       else {
-        PTRACE(3, "T38\tNot implemented yet " << recovery.GetTagName());
+        long lostNotRecovered = 0;
+
+        receivedSequenceNumber -= lost;
+
+        for (; lost > 0 ; lost--, receivedSequenceNumber++) {
+          PBYTEArray recovered;
+
+          if (!fec.Recover(receivedSequenceNumber, receivedSequenceNumber + lost, per, recovered)) {
+            lostNotRecovered++;
+            continue;
+          }
+
+          if (lostNotRecovered) {
+            if (!t38engine->HandlePacketLost(EngineBase::HOWNERIN(this), lostNotRecovered))
+              goto done;
+#if PTRACING
+            totallost += lostNotRecovered;
+#endif
+            lostNotRecovered = 0;
+          }
+
+          PTRACE(3, "T38\tReceived ifp seq=" << receivedSequenceNumber << " (fec)");
+
+          if (!HandleRawIFP(recovered, recovered.GetSize()))
+            goto done;
+
+          fec.Put(receivedSequenceNumber, recovered, recovered.GetSize());
+#if PTRACING
+          totalrecovered++;
+#endif
+        }
+
+        lost = lostNotRecovered;
       }
 
       if (lost) {
@@ -442,7 +736,10 @@ PBoolean T38Protocol::Answer()
 
     PTRACE(3, "T38\tReceived ifp seq=" << receivedSequenceNumber);
 
-    if (!HandleRawIFP(udptl.m_primary_ifp_packet))
+    if (per.recovery == T38PerUDPTL::e_fec_info)
+      fec.Put(receivedSequenceNumber, per.primary, per.primarySize);
+
+    if (!HandleRawIFP(per.primary, per.primarySize))
       break;
 
     expectedSequenceNumber = receivedSequenceNumber + 1;
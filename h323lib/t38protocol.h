@@ -68,6 +68,39 @@ class T38Protocol : public OpalT38Protocol
       int repeat_interval
     );
 
+    /**Adapt the redundancy for each class of IFP packets to the loss
+       rate of the received packets up to the given maximums (the
+       values set by SetRedundancy() are the minimums).
+      */
+    void SetMaxRedundancy(
+      int indication,
+      int low_speed,
+      int high_speed
+    );
+
+    /**Aggregate the last data field of a frame with the FCS and
+       sig-end fields in one IFP packet up to size bytes
+       (0 - do not aggregate).
+      */
+    void SetMaxDatagram(
+      int size
+    );
+
+    /**Set the packetization interval of T.38 data
+       (>0 - ms, 0 - selected by bitrate, <0 - default).
+      */
+    void SetMsPerOut(
+      int ms
+    );
+
+    /**Use FEC error recovery with the parity entries over
+       span IFP packets instead of redundancy.
+      */
+    void SetFec(
+      int span,
+      int entries
+    );
+
     /**The calling SetOldASN() is aquivalent to the following change of the t38.asn:
 
            -  t4-non-ecm-sig-end,
@@ -78,18 +111,37 @@ class T38Protocol : public OpalT38Protocol
   //@}
 
     PBoolean HandleRawIFP(const PASN_OctetString & pdu);
+    PBoolean HandleRawIFP(const BYTE *buf, PINDEX size);
     PBoolean Originate();
     PBoolean Answer();
 
     void CleanUpOnTermination();
 
   private:
+    enum {
+      classIndication,
+      classLowSpeed,
+      classHighSpeed,
+      numClasses
+    };
+
+    void OnReceived(long lost);
+    int GetRedundancy(int packetClass, int redundancy);
+
     T38Engine *t38engine;
 
     int in_redundancy;
     int ls_redundancy;
     int hs_redundancy;
     int re_interval;
+    int fec_span;
+    int fec_entries;
+    int max_datagram;
+    int ms_per_out;
+
+    int max_redundancy[numClasses];
+    double lossRate;            // estimation of the loss rate of the received packets
+    PMutex lossMutex;
 };
 ///////////////////////////////////////////////////////////////
 
@@ -62,116 +62,276 @@
 #define new PNEW
 
 ///////////////////////////////////////////////////////////////
-void HDLC::pack(const void *_pBuf, PINDEX count, PBoolean flag)
-{
-  WORD w = WORD((WORD)rawByte << 8);
-  const BYTE *pBuf = (const BYTE *)_pBuf;
+/*
+ * Bit stuffing table.
+ *
+ * For every count of preceding ones (0..4) and every input byte it
+ * contains the stuffed bits (MSB first), the number of the stuffed
+ * bits (8..10) and the count of trailing ones.
+ */
+struct StuffEntry {
+  WORD bits;
+  BYTE len;
+  BYTE ones;
+};
 
-  for (PINDEX i = 0 ; i < count ; i++) {
-    w |= *(pBuf++) & 0xFF;
-    for (PINDEX j = 0 ; j < 8 ; j++) {
-      w <<= 1;
-
-      if (++rawByteLen == 8) {
-        rawByte = BYTE(w >> 8);
-        outData.PutData(&rawByte, 1);
-        rawByteLen = 0;
+static StuffEntry StuffTable[5][256];
+
+static PBoolean initStuffTable()
+{
+  for (int ones0 = 0 ; ones0 < 5 ; ones0++) {
+    for (int b = 0 ; b < 256 ; b++) {
+      WORD bits = 0;
+      BYTE len = 0;
+      int ones = ones0;
+
+      for (int m = 0x80 ; m ; m >>= 1) {
+        bits <<= 1;
+        len++;
+
+        if (b & m) {
+          bits |= 1;
+
+          if (++ones == 5) {
+            bits <<= 1;
+            len++;
+            ones = 0;
+          }
+        } else {
+          ones = 0;
+        }
       }
 
-      if (!flag) {
-        if (w & 0x100) {
-          if (++rawOnes == 5) {
-            w = WORD((w & 0xFF00) << 1 | (w & 0xFF));
-
-            if (++rawByteLen == 8) {
-              rawByte = BYTE(w >> 8);
-              outData.PutData(&rawByte, 1);
-              rawByteLen = 0;
-            }
-            rawOnes = 0;
+      StuffEntry &entry = StuffTable[ones0][b];
+
+      entry.bits = bits;
+      entry.len = len;
+      entry.ones = BYTE(ones);
+    }
+  }
+  return TRUE;
+}
+
+static const PBoolean ___InitStuffTable = initStuffTable();
+///////////////////////////////////////////////////////////////
+/*
+ * Flag detection table.
+ *
+ * The index is 7 not examined bits followed by 8 new bits (MSB first).
+ * It gives the position (0..7) of the first 8-bit window that matches
+ * the flag sequence or 8 if there is no one.
+ */
+static BYTE FlagTable[1 << 15];
+
+static PBoolean initFlagTable()
+{
+  for (unsigned v = 0 ; v < sizeof(FlagTable) ; v++) {
+    BYTE pos;
+
+    for (pos = 0 ; pos < 8 ; pos++) {
+      if (((v >> (7 - pos)) & 0xFF) == 0x7E)
+        break;
+    }
+
+    FlagTable[v] = pos;
+  }
+  return TRUE;
+}
+
+static const PBoolean ___InitFlagTable = initFlagTable();
+///////////////////////////////////////////////////////////////
+/*
+ * Zero-bit removal table.
+ *
+ * For every count of preceding ones (0..6) and every 8 bits (MSB first)
+ * it contains the data bits, the number of the data bits (7..8), the
+ * count of trailing ones and the abort sign (7 ones in a row).
+ */
+struct DestuffEntry {
+  BYTE bits;
+  BYTE len;
+  BYTE ones;
+  BYTE abort;
+};
+
+static DestuffEntry DestuffTable[7][256];
+
+static PBoolean initDestuffTable()
+{
+  for (int ones0 = 0 ; ones0 < 7 ; ones0++) {
+    for (int b = 0 ; b < 256 ; b++) {
+      DestuffEntry &entry = DestuffTable[ones0][b];
+      int ones = ones0;
+
+      entry.bits = 0;
+      entry.len = 0;
+      entry.abort = FALSE;
+
+      for (int m = 0x80 ; m ; m >>= 1) {
+        if (b & m) {
+          entry.bits = BYTE((entry.bits << 1) | 1);
+          entry.len++;
+
+          if (++ones == 7)
+            entry.abort = TRUE;
+        } else {
+          if (ones != 5) {
+            entry.bits <<= 1;
+            entry.len++;
           }
+          ones = 0;
         }
-        else
-          rawOnes = 0;
       }
+
+      entry.ones = BYTE(ones < 6 ? ones : 6);
     }
   }
-  rawByte = BYTE(w >> 8);
+  return TRUE;
+}
+
+static const PBoolean ___InitDestuffTable = initDestuffTable();
+///////////////////////////////////////////////////////////////
+void HDLC::pack(const void *_pBuf, PINDEX count, PBoolean flag)
+{
+  const BYTE *pBuf = (const BYTE *)_pBuf;
+  DWORD bits = rawByte;
+  BYTE out[512];
+  PINDEX outLen = 0;
+
+  for (PINDEX i = 0 ; i < count ; i++) {
+    BYTE b = *(pBuf++);
+
+    if (flag) {
+      bits = (bits << 8) | b;
+      rawByteLen += 8;
+    } else {
+      const StuffEntry &entry = StuffTable[rawOnes][b];
+
+      bits = (bits << entry.len) | entry.bits;
+      rawByteLen += entry.len;
+      rawOnes = entry.ones;
+    }
+
+    while (rawByteLen >= 8) {
+      rawByteLen -= 8;
+      out[outLen++] = BYTE(bits >> rawByteLen);
+    }
+
+    if (outLen > PINDEX(sizeof(out)) - 2) {
+      outData.PutData(out, outLen);
+      outLen = 0;
+    }
+  }
+
+  if (outLen)
+    outData.PutData(out, outLen);
+
+  rawByte = BYTE(bits);
   if (flag)
     rawOnes = 0;
 }
 
+WORD HDLC::rawBits(BYTE b) const
+{
+  /*
+   * Pad not examined bits by ones to be sure that the windows
+   * starting before them will never match the flag sequence.
+   */
+  return WORD((((0x7F << rawByteLen) | (rawByte & ((1 << rawByteLen) - 1))) & 0x7F) << 8 | b);
+}
+
 PBoolean HDLC::sync(BYTE b)
 {
-  WORD w = WORD(((WORD)rawByte << 8) | (b & 0xFF));
-  PINDEX j = 8 - rawByteLen;
+  BYTE pos = FlagTable[rawBits(b)];
 
-  w <<= j;
+  rawByte = b;
 
-  for ( ; j <= 8 ; j++, w <<= 1) {
-    if ((w >> 8) == 0x7E) {
-      rawByte = BYTE(w >> j);
-      rawByteLen = 8 - j;
-      return TRUE;
-    }
+  if (pos < 8) {
+    rawByteLen = 7 - pos;
+    return TRUE;
   }
-  rawByte = BYTE(w >> j);
+
   rawByteLen = 7;
   return FALSE;
 }
 
 PBoolean HDLC::skipFlag(BYTE b)
 {
-  WORD w = WORD(((WORD)rawByte << 8) | (b & 0xFF));
-  PINDEX j = 8 - rawByteLen;
+  WORD v = rawBits(b);
 
-  w <<= j;
-  if ((w >> 8) == 0x7E) {
-    rawByte = BYTE(w >> j);
+  if (((v >> rawByteLen) & 0xFF) == 0x7E) {
+    rawByte = b;
     return TRUE;
   }
 
   return FALSE;
 }
 
-PBoolean HDLC::unpack(BYTE b)
+void HDLC::putHdlcBits(DWORD bits, int len, BYTE *&pOut)
 {
-  //myPTRACE(1, "unpack det " << hex << (WORD)b);
-  WORD w = WORD(((WORD)rawByte << 8) | (b & 0xFF));
-  PINDEX j = 8 - rawByteLen;
+  hdlcChunk = (hdlcChunk << len) | bits;
+  hdlcChunkLen += len;
 
-  w <<= j;
+  if (hdlcChunkLen >= 24) {
+    hdlcChunkLen -= 8;
+    *pOut++ = BYTE(hdlcChunk >> hdlcChunkLen);
+  }
+}
+
+int HDLC::unpack(BYTE b, BYTE *&pOut)
+{
+  WORD v = rawBits(b);
+  BYTE pos = FlagTable[v];
+
+  if (pos == 8 && rawByteLen == 7) {
+    const DestuffEntry &entry = DestuffTable[rawOnes][BYTE(v >> 7)];
 
-  for ( ; j <= 8 ; j++, w <<= 1) {
-    if ((w >> 8) == 0x7E) {
-      rawByte = BYTE(w >> j);
-      rawByteLen = 8 - j;
-      return FALSE;
+    if (!entry.abort) {
+      putHdlcBits(entry.bits, entry.len, pOut);
+      rawOnes = entry.ones;
+      rawByte = b;
+      return unpackData;
     }
+  }
 
-    if (w & 0x8000) {
-      hdlcChunk <<= 1;
-      hdlcChunk |= 1;
-      hdlcChunkLen++;
-      rawOnes++;
-    } else {
-      if (rawOnes != 5) {
-        hdlcChunk <<= 1;
-        hdlcChunkLen++;
-      }
-      rawOnes = 0;
+  for (int j = 7 - rawByteLen ; j < 8 ; j++) {
+    if (j == pos) {
+      rawByte = b;
+      rawByteLen = 7 - pos;
+      return unpackFlag;
     }
 
-    if (hdlcChunkLen == 24) {
-      BYTE b = BYTE(hdlcChunk >> 16);
-      outData.PutData(&b, 1);
-      //myPTRACE(1, "unpack put " << hex << (WORD)hdlcChunk);
-      hdlcChunkLen = 16;
+    if (v & (0x4000 >> j)) {
+      putHdlcBits(1, 1, pOut);
+
+      if (++rawOnes == 7) {
+        myPTRACE(2, "HDLC::unpack(): abort sequence detected");
+
+        /*
+         * Drop the frame bits (the FCS will be bad) and
+         * continue from the next flag
+         */
+        hdlcChunkLen = 0;
+        rawByte = b;
+
+        if (pos < 8) {
+          rawByteLen = 7 - pos;
+        } else {
+          rawByteLen = 7;
+          hdlcAbort = TRUE;
+        }
+        return unpackAbort;
+      }
+    } else {
+      if (rawOnes != 5)
+        putHdlcBits(0, 1, pOut);
+      rawOnes = 0;
     }
   }
-  rawByte = BYTE(w >> j);
+
+  rawByte = b;
   rawByteLen = 7;
-  return TRUE;
+  return unpackData;
 }
 ///////////////////////////////////////////////////////////////
 int HDLC::GetInData(void *pBuf, PINDEX count)
@@ -285,79 +445,105 @@ int HDLC::GetHdlcData(void *_pBuf, PINDEX count)
     len = outData.GetData(pBuf, count);
     if (len > 0)
       fcs.build(pBuf, len);
+    return len;
   }
-  else
+
   if (!count && hdlcState == stData) {
-    if (outData.GetData(NULL, 0) < 0 || inData->GetData(NULL, 0) < 0)
+    if (outData.GetData(NULL, 0) < 0 || (rawBufPos == rawBufLen && inData->GetData(NULL, 0) < 0))
       return -1;
     return 0;
-  } else {
-    BYTE b;
-    int res;
-    len = 0;
+  }
+
+  /*
+   * Every raw byte gives not more than one HDLC byte so the
+   * HDLC bytes are put directly to the caller's buffer
+   */
+  BYTE *pOut = pBuf;
+  BYTE *pEnd = pBuf + count;
+
+  while (hdlcState != stEof && (hdlcState != stData || pOut < pEnd)) {
+    if (rawBufPos == rawBufLen) {
+      int res = inData->GetData(rawBuf, sizeof(rawBuf));
+
+      if (res == 0)
+        break;
 
-    for ( ; (res = inData->GetData(&b, 1)) != 0 ; ) {
       if (res < 0) {
         outData.PutEof();
         inData = NULL;
         hdlcState = stEof;
         //myPTRACE(1, "hdlcState=stEof EOF");
-      }
-      else {
-        lastChar = b;
-        rawCount++;
-        switch (hdlcState) {
-        case stSync:
-          if (sync(b)) {
-            hdlcState = stSkipFlags;
-            //myPTRACE(1, "hdlcState=stSkipFlags " << hex << (int)b);
-          }
-          break;
-        case stSkipFlags:
-          if (skipFlag(b))
-            break;
-          hdlcState = stData;
-          //myPTRACE(1, "hdlcState=stData " << hex << (int)b);
-        case stData:
-          if (!unpack(b)) {
-            outData.PutEof();
-            hdlcState = stEof;
-            //myPTRACE(1, "hdlcState=stEof " << hex << (int)b);
-          }
-          break;
-        default:
-          myPTRACE(1, "HDLC::GetHdlcData(): unexpected hdlcState=" << hdlcState);
-        }
+        break;
       }
 
-      if (hdlcState == stEof || hdlcState == stData) {
-        int outLen = outData.GetData(pBuf, count);
+      rawBufPos = 0;
+      rawBufLen = res;
+    }
 
-        if (outLen < 0) {
-          if (len > 0)
-            break;
-          return -1;
-        }
-        else
-        if (outLen > 0) {
-          fcs.build(pBuf, outLen);
-          pBuf += outLen;
-          count -= outLen;
-          len += outLen;
-        }
-        if (!count || hdlcState == stEof)
+    BYTE b = rawBuf[rawBufPos++];
+
+    lastChar = b;
+    rawCount++;
+
+    switch (hdlcState) {
+    case stSync:
+      if (sync(b)) {
+        hdlcState = stSkipFlags;
+        //myPTRACE(1, "hdlcState=stSkipFlags " << hex << (int)b);
+      }
+      break;
+    case stSkipFlags:
+      if (skipFlag(b))
+        break;
+      hdlcState = stData;
+      //myPTRACE(1, "hdlcState=stData " << hex << (int)b);
+    case stData:
+      switch (unpack(b, pOut)) {
+      case unpackData:
+        break;
+      case unpackAbort:
+        if (hdlcLen == 0 && pOut == pBuf) {
+          /*
+           * Nothing of the frame was returned (idle marks between
+           * frames), so hunt for the next frame instead of ending
+           */
+          rawOnes = 0;
+          hdlcState = hdlcAbort ? stSync : stSkipFlags;
+          hdlcAbort = FALSE;
+          //myPTRACE(1, "hdlcState=" << hdlcState << " ABORT " << hex << (int)b);
           break;
+        }
+        // the aborted frame ends with bad FCS
+      case unpackFlag:
+        outData.PutEof();
+        hdlcState = stEof;
+        //myPTRACE(1, "hdlcState=stEof " << hex << (int)b);
+        break;
       }
+      break;
+    default:
+      myPTRACE(1, "HDLC::GetHdlcData(): unexpected hdlcState=" << hdlcState);
     }
   }
 
+  len = int(pOut - pBuf);
+
+  if (len > 0) {
+    fcs.build(pBuf, len);
+    hdlcLen += len;
+  }
+  else
+  if (hdlcState == stEof)
+    return outData.GetData(pBuf, count);
+
   return len;
 }
 ///////////////////////////////////////////////////////////////
 HDLC::HDLC() :
     inDataType(EngineBase::dtNone), outDataType(EngineBase::dtNone),
     inData(NULL), lastChar(-1), rawCount(0),
-    rawByteLen(0), rawOnes(0), hdlcState(stEof)
+    rawByteLen(0), rawOnes(0), hdlcAbort(FALSE), hdlcLen(0),
+    rawBufPos(0), rawBufLen(0), hdlcState(stEof)
 {
 }
 
@@ -381,6 +567,7 @@ void HDLC::PutRawData(DataStream *_inData)
   inDataType = EngineBase::dtRaw;
   inData = _inData;
   lastChar = -1;
+  rawBufPos = rawBufLen = 0;
 }
 
 void HDLC::PutHdlcData(DataStream *_inData)
@@ -408,8 +595,10 @@ void HDLC::GetHdlcStart(PBoolean sync)
   fcs = FCS();
   if (inDataType == EngineBase::dtRaw) {
     hdlcChunkLen = 0;
+    hdlcLen = 0;
     rawOnes = 0;
-    hdlcState = sync ? stSync : stSkipFlags;
+    hdlcState = (sync || hdlcAbort) ? stSync : stSkipFlags;
+    hdlcAbort = FALSE;
   } else {
     if (!sync)
       rawCount += 4;	// count FCS, flags, zeros
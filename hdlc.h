@@ -57,9 +57,11 @@ class HDLC
 
   private:
     void pack(const void *pBuf, PINDEX count, PBoolean flag = FALSE);
+    WORD rawBits(BYTE b) const;
     PBoolean sync(BYTE b);
     PBoolean skipFlag(BYTE b);
-    PBoolean unpack(BYTE b);
+    void putHdlcBits(DWORD bits, int len, BYTE *&pOut);
+    int unpack(BYTE b, BYTE *&pOut);
     int GetInData(void *pBuf, PINDEX count);
     int GetRawData(void *pBuf, PINDEX count);
     int GetHdlcData(void *pBuf, PINDEX count);
@@ -77,6 +79,18 @@ class HDLC
     int rawOnes;
     DWORD hdlcChunk;
     int hdlcChunkLen;
+    PBoolean hdlcAbort;		// the next flag position is unknown
+    PINDEX hdlcLen;			// bytes of the frame returned by GetData()
+
+    BYTE rawBuf[256];
+    PINDEX rawBufPos;
+    PINDEX rawBufLen;
+
+    enum {
+      unpackData,
+      unpackFlag,
+      unpackAbort,
+    };
 
     enum {
       stEof,
@@ -59,50 +59,11 @@
  */
 
 #include <ptlib.h>
-
-#ifdef USE_OPAL
-  #include <opal/buildopts.h>
-#endif
-
 #include "version.h"
-
-#ifdef USE_OPAL
-  #include "opal/manager.h"
-#else
-  #include "h323lib/h323ep.h"
-#endif
+#include "t38modem.h"
 
 #define new PNEW
 
-/////////////////////////////////////////////////////////////////////////////
-static PString GetListOfLibs()
-{
-  return
-#ifdef USE_OPAL
-    PString("OPAL-")
-    + PString(OPAL_VERSION)
-    + PString("/")
-    + OpalGetVersion()
-#else
-  #if OPENH323_MAJOR < 1 || (OPENH323_MAJOR == 1 && OPENH323_MINOR <= 19)
-    PString("OpenH323-") + PString(OPENH323_VERSION)
-  #else
-    PString("H323plus-") + PString(OPENH323_VERSION)
-  #endif
-#endif
-#ifdef PTLIB_VERSION
-    + PString(", PTLIB-")
-    + PString(PTLIB_VERSION)
-  #if PTLIB_MAJOR > 2 || (PTLIB_MAJOR == 2 && PTLIB_MINOR >= 6)
-    + PString("/")
-    + PProcess::GetLibVersion()
-  #endif
-#endif
-#ifdef PWLIB_VERSION
-    + PString(", PWLIB-") + PString(PWLIB_VERSION)
-#endif
-  ;
-}
 /////////////////////////////////////////////////////////////////////////////
 class T38Modem : public PProcess
 {
@@ -112,9 +73,6 @@ class T38Modem : public PProcess
     T38Modem();
 
     void Main();
-
-  protected:
-    PBoolean Initialise();
 };
 
 PCREATE_PROCESS(T38Modem);
@@ -135,7 +93,7 @@ void T38Modem::Main()
        << " (" << GetOSVersion() << '-' << GetOSHardware() << ")\n"
        << endl;
 
-  if (!Initialise()) {
+  if (!InitialiseT38Modem(*this)) {
     PThread::Sleep(100);  // workaround for race condition
     return;
   }
@@ -144,127 +102,5 @@ void T38Modem::Main()
     PThread::Sleep(5000);
 }
 
-PBoolean T38Modem::Initialise()
-{
-  PConfigArgs args(GetArguments());
-
-  args.Parse(
-#ifdef USE_OPAL
-             MyManager::ArgSpec() +
-#else
-             MyH323EndPoint::ArgSpec() +
-#endif
-             "h-help."
-             "v-version."
-#if PMEMORY_CHECK
-             "-setallocationbreakpoint:"
-#endif
-#if PTRACING
-             "t-trace."
-             "o-output:"
-#endif
-             "-save."
-          , FALSE);
-
-#if PMEMORY_CHECK
-  if (args.HasOption("setallocationbreakpoint"))
-    PMemoryHeap::SetAllocationBreakpoint(args.GetOptionString("setallocationbreakpoint").AsInteger());
-#endif
-
-#if PTRACING
-  PTrace::Initialise(args.GetOptionCount('t'),
-                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
-                     PTrace::DateAndTime | PTrace::Thread | PTrace::Blocks);
-#endif
-
-  if (args.HasOption('h')) {
-    cout <<
-        "Usage:\n"
-        "  " << GetName() << " [options]\n"
-        "\n"
-        "Options:\n"
-#if PTRACING
-        "  -t --trace                : Enable trace, use multiple times for more detail.\n"
-        "  -o --output file          : File for trace output, default is stderr.\n"
-#endif
-        "     --save                 : Save arguments in configuration file and exit.\n"
-        "  -v --version              : Display version.\n"
-        "  -h --help                 : Display this help message.\n"
-        "\n";
-
-    PStringArray descriptions =
-#ifdef USE_OPAL
-        MyManager::Descriptions();
-#else
-        MyH323EndPoint::Descriptions();
-#endif
-
-    for (PINDEX i = 0 ; i < descriptions.GetSize() ; i++)
-      cout << descriptions[i] << endl;
-
-    return FALSE;
-  }
-
-  PStringArray info =
-#ifdef USE_OPAL
-      MyManager::Descriptions(args);
-#else
-      MyH323EndPoint::Descriptions(args);
-#endif
-
-  if (info.GetSize() > 0) {
-    for (PINDEX i = 0 ; i < info.GetSize() ; i++)
-      cout << info[i] << endl;
-
-    return FALSE;
-  }
-
-  if (args.HasOption('v'))
-    return FALSE;
-
-  if (args.HasOption("save")) {
-    args.Save("save");
-    cout << "Arguments were saved in configuration file" << endl;
-    return FALSE;
-  }
-
-  PTRACE(1, GetName()
-      << " Version " << GetVersion(TRUE)
-      << " (" << GetListOfLibs() << ")"
-      << " on " << GetOSClass() << " " << GetOSName()
-      << " (" << GetOSVersion() << '-' << GetOSHardware() << ")");
-
-#if PTRACING
-  if (PTrace::CanTrace(3)) {
-    PTRACE(3, "Options: " << args);
-
-    const PConfig config;
-    const PStringArray keys = config.GetKeys();
-
-    if (!keys.IsEmpty()) {
-      PTRACE(3, "Config:");
-      for (PINDEX iK = 0 ; iK < keys.GetSize() ; iK++) {
-        const PStringArray values = config.GetString(keys[iK]).Lines();
-
-        for (PINDEX iV = 0 ; iV < values.GetSize() ; iV++) {
-          PTRACE(3, "  --" << keys[iK] << "=" << values[iV]);
-        }
-      }
-    }
-  }
-#endif
-
-#ifdef USE_OPAL
-  MyManager *manager = new MyManager();
-
-  if (!manager->Initialise(args))
-    return FALSE;
-#else
-  if (!MyH323EndPoint::Create(args))
-    return FALSE;
-#endif
-
-  return TRUE;
-}
 /////////////////////////////////////////////////////////////////////////////
 
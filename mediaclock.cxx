@@ -0,0 +1,259 @@
+/*
+ * mediaclock.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#include <ptlib.h>
+#include "pmutils.h"
+#include "mediaclock.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+#define msMaxSlip 1000
+
+static PInt64 msNow()
+{
+  return PTimer::Tick().GetMilliSeconds();
+}
+///////////////////////////////////////////////////////////////
+MediaDelay::MediaDelay()
+  : msTarget(msNow())
+  , tick(0)
+  , next(NULL)
+{
+}
+
+void MediaDelay::Restart()
+{
+  msTarget = msNow();
+  delay.Restart();
+}
+
+void MediaDelay::Delay(int ms)
+{
+  MediaClock *clock = MediaClock::Get();
+
+  if (!clock) {
+    delay.Delay(ms);
+    return;
+  }
+
+  msTarget += ms;
+
+  PInt64 now = msNow();
+
+  if (msTarget < now - msMaxSlip)
+    msTarget = now;
+
+  if (!clock->Schedule(*this, msTarget))
+    return;
+
+  if (!fired.Wait(PTimeInterval(ms + msMaxSlip))) {
+    myPTRACE(1, "MediaDelay::Delay timeout " << *clock);
+
+    if (!clock->Cancel(*this))
+      fired.Wait();
+  }
+}
+///////////////////////////////////////////////////////////////
+MediaClock *MediaClock::clock = NULL;
+
+PBoolean MediaClock::Start(unsigned msTick)
+{
+  if (clock)
+    return TRUE;
+
+  if (msTick == 0)
+    return FALSE;
+
+  clock = new MediaClock(msTick);
+  clock->Resume();
+
+  return TRUE;
+}
+
+MediaClock::MediaClock(unsigned _msTick)
+  : PThread(30000,
+            AutoDeleteThread,
+            HighestPriority,
+            "MediaClock")
+  , msTick(_msTick)
+  , msStart(msNow())
+  , tickDone(0)
+  , countTicks(0)
+  , countFired(0)
+  , countFiredMax(0)
+  , usCpu(0)
+  , usCpuMax(0)
+{
+  for (PINDEX i = 0 ; i < wheelSize ; i++)
+    wheel[i] = NULL;
+
+  for (PINDEX i = 0 ; i < latenessSlots ; i++)
+    countLateness[i] = 0;
+
+  PTRACE(1, "MediaClock: started with " << msTick << " ms tick");
+}
+
+PBoolean MediaClock::Schedule(MediaDelay &delay, PInt64 msTarget)
+{
+  PInt64 tick = (msTarget - msStart + msTick - 1)/msTick;
+
+  PWaitAndSignal mutexWait(mutex);
+
+  if (tick <= tickDone)
+    return FALSE;
+
+  unsigned slot = unsigned(tick % wheelSize);
+
+  delay.tick = tick;
+  delay.next = wheel[slot];
+  wheel[slot] = &delay;
+
+  return TRUE;
+}
+
+PBoolean MediaClock::Cancel(MediaDelay &delay)
+{
+  PWaitAndSignal mutexWait(mutex);
+
+  for (MediaDelay **pp = &wheel[delay.tick % wheelSize] ; *pp ; pp = &(*pp)->next) {
+    if (*pp == &delay) {
+      *pp = delay.next;
+      delay.next = NULL;
+      return TRUE;
+    }
+  }
+
+  return FALSE;
+}
+
+unsigned MediaClock::Fire(unsigned slot, PInt64 tickNow)
+{
+  unsigned count = 0;
+
+  for (MediaDelay **pp = &wheel[slot] ; *pp ;) {
+    MediaDelay *delay = *pp;
+
+    if (delay->tick <= tickNow) {
+      *pp = delay->next;
+      delay->next = NULL;
+      delay->fired.Signal();
+      count++;
+    } else {
+      pp = &delay->next;
+    }
+  }
+
+  return count;
+}
+
+void MediaClock::Main()
+{
+  static const unsigned latenessLimits[latenessSlots - 1] = { 1, 2, 5, 10, 20, 50 };
+  const PInt64 ticksPerReport = 60000/msTick + 1;
+
+  for (;;) {
+    PInt64 msTickTime = msStart + (tickDone + 1)*msTick;
+    PInt64 now = msNow();
+
+    if (msTickTime > now) {
+      PThread::Sleep(PTimeInterval(msTickTime - now));
+      now = msNow();
+    }
+
+    PInt64 tickNow = (now - msStart)/msTick;
+
+    if (tickNow <= tickDone)
+      continue;
+
+    PInt64 lateness = now - msTickTime;
+    PINDEX i;
+
+    for (i = 0 ; i < latenessSlots - 1 ; i++) {
+      if (lateness < latenessLimits[i])
+        break;
+    }
+
+    PInt64 usBegin = PTime().GetTimestamp();
+    unsigned count = 0;
+
+    {
+      PWaitAndSignal mutexWait(mutex);
+
+      PInt64 ticks = tickNow - tickDone;
+
+      if (ticks > wheelSize)
+        ticks = wheelSize;
+
+      for (PInt64 tick = tickNow - ticks + 1 ; tick <= tickNow ; tick++)
+        count += Fire(unsigned(tick % wheelSize), tickNow);
+
+      tickDone = tickNow;
+
+      countLateness[i]++;
+      countTicks++;
+      countFired += count;
+
+      if (countFiredMax < count)
+        countFiredMax = count;
+    }
+
+    PInt64 usTick = PTime().GetTimestamp() - usBegin;
+
+    {
+      PWaitAndSignal mutexWait(mutex);
+
+      usCpu += usTick;
+
+      if (usCpuMax < usTick)
+        usCpuMax = usTick;
+    }
+
+    if ((countTicks % ticksPerReport) == 0)
+      PTRACE(3, *this);
+  }
+}
+
+void MediaClock::PrintOn(ostream &strm) const
+{
+  static const char *latenessNames[latenessSlots] = {
+    "<1", "<2", "<5", "<10", "<20", "<50", ">=50"
+  };
+
+  PWaitAndSignal mutexWait(mutex);
+
+  strm << "MediaClock: tick=" << msTick << "ms"
+       << " ticks=" << countTicks
+       << " fired=" << countFired
+       << " batch max=" << countFiredMax
+       << " cpu avg=" << (countTicks ? usCpu/countTicks : 0) << "us"
+       << " max=" << usCpuMax << "us"
+       << " lateness(ms)";
+
+  for (PINDEX i = 0 ; i < latenessSlots ; i++)
+    strm << " " << latenessNames[i] << ":" << countLateness[i];
+}
+///////////////////////////////////////////////////////////////
+
@@ -0,0 +1,124 @@
+/*
+ * mediaclock.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#ifndef _PM_MEDIACLOCK_H
+#define _PM_MEDIACLOCK_H
+
+#include <ptclib/delaychan.h>
+
+///////////////////////////////////////////////////////////////
+class MediaClock;
+///////////////////////////////////////////////////////////////
+/*
+ * Drop-in replacement of PAdaptiveDelay for the media streams.
+ *
+ * If the shared media clock was started then the delays are
+ * timed by it, otherwise by own PAdaptiveDelay.
+ */
+class MediaDelay : public PObject
+{
+  PCLASSINFO(MediaDelay, PObject);
+
+  public:
+    MediaDelay();
+
+    void Restart();
+    void Delay(int ms);
+
+  protected:
+    PAdaptiveDelay delay;
+
+    PInt64 msTarget;
+    PInt64 tick;
+    MediaDelay *next;
+    PSyncPoint fired;
+
+    friend class MediaClock;
+};
+///////////////////////////////////////////////////////////////
+/*
+ * Shared media clock.
+ *
+ * The delays are kept in a timer wheel and all delays expired
+ * at the same tick are fired by one thread in a batch.
+ */
+class MediaClock : public PThread
+{
+  PCLASSINFO(MediaClock, PThread);
+
+  public:
+
+  /**@name Construction */
+  //@{
+    static PBoolean Start(unsigned msTick);
+    static MediaClock *Get() { return clock; }
+  //@}
+
+  /**@name Operations */
+  //@{
+    /*
+     * Returns FALSE if msTarget already expired
+     */
+    PBoolean Schedule(MediaDelay &delay, PInt64 msTarget);
+
+    /*
+     * Returns FALSE if delay was already fired
+     */
+    PBoolean Cancel(MediaDelay &delay);
+
+    void PrintOn(ostream &strm) const;
+  //@}
+
+  protected:
+    MediaClock(unsigned _msTick);
+
+    void Main();
+    unsigned Fire(unsigned slot, PInt64 tickNow);
+
+    enum {
+      wheelSize = 256,
+      latenessSlots = 7
+    };
+
+    static MediaClock *clock;
+
+    const unsigned msTick;
+    const PInt64 msStart;
+    PInt64 tickDone;
+    MediaDelay *wheel[wheelSize];
+    PMutex mutex;
+
+    // statistics
+    PInt64 countTicks;
+    PInt64 countFired;
+    PInt64 countFiredMax;
+    PInt64 usCpu;
+    PInt64 usCpuMax;
+    PInt64 countLateness[latenessSlots];
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _PM_MEDIACLOCK_H
+
@@ -0,0 +1,302 @@
+/*
+ * jitterbuf.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#include <ptlib.h>
+#include "jitterbuf.h"
+
+#define new PNEW
+
+/////////////////////////////////////////////////////////////////////////////
+#define SAMPLES_PER_MSEC          8
+#define QUIET_LEVEL               64          // average magnitude (about -50 dBm0)
+#define CONCEAL_FRAMES            3           // then silence
+/////////////////////////////////////////////////////////////////////////////
+static PBoolean IsQuiet(const PInt16 * frame, PINDEX samples)
+{
+  long sum = 0;
+
+  for (PINDEX i = 0 ; i < samples ; i++)
+    sum += frame[i] < 0 ? -frame[i] : frame[i];
+
+  return sum < QUIET_LEVEL*samples;
+}
+/////////////////////////////////////////////////////////////////////////////
+AudioJitterBuffer::AudioJitterBuffer(unsigned _minDelay, unsigned _maxDelay)
+  : isStarted(FALSE)
+  , isClosed(FALSE)
+  , minDelay(_minDelay*SAMPLES_PER_MSEC)
+  , maxDelay((_maxDelay < _minDelay ? _minDelay : _maxDelay)*SAMPLES_PER_MSEC)
+  , frameSamples(0)
+  , playTimestamp(0)
+  , newestTimestamp(0)
+  , rebuffer(TRUE)
+  , buffering(TRUE)
+  , prevTransit(0)
+  , jitter(0)
+  , concealed(0)
+  , totalPackets(0)
+  , totalLate(0)
+  , totalLost(0)
+  , totalUnderruns(0)
+  , totalOverflows(0)
+  , totalDropped(0)
+  , maxDepth(0)
+{
+  for (PINDEX i = 0 ; i < maxPackets ; i++)
+    packets[i].used = FALSE;
+}
+
+unsigned AudioJitterBuffer::GetTargetDelay() const
+{
+  unsigned delay = frameSamples + jitter/4;
+
+  if (delay < minDelay)
+    delay = minDelay;
+  else
+  if (delay > maxDelay)
+    delay = maxDelay;
+
+  return delay;
+}
+
+void AudioJitterBuffer::Put(DWORD timestamp, const BYTE * data, PINDEX size)
+{
+  PINDEX samples = size/sizeof(PInt16);
+
+  if (samples <= 0)
+    return;
+
+  PWaitAndSignal mutexWait(mutex);
+
+  if (isClosed)
+    return;
+
+  totalPackets++;
+
+  // interarrival jitter (RFC 3550)
+
+  int transit = int(DWORD(PTimer::Tick().GetMilliSeconds()*SAMPLES_PER_MSEC) - timestamp);
+
+  if (!isStarted) {
+    frameSamples = samples;
+    isStarted = TRUE;
+    startSync.Signal();
+  } else {
+    int d = transit - prevTransit;
+
+    jitter += (d < 0 ? -d : d) - (jitter + 8)/16;
+  }
+
+  prevTransit = transit;
+
+  if (!rebuffer) {
+    int offset = int(timestamp - playTimestamp);
+
+    if (offset > int(maxDelay*4) || offset + samples < -int(maxDelay*4)) {
+      PTRACE(3, "AudioJitterBuffer::Put: timestamp jump " << offset << ", resynchronizing");
+
+      for (PINDEX i = 0 ; i < maxPackets ; i++)
+        packets[i].used = FALSE;
+
+      rebuffer = TRUE;
+    } else
+    if (offset + samples <= 0) {
+      totalLate++;
+      return;
+    }
+  }
+
+  if (rebuffer) {
+    playTimestamp = timestamp - GetTargetDelay();
+    newestTimestamp = timestamp;
+    rebuffer = FALSE;
+    buffering = TRUE;
+  }
+
+  Packet *packet = NULL;
+  Packet *oldest = NULL;
+
+  for (PINDEX i = 0 ; i < maxPackets ; i++) {
+    if (!packets[i].used) {
+      packet = &packets[i];
+      break;
+    }
+
+    if (oldest == NULL || int(packets[i].timestamp - oldest->timestamp) < 0)
+      oldest = &packets[i];
+  }
+
+  if (packet == NULL) {
+    packet = oldest;
+    totalOverflows++;
+  }
+
+  packet->used = TRUE;
+  packet->timestamp = timestamp;
+  packet->samples = samples;
+  packet->data.SetSize(samples*sizeof(PInt16));
+  memcpy(packet->data.GetPointer(), data, samples*sizeof(PInt16));
+
+  if (int(timestamp + samples - newestTimestamp) > 0)
+    newestTimestamp = timestamp + samples;
+
+  unsigned depth = newestTimestamp - playTimestamp;
+
+  if (maxDepth < depth)
+    maxDepth = depth;
+}
+
+PINDEX AudioJitterBuffer::Get(BYTE * buffer, PINDEX size)
+{
+  if (!isStarted && !isClosed)
+    startSync.Wait();
+
+  PWaitAndSignal mutexWait(mutex);
+
+  if (isClosed)
+    return 0;
+
+  PInt16 *frame = (PInt16 *)buffer;
+  PINDEX samples = frameSamples;
+
+  if (samples > PINDEX(size/sizeof(PInt16)))
+    samples = size/sizeof(PInt16);
+
+  int depth = int(newestTimestamp - playTimestamp);
+
+  if (!rebuffer && depth > int(maxDelay) + samples) {
+    playTimestamp += depth - maxDelay;
+    totalDropped += depth - maxDelay;
+  }
+
+  for (;;) {
+    PINDEX filled = Fill(frame, samples);
+
+    depth = int(newestTimestamp - playTimestamp);
+    playTimestamp += samples;
+
+    if (filled == 0) {
+      if (!buffering) {
+        if (depth <= 0) {
+          totalUnderruns++;
+          rebuffer = buffering = TRUE;
+        } else {
+          totalLost++;
+        }
+      }
+
+      Conceal(frame, samples);
+      break;
+    }
+
+    // shrink the delay by dropping the quiet frames
+
+    if (depth - samples > int(GetTargetDelay()) + samples && IsQuiet(frame, samples)) {
+      totalDropped += samples;
+      continue;
+    }
+
+    buffering = FALSE;
+    lastFrame.SetSize(samples*sizeof(PInt16));
+    memcpy(lastFrame.GetPointer(), frame, samples*sizeof(PInt16));
+    concealed = 0;
+    break;
+  }
+
+  return samples*sizeof(PInt16);
+}
+
+PINDEX AudioJitterBuffer::Fill(PInt16 * frame, PINDEX samples)
+{
+  memset(frame, 0, samples*sizeof(PInt16));
+
+  PINDEX filled = 0;
+
+  for (PINDEX i = 0 ; i < maxPackets ; i++) {
+    Packet &packet = packets[i];
+
+    if (!packet.used)
+      continue;
+
+    int offset = int(packet.timestamp - playTimestamp);
+
+    if (offset + packet.samples <= 0) {
+      packet.used = FALSE;
+      continue;
+    }
+
+    if (offset >= samples)
+      continue;
+
+    PINDEX from = offset < 0 ? -offset : 0;
+    PINDEX to = offset + packet.samples > samples ? samples - offset : packet.samples;
+
+    memcpy(frame + offset + from, (const BYTE *)packet.data + from*sizeof(PInt16), (to - from)*sizeof(PInt16));
+    filled += to - from;
+
+    if (offset + packet.samples <= samples)
+      packet.used = FALSE;
+  }
+
+  return filled;
+}
+
+void AudioJitterBuffer::Conceal(PInt16 * frame, PINDEX samples)
+{
+  if (concealed < CONCEAL_FRAMES && lastFrame.GetSize() == PINDEX(samples*sizeof(PInt16))) {
+    const PInt16 *last = (const PInt16 *)(const BYTE *)lastFrame;
+    int gain = CONCEAL_FRAMES - concealed;
+
+    for (PINDEX i = 0 ; i < samples ; i++)
+      frame[i] = PInt16((last[i]*gain)/(CONCEAL_FRAMES + 1));
+
+    concealed++;
+  } else {
+    memset(frame, 0, samples*sizeof(PInt16));
+  }
+}
+
+void AudioJitterBuffer::Close()
+{
+  PWaitAndSignal mutexWait(mutex);
+
+  isClosed = TRUE;
+  startSync.Signal();
+}
+
+void AudioJitterBuffer::PrintOn(ostream & strm) const
+{
+  strm << "packets=" << totalPackets
+       << " late=" << totalLate
+       << " lost=" << totalLost
+       << " underruns=" << totalUnderruns
+       << " overflows=" << totalOverflows
+       << " dropped=" << totalDropped/SAMPLES_PER_MSEC << "ms"
+       << " max depth=" << maxDepth/SAMPLES_PER_MSEC << "ms"
+       << " target=" << GetTargetDelay()/SAMPLES_PER_MSEC << "ms"
+       << " jitter=" << jitter/(16*SAMPLES_PER_MSEC) << "ms";
+}
+/////////////////////////////////////////////////////////////////////////////
+
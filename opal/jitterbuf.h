@@ -0,0 +1,117 @@
+/*
+ * jitterbuf.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#ifndef _MY_JITTERBUF_H
+#define _MY_JITTERBUF_H
+
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * Adaptive jitter buffer of the 16-bit linear audio (8000 Hz) packets.
+ *
+ * The packets are put by the RTP timestamp and got by the frames of
+ * the first packet size at the playout pace. The playout delay is
+ * targeted to the frame size plus four times of the interarrival
+ * jitter (RFC 3550) in the min/max limits. It grows by re-buffering
+ * after an underrun and shrinks by dropping the quiet frames. The
+ * lost frames are concealed by repeating the last frame with fading.
+ */
+class AudioJitterBuffer : public PObject
+{
+    PCLASSINFO(AudioJitterBuffer, PObject);
+  public:
+    AudioJitterBuffer(
+      unsigned minDelay,                   ///<  Min playout delay (ms)
+      unsigned maxDelay                    ///<  Max playout delay (ms)
+    );
+
+    void Put(
+      DWORD timestamp,
+      const BYTE * data,
+      PINDEX size
+    );
+
+    /**Wait for the first packet and fill the buffer by the next
+       frame (not more than size bytes).
+       Returns the length of the frame or 0 if the buffer was closed.
+      */
+    PINDEX Get(
+      BYTE * buffer,
+      PINDEX size
+    );
+
+    void Close();
+
+    /**Print statistics.
+      */
+    virtual void PrintOn(ostream & strm) const;
+
+  protected:
+    unsigned GetTargetDelay() const;
+    PINDEX Fill(PInt16 * frame, PINDEX samples);
+    void Conceal(PInt16 * frame, PINDEX samples);
+
+    enum { maxPackets = 64 };
+
+    struct Packet {
+      PBoolean used;
+      DWORD timestamp;
+      PINDEX samples;
+      PBYTEArray data;
+    };
+
+    PMutex mutex;
+    PSyncPoint startSync;
+    PBoolean isStarted;
+    PBoolean isClosed;
+
+    unsigned minDelay;        // samples
+    unsigned maxDelay;        // samples
+    PINDEX frameSamples;
+
+    Packet packets[maxPackets];
+    DWORD playTimestamp;      // of the next got sample
+    DWORD newestTimestamp;    // of the end of newest packet
+    PBoolean rebuffer;        // re-anchor playout by next packet
+    PBoolean buffering;       // playout is not reached the packets yet
+
+    int prevTransit;
+    unsigned jitter;          // samples*16
+
+    PBYTEArray lastFrame;
+    int concealed;            // consecutive concealed frames
+
+    // statistics
+    unsigned long totalPackets;
+    unsigned long totalLate;
+    unsigned long totalLost;
+    unsigned long totalUnderruns;
+    unsigned long totalOverflows;
+    unsigned long totalDropped;   // samples
+    unsigned maxDepth;            // samples
+};
+/////////////////////////////////////////////////////////////////////////////
+
+#endif  // _MY_JITTERBUF_H
+
@@ -148,6 +148,7 @@
 #include "../enginebase.h"
 #include "../pmodem.h"
 #include "../drivers.h"
+#include "../tone_gen.h"
 #include "modemstrm.h"
 #include "modemep.h"
 #include "opalutils.h"
@@ -263,6 +264,11 @@ PString ModemEndPoint::ArgSpec()
     "-force-fax-mode."
     "-force-fax-mode-delay:"
     "-no-force-t38-mode."
+    "-t38-reorder:"
+    "-t38-aggregate."
+    "-t38-packet-interval:"
+    "-tone-plan:"
+    "-audio-jitter:"
   ;
 }
 
@@ -271,11 +277,20 @@ PStringArray ModemEndPoint::Descriptions()
   PStringArray descriptions = PString(
       "Modem options:\n"
       "  --no-modem                : Disable MODEM protocol.\n"
-      "  -p --ptty [num@]tty[,...] : Pseudo ttys. Can be used multiple times.\n"
+      "  -p --ptty [num[:policy]@]tty[*weight][,...]\n"
+      "                            : Pseudo ttys. Can be used multiple times.\n"
       "                              If tty prefixed by num@ then tty will\n"
       "                              accept incoming calls only\n"
       "                              for numbers with prefix num.\n"
       "                              Use none@tty to disable incoming calls.\n"
+      "                              The policy selects a ready tty for incoming\n"
+      "                              calls with prefix num:\n"
+      "                                fifo   - first enqueued (default),\n"
+      "                                rr     - round-robin,\n"
+      "                                lru    - least recently called,\n"
+      "                                weight - weighted round-robin by weight\n"
+      "                                         of tty (default is 1),\n"
+      "                                load   - least count of recent calls.\n"
       "                              See Modem drivers section for tty format.\n"
       "  --force-fax-mode          : Use OPAL-Force-Fax-Mode=true route option by\n"
       "                              default.\n"
@@ -284,6 +299,16 @@ PStringArray ModemEndPoint::Descriptions()
       "                              default.\n"
       "  --no-force-t38-mode       : Use OPAL-No-Force-T38-Mode=true route option by\n"
       "                              default.\n"
+      "  --t38-reorder ms          : Use OPAL-T38-Reorder=ms route option by\n"
+      "                              default.\n"
+      "  --t38-aggregate           : Use OPAL-T38-Aggregate=true route option by\n"
+      "                              default.\n"
+      "  --t38-packet-interval {ms|auto}\n"
+      "                            : Use OPAL-T38-Packet-Interval={ms|auto} route\n"
+      "                              option by default.\n"
+      "  --tone-plan plan          : Use OPAL-Tone-Plan=plan route option by default.\n"
+      "  --audio-jitter min[:max]  : Use OPAL-Audio-Jitter=min[:max] route option by\n"
+      "                              default.\n"
       "Modem route options:\n"
       "  OPAL-Set-Up-Phase-Timeout=secs\n"
       "    Set timeout for outgoing call Set-Up phase to secs seconds.\n"
@@ -296,6 +321,27 @@ PStringArray ModemEndPoint::Descriptions()
       "    Set Force-Fax-Mode to delay secs seconds.\n"
       "  OPAL-No-Force-T38-Mode={true|false}\n"
       "    Not enable or not disable forcing T.38 mode.\n"
+      "  OPAL-T38-Reorder=ms\n"
+      "    Hold the received out of order T.38 packets up to ms milliseconds to\n"
+      "    restore their order before declaring the missing ones lost. The hold\n"
+      "    time adapts to the observed reordering delay. Default is 0 (disabled).\n"
+      "  OPAL-T38-Aggregate={true|false}\n"
+      "    Send the last data of HDLC frame, FCS and sig-end in one IFP packet up to\n"
+      "    negotiated T38FaxMaxDatagram. Default is false.\n"
+      "  OPAL-T38-Packet-Interval={ms|auto}\n"
+      "    Send T.38 data each ms milliseconds or select the interval by bitrate\n"
+      "    (60 ms for 4800 bits/s and below ... 20 ms for 12000 bits/s and above).\n"
+      "    Default is 30.\n"
+      "  OPAL-Tone-Plan=plan\n"
+      "    Generate the call progress tones by plan. The plan is a list of items\n"
+      "    separated by ';'. An item is a country code (" + ToneGenerator::GetCountries() + ")\n"
+      "    or tone=spec, where tone is ring, busy, cng or ced and spec is a list of\n"
+      "    [!]hz[+hz][/ms] separated by ',' (see indications.conf of Asterisk).\n"
+      "    Default is ru.\n"
+      "  OPAL-Audio-Jitter=min[:max]\n"
+      "    Pass the received audio to the modem through the adaptive jitter buffer\n"
+      "    with min to max milliseconds playout delay (default max is 250). The lost\n"
+      "    packets are concealed. Default is 0 (disabled).\n"
       "Modem drivers:\n"
   ).Lines();
 
@@ -362,6 +408,21 @@ PBoolean ModemEndPoint::Initialise(const PConfigArgs & args)
   if (args.HasOption("no-force-t38-mode"))
     defaultStringOptions.SetAt("No-Force-T38-Mode", "true");
 
+  if (args.HasOption("t38-reorder"))
+    defaultStringOptions.SetAt("T38-Reorder", args.GetOptionString("t38-reorder"));
+
+  if (args.HasOption("t38-packet-interval"))
+    defaultStringOptions.SetAt("T38-Packet-Interval", args.GetOptionString("t38-packet-interval"));
+
+  if (args.HasOption("t38-aggregate"))
+    defaultStringOptions.SetAt("T38-Aggregate", "true");
+
+  if (args.HasOption("tone-plan"))
+    defaultStringOptions.SetAt("Tone-Plan", args.GetOptionString("tone-plan"));
+
+  if (args.HasOption("audio-jitter"))
+    defaultStringOptions.SetAt("Audio-Jitter", args.GetOptionString("audio-jitter"));
+
   return TRUE;
 }
 
@@ -655,8 +716,22 @@ OpalMediaStream * ModemConnection::CreateMediaStream(
     if (pmodem != NULL) {
       T38Engine *t38engine = pmodem->NewPtrT38Engine();
 
-      if (t38engine != NULL)
-        return new T38ModemMediaStream(*this, sessionID, isSource, t38engine);
+      if (t38engine != NULL) {
+        T38ModemMediaStream *stream = new T38ModemMediaStream(*this, sessionID, isSource, t38engine);
+
+        if (GetStringOptions().Contains("T38-Reorder"))
+          stream->SetMaxHoldTime(GetStringOptions()("T38-Reorder").AsUnsigned());
+
+        stream->SetAggregate(GetStringOptions().GetBoolean("T38-Aggregate"));
+
+        if (GetStringOptions().Contains("T38-Packet-Interval")) {
+          PString interval = GetStringOptions()("T38-Packet-Interval");
+
+          stream->SetMsPerOut((interval *= "auto") ? 0 : (int)interval.AsInteger());
+        }
+
+        return stream;
+      }
     }
   }
   else
@@ -664,8 +739,22 @@ OpalMediaStream * ModemConnection::CreateMediaStream(
     if (pmodem != NULL) {
       AudioEngine *audioEngine = pmodem->NewPtrAudioEngine();
 
-      if (audioEngine != NULL)
-        return new AudioModemMediaStream(*this, sessionID, isSource, audioEngine);
+      if (audioEngine != NULL) {
+        AudioModemMediaStream *stream = new AudioModemMediaStream(*this, sessionID, isSource, audioEngine);
+
+        stream->SetTonePlan(GetStringOptions()("Tone-Plan"));
+
+        if (GetStringOptions().Contains("Audio-Jitter")) {
+          PString jitter = GetStringOptions()("Audio-Jitter");
+          PINDEX colon = jitter.Find(':');
+          unsigned minDelay = jitter.Left(colon).AsUnsigned();
+          unsigned maxDelay = (colon != P_MAX_INDEX) ? jitter.Mid(colon + 1).AsUnsigned() : (minDelay ? 250 : 0);
+
+          stream->SetJitter(minDelay, maxDelay);
+        }
+
+        return stream;
+      }
     }
   }
 
@@ -75,10 +75,28 @@
 
 #include "../audio.h"
 #include "../t38engine.h"
+#include "../t38per.h"
+#include "jitterbuf.h"
 #include "modemstrm.h"
 
 #define new PNEW
 
+/////////////////////////////////////////////////////////////////////////////
+class AudioPlayoutThread : public PThread
+{
+    PCLASSINFO(AudioPlayoutThread, PThread);
+  public:
+    AudioPlayoutThread(AudioModemMediaStream &stream)
+      : PThread(30000, NoAutoDeleteThread)
+      , audioStream(stream)
+    {
+    }
+
+  protected:
+    virtual void Main() { audioStream.Playout(); }
+
+    AudioModemMediaStream &audioStream;
+};
 /////////////////////////////////////////////////////////////////////////////
 AudioModemMediaStream::AudioModemMediaStream(
     OpalConnection & conn,
@@ -87,6 +105,10 @@ AudioModemMediaStream::AudioModemMediaStream(
     AudioEngine *engine)
   : OpalMediaStream(conn, OpalPCM16, sessionID, isSource)
   , audioEngine(engine)
+  , jitterMin(0)
+  , jitterMax(0)
+  , jitterBuffer(NULL)
+  , playoutThread(NULL)
 {
   PTRACE(4, "AudioModemMediaStream::AudioModemMediaStream " << *this);
 
@@ -95,6 +117,14 @@ AudioModemMediaStream::AudioModemMediaStream(
 
 AudioModemMediaStream::~AudioModemMediaStream()
 {
+  if (playoutThread) {
+    playoutThread->WaitForTermination();
+    delete playoutThread;
+  }
+
+  if (jitterBuffer)
+    delete jitterBuffer;
+
   ReferenceObject::DelPointer(audioEngine);
 }
 
@@ -105,10 +135,27 @@ PBoolean AudioModemMediaStream::Open()
 
   PTRACE(3, "AudioModemMediaStream::Open " << *this);
 
-  if (IsSink())
+  if (IsSink()) {
     audioEngine->OpenIn(EngineBase::HOWNERIN(this));
-  else
+
+    if (jitterMax > 0) {
+      PTRACE(3, "AudioModemMediaStream::Open jitter buffer " << jitterMin << "-" << jitterMax << "ms");
+
+      if (playoutThread) {
+        // re-opening
+        playoutThread->WaitForTermination();
+        delete playoutThread;
+        delete jitterBuffer;
+      }
+
+      jitterBuffer = new AudioJitterBuffer(jitterMin, jitterMax);
+      playoutThread = new AudioPlayoutThread(*this);
+      playoutThread->Resume();
+    }
+  } else {
     audioEngine->OpenOut(EngineBase::HOWNEROUT(this));
+    audioEngine->SetTonePlan(EngineBase::HOWNEROUT(this), tonePlan);
+  }
 
   return OpalMediaStream::Open();
 }
@@ -122,10 +169,17 @@ PBoolean AudioModemMediaStream::Close()
   if (isOpen) {
     PTRACE(3, "AudioModemMediaStream::Close " << *this);
 
-    if (IsSink())
+    if (IsSink()) {
+      if (jitterBuffer) {
+        jitterBuffer->Close();
+
+        PTRACE(2, "AudioModemMediaStream::Close Jitter buffer statistics: " << *jitterBuffer);
+      }
+
       audioEngine->CloseIn(EngineBase::HOWNERIN(this));
-    else
+    } else {
       audioEngine->CloseOut(EngineBase::HOWNEROUT(this));
+    }
   }
 
 #if (OPAL_PACK_VERSION(OPAL_MAJOR, OPAL_MINOR, OPAL_BUILD) < OPAL_PACK_VERSION(3, 10, 5))
@@ -156,6 +210,35 @@ PBoolean AudioModemMediaStream::WriteData(const BYTE * data, PINDEX length, PIND
 
   return true;
 }
+
+PBoolean AudioModemMediaStream::WritePacket(RTP_DataFrame & packet)
+{
+  if (jitterBuffer == NULL)
+    return OpalMediaStream::WritePacket(packet);
+
+  if (!isOpen)
+    return false;
+
+  jitterBuffer->Put(packet.GetTimestamp(), packet.GetPayloadPtr(), packet.GetPayloadSize());
+
+  return true;
+}
+
+void AudioModemMediaStream::Playout()
+{
+  PTRACE(3, "AudioModemMediaStream::Playout started " << *this);
+
+  BYTE buf[8*2*60];   // up to 60 ms
+
+  for (;;) {
+    PINDEX len = jitterBuffer->Get(buf, sizeof(buf));
+
+    if (len == 0 || !audioEngine->Write(EngineBase::HOWNERIN(this), buf, len))
+      break;
+  }
+
+  PTRACE(3, "AudioModemMediaStream::Playout stopped " << *this);
+}
 /////////////////////////////////////////////////////////////////////////////
 T38ModemMediaStream::T38ModemMediaStream(
     OpalConnection & conn,
@@ -164,17 +247,28 @@ T38ModemMediaStream::T38ModemMediaStream(
     T38Engine *engine)
   : OpalMediaStream(conn, OpalT38, sessionID, isSource)
   , t38engine(engine)
+  , aggregate(FALSE)
+  , msPerOut(-1)
+  , maxHoldTime(0)
+  , fec(NULL)
 {
   PTRACE(4, "T38ModemMediaStream::T38ModemMediaStream " << *this);
 
   PAssert(t38engine != NULL, "t38engine is NULL");
 
+  holdTimer.SetNotifier(PCREATE_NOTIFIER(OnHoldTimeout));
+
   PTRACE(4, "T38ModemMediaStream::T38ModemMediaStream DataSize=" << GetDataSize());
 }
 
 T38ModemMediaStream::~T38ModemMediaStream()
 {
+  holdTimer.Stop();
+
   ReferenceObject::DelPointer(t38engine);
+
+  if (fec)
+    delete fec;
 }
 
 PBoolean T38ModemMediaStream::Open()
@@ -186,13 +280,33 @@ PBoolean T38ModemMediaStream::Open()
 
   currentSequenceNumber = 0;
 #if PTRACING
+  totalrecovered = 0;
   totallost = 0;
+  totalreordered = 0;
+  totallate = 0;
+  maxreorderdepth = 0;
 #endif
 
-  if (IsSink())
+  {
+    PWaitAndSignal mutexWait(holdMutex);
+
+    reorderDelay = 0;
+    countHeld = 0;
+    lostMask = 0;
+
+    for (PINDEX i = 0 ; i < maxHeld ; i++)
+      held[i].seq = -1;
+  }
+
+  if (fec)
+    fec->Reset();
+
+  if (IsSink()) {
     t38engine->OpenIn(EngineBase::HOWNERIN(this));
-  else
+  } else {
     t38engine->OpenOut(EngineBase::HOWNEROUT(this));
+    t38engine->SetMsPerOut(EngineBase::HOWNEROUT(this), msPerOut);
+  }
 
   return OpalMediaStream::Open();
 }
@@ -207,9 +321,19 @@ PBoolean T38ModemMediaStream::Close()
     PTRACE(3, "T38ModemMediaStream::Close " << *this);
 
     if (IsSink()) {
+      {
+        PWaitAndSignal mutexWait(holdMutex);
+        ReleaseHeld(PTimer::Tick().GetMilliSeconds(), TRUE);
+      }
+
       PTRACE(2, "T38ModemMediaStream::Close Send statistics:"
                 " sequence=" << currentSequenceNumber <<
-                " lost=" << totallost);
+                " recovered=" << totalrecovered <<
+                " lost=" << totallost <<
+                " reordered=" << totalreordered <<
+                " late=" << totallate <<
+                " max reorder depth=" << maxreorderdepth <<
+                " hold time=" << GetHoldTime() << "/" << maxHoldTime << "ms");
 
       t38engine->CloseIn(EngineBase::HOWNERIN(this));
     } else {
@@ -248,6 +372,16 @@ void T38ModemMediaStream::OnStartMediaPatch()
 
             t38engine->SetPreparePacketTimeout(EngineBase::HOWNEROUT(this), -1);
           }
+
+          if (aggregate) {
+            // 0 if not negotiated (the aggregated fields add a few bytes only)
+            PINDEX maxDatagram = format.GetOptionInteger("T38FaxMaxDatagram", 0);
+
+            myPTRACE(3, "T38ModemMediaStream::OnStartMediaPatch: aggregate up to "
+                        << (maxDatagram > 0 ? PString(maxDatagram) : PString("unlimited")) << " bytes");
+
+            t38engine->SetMaxDatagram(EngineBase::HOWNEROUT(this), maxDatagram > 0 ? maxDatagram : P_MAX_INDEX);
+          }
         } else {
           myPTRACE(1, "T38ModemMediaStream::OnStartMediaPatch: format is invalid !!!");
         }
@@ -282,11 +416,18 @@ PBoolean T38ModemMediaStream::ReadPacket(RTP_DataFrame & packet)
   if (res > 0) {
     PTRACE(4, "T38ModemMediaStream::ReadPacket ifp = " << setprecision(2) << ifp);
 
-    PASN_OctetString ifp_packet;
-    ifp_packet.EncodeSubType(ifp);
+    PINDEX size = T38Per::EncodeIFP(ifp, packet.GetPayloadPtr(), packet.GetSize() - packet.GetHeaderSize());
+
+    if (size > 0) {
+      packet.SetPayloadSize(size);
+    } else {
+      PASN_OctetString ifp_packet;
+      ifp_packet.EncodeSubType(ifp);
+
+      packet.SetPayloadSize(ifp_packet.GetDataLength());
+      memcpy(packet.GetPayloadPtr(), ifp_packet.GetPointer(), ifp_packet.GetDataLength());
+    }
 
-    packet.SetPayloadSize(ifp_packet.GetDataLength());
-    memcpy(packet.GetPayloadPtr(), ifp_packet.GetPointer(), ifp_packet.GetDataLength());
     packet.SetSequenceNumber(WORD(currentSequenceNumber++ & 0xFFFF));
   }
   else
@@ -327,44 +468,126 @@ PBoolean T38ModemMediaStream::WritePacket(RTP_DataFrame & packet)
     return TRUE;
   }
 
-  long packedSequenceNumber = (packet.GetSequenceNumber() & 0xFFFF) + (currentSequenceNumber & ~0xFFFFL);
+  PWaitAndSignal mutexWait(holdMutex);
+
+  PInt64 now = PTimer::Tick().GetMilliSeconds();
+  WORD seq = packet.GetSequenceNumber();
+  T38PerUDPTL udptl;
+
+  // the payload can be framed by UDPTL with the error recovery field
+  // (secondary IFP packets or FEC)
+
+  if (packet.GetPayloadSize() > 2 &&
+      T38Per::DecodeUDPTL(packet.GetPayloadPtr(), packet.GetPayloadSize(), udptl) &&
+      WORD(udptl.seq) == seq)
+  {
+    if (udptl.recovery == T38PerUDPTL::e_secondary_ifp_packets) {
+      for (PINDEX i = udptl.count ; i > 0 ; i--) {
+        if (!WriteIFP(WORD(seq - i), udptl.entry[i - 1], udptl.entrySize[i - 1], now, TRUE))
+          return FALSE;
+      }
+    } else {
+      if (fec == NULL)
+        fec = new T38PerFec;
+
+      long udptlSeq = PackSequenceNumber(seq);
+      long s = currentSequenceNumber;
+
+      if (s < udptlSeq - T38PerFec::historySize)
+        s = udptlSeq - T38PerFec::historySize;
+
+      for (; s < udptlSeq ; s++) {
+        PBYTEArray recovered;
+
+        if (!fec->Recover(s, udptlSeq, udptl, recovered))
+          continue;
+
+        fec->Put(s, recovered, recovered.GetSize());
+
+        if (!WriteIFP(WORD(s), recovered, recovered.GetSize(), now, TRUE))
+          return FALSE;
+      }
+
+      fec->Put(udptlSeq, udptl.primary, udptl.primarySize);
+    }
+
+    return WriteIFP(seq, udptl.primary, udptl.primarySize, now, FALSE);
+  }
+
+  return WriteIFP(seq, packet.GetPayloadPtr(), packet.GetPayloadSize(), now, FALSE);
+}
+
+long T38ModemMediaStream::PackSequenceNumber(WORD seq) const
+{
+  long packedSequenceNumber = (seq & 0xFFFF) + (currentSequenceNumber & ~0xFFFFL);
   long lost = packedSequenceNumber - currentSequenceNumber;
 
-  if (lost < -0x10000L/2) {
-    lost += 0x10000L;
+  if (lost < -0x10000L/2)
     packedSequenceNumber += 0x10000L;
-  }
   else
-  if (lost > 0x10000L/2) {
-    lost -= 0x10000L;
+  if (lost > 0x10000L/2)
     packedSequenceNumber -= 0x10000L;
+
+  return packedSequenceNumber;
+}
+
+PBoolean T38ModemMediaStream::WriteIFP(WORD seq, const BYTE *payload, PINDEX size, PInt64 now, PBoolean secondary)
+{
+  long packedSequenceNumber = PackSequenceNumber(seq);
+  long lost = packedSequenceNumber - currentSequenceNumber;
+
+  if (secondary) {
+    if (size == 0 || lost < 0 || (lost < maxHeld && held[packedSequenceNumber % maxHeld].seq == packedSequenceNumber))
+      return TRUE;
+
+    PTRACE(3, "T38ModemMediaStream::WritePacket: secondary packet " << packedSequenceNumber
+           << " (expected " << currentSequenceNumber << ")");
+
+#if PTRACING
+    totalrecovered++;
+#endif
   }
 
   if (lost < 0) {
     PTRACE(lost == -1 ? 5 : 3,
-        "T38ModemMediaStream::WritePacket: " << (packet.GetPayloadSize() == 0 ? "Fake" : "Repeated") <<
+        "T38ModemMediaStream::WritePacket: " << (size == 0 ? "Fake" : "Repeated") <<
         " packet " << packedSequenceNumber << " (expected " << currentSequenceNumber << ")");
 
-    if (lost > -10)
+    if (lost > -10) {
+      if (size != 0)
+        OnLatePacket(packedSequenceNumber, now);
+
       return TRUE;
+    }
   }
 
-  if (packet.GetPayloadSize() == 0) {
+  if (size == 0) {
     PTRACE(5, "T38ModemMediaStream::WritePacket: ignored fake packet");
     return TRUE;
   }
 
-  PASN_OctetString ifp_packet((const char *)packet.GetPayloadPtr(), packet.GetPayloadSize());
+  if (lost > 0 && lost < maxHeld && maxHoldTime) {
+    HoldPacket(packedSequenceNumber, now, payload, size);
+    return ReleaseHeld(now, FALSE);
+  }
 
-  T38_IFP ifp;
+  if (lost == 0) {
+    if (countHeld)
+      OnReorderedPacket(packedSequenceNumber, now);
 
-  if (!ifp_packet.DecodeSubType(ifp)) {
-    PTRACE(2, "T38ModemMediaStream::WritePacket " T38_IFP_NAME " decode failure: "
-        << PRTHEX(PBYTEArray(ifp_packet)) << "\n  ifp = "
-        << setprecision(2) << ifp);
-    return TRUE;
+    if (!HandleIFP(packedSequenceNumber, payload, size))
+      return FALSE;
+
+    return ReleaseHeld(now, FALSE);
   }
 
+  // out of the reorder window
+
+  if (!ReleaseHeld(now, TRUE))
+    return FALSE;
+
+  lost = packedSequenceNumber - currentSequenceNumber;
+
   if (lost != 0) {
     if (lost < 0 || lost > 10)
       lost = 1;
@@ -377,11 +600,188 @@ PBoolean T38ModemMediaStream::WritePacket(RTP_DataFrame & packet)
       return FALSE;
 
     PTRACE(3, "T38ModemMediaStream::WritePacket: adjusting sequence number to " << packedSequenceNumber);
+
+    lostMask = 0;
+    currentSequenceNumber = packedSequenceNumber;
   }
 
-  currentSequenceNumber = packedSequenceNumber + 1;
+  return HandleIFP(packedSequenceNumber, payload, size);
+}
+
+PBoolean T38ModemMediaStream::HandleIFP(long seq, const BYTE *payload, PINDEX size)
+{
+  currentSequenceNumber = seq + 1;
+  lostMask <<= 1;
+
+  // decay the reorder delay (about 1/256 per packet)
+  reorderDelay -= reorderDelay >> 8;
+
+  T38_IFP ifp;
+
+  if (!T38Per::DecodeIFP(payload, size, ifp)) {
+    PASN_OctetString ifp_packet((const char *)payload, size);
+
+    if (!ifp_packet.DecodeSubType(ifp)) {
+      PTRACE(2, "T38ModemMediaStream::WritePacket " T38_IFP_NAME " decode failure: "
+          << PRTHEX(PBYTEArray(ifp_packet)) << "\n  ifp = "
+          << setprecision(2) << ifp);
+      return TRUE;
+    }
+  }
 
   return t38engine->HandlePacket(EngineBase::HOWNERIN(this), ifp);
 }
-/////////////////////////////////////////////////////////////////////////////
 
+PBoolean T38ModemMediaStream::HandleLost(long seq, PInt64 timeGap)
+{
+  long lost = seq - currentSequenceNumber;
+
+  PTRACE(3, "T38ModemMediaStream::WritePacket: lost " << lost << " packets before " << seq);
+
+#if PTRACING
+  totallost += lost;
+#endif
+
+  for ( ; currentSequenceNumber < seq ; currentSequenceNumber++) {
+    lostMask = (lostMask << 1) | 1;
+    timeLost[currentSequenceNumber % lostWindow] = timeGap;
+  }
+
+  return t38engine->HandlePacketLost(EngineBase::HOWNERIN(this), lost);
+}
+
+void T38ModemMediaStream::HoldPacket(long seq, PInt64 now, const BYTE *payload, PINDEX size)
+{
+  HeldPacket &slot = held[seq % maxHeld];
+
+  if (slot.seq == seq) {
+    PTRACE(4, "T38ModemMediaStream::WritePacket: repeated held packet " << seq);
+    return;
+  }
+
+  PTRACE(4, "T38ModemMediaStream::WritePacket: hold packet " << seq << " (expected " << currentSequenceNumber << ")");
+
+  slot.seq = seq;
+  slot.time = now;
+  slot.payload = PBYTEArray(payload, size);
+  countHeld++;
+}
+
+PBoolean T38ModemMediaStream::ReleaseHeld(PInt64 now, PBoolean all)
+{
+  while (countHeld) {
+    HeldPacket &next = held[currentSequenceNumber % maxHeld];
+
+    if (next.seq == currentSequenceNumber) {
+      next.seq = -1;
+      countHeld--;
+
+      if (!HandleIFP(currentSequenceNumber, next.payload, next.payload.GetSize()))
+        return FALSE;
+
+      continue;
+    }
+
+    HeldPacket *first = NULL;
+
+    for (PINDEX i = 0 ; i < maxHeld ; i++) {
+      if (held[i].seq >= 0 && (first == NULL || held[i].seq < first->seq))
+        first = &held[i];
+    }
+
+    if (!all && first->time + GetHoldTime() > now) {
+      // if no packets come then release it by the timer
+      holdTimer.SetInterval(first->time + GetHoldTime() - now);
+      break;
+    }
+
+    if (!HandleLost(first->seq, first->time))
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+void T38ModemMediaStream::OnHoldTimeout(PTimer &, INT)
+{
+  PWaitAndSignal mutexWait(holdMutex);
+
+  if (!isOpen || !countHeld)
+    return;
+
+  PTRACE(4, "T38ModemMediaStream::OnHoldTimeout: held " << countHeld << " packets"
+            " (expected " << currentSequenceNumber << ")");
+
+  ReleaseHeld(PTimer::Tick().GetMilliSeconds(), FALSE);
+}
+
+void T38ModemMediaStream::OnReorderedPacket(long seq, PInt64 now)
+{
+  long depth = 0;
+  PInt64 timeFirst = now;
+
+  for (PINDEX i = 0 ; i < maxHeld ; i++) {
+    if (held[i].seq < 0)
+      continue;
+
+    if (depth < held[i].seq - seq)
+      depth = held[i].seq - seq;
+
+    if (timeFirst > held[i].time)
+      timeFirst = held[i].time;
+  }
+
+  UpdateReorderDelay(now - timeFirst);
+
+#if PTRACING
+  totalreordered++;
+
+  if (maxreorderdepth < depth)
+    maxreorderdepth = depth;
+#endif
+
+  PTRACE(4, "T38ModemMediaStream::WritePacket: reordered packet " << seq << " depth=" << depth);
+}
+
+void T38ModemMediaStream::UpdateReorderDelay(PInt64 ms)
+{
+  if (ms > maxHoldTime)
+    ms = maxHoldTime;
+
+  unsigned delay = unsigned(ms)*1000;
+
+  if (reorderDelay < delay)
+    reorderDelay = delay;
+}
+
+void T38ModemMediaStream::OnLatePacket(long seq, PInt64 now)
+{
+  long depth = currentSequenceNumber - 1 - seq;
+
+  if (depth >= lostWindow || (lostMask & (PUInt64(1) << depth)) == 0)
+    return;     // repeated
+
+  // the packet was already handled as lost
+
+  lostMask &= ~(PUInt64(1) << depth);
+
+  UpdateReorderDelay(now - timeLost[seq % lostWindow]);
+
+#if PTRACING
+  totallate++;
+
+  if (maxreorderdepth < depth + 1)
+    maxreorderdepth = depth + 1;
+#endif
+
+  PTRACE(3, "T38ModemMediaStream::WritePacket: late packet " << seq
+         << " (expected " << currentSequenceNumber << "), hold time " << GetHoldTime() << "ms");
+}
+
+unsigned T38ModemMediaStream::GetHoldTime() const
+{
+  unsigned ms = reorderDelay*3/2000;
+
+  return ms < maxHoldTime ? ms : maxHoldTime;
+}
+/////////////////////////////////////////////////////////////////////////////
@@ -57,6 +57,7 @@
 
 /////////////////////////////////////////////////////////////////////////////
 class AudioEngine;
+class AudioJitterBuffer;
 
 class AudioModemMediaStream : public OpalMediaStream
 {
@@ -96,14 +97,39 @@ class AudioModemMediaStream : public OpalMediaStream
       PINDEX & written                     ///<  Length of data actually written
     );
 
+    virtual PBoolean WritePacket(
+      RTP_DataFrame & packet
+    );
+
     virtual PBoolean IsSynchronous() const { return FALSE; }
   //@}
 
+    /**Set the tone plan (see ToneGenerator) of the generated tones.
+      */
+    void SetTonePlan(const PString &plan) { tonePlan = plan; }
+
+    /**Set min and max playout delay (ms) of the jitter buffer
+       (0 - do not use the jitter buffer).
+      */
+    void SetJitter(unsigned minDelay, unsigned maxDelay) { jitterMin = minDelay; jitterMax = maxDelay; }
+
+    /**Write the audio from the jitter buffer to the engine at the
+       playout pace (the body of the playout thread).
+      */
+    void Playout();
+
   protected:
     AudioEngine *audioEngine;
+    PString tonePlan;
+
+    unsigned jitterMin;         // ms
+    unsigned jitterMax;         // ms
+    AudioJitterBuffer *jitterBuffer;
+    PThread *playoutThread;
 };
 /////////////////////////////////////////////////////////////////////////////
 class T38Engine;
+class T38PerFec;
 
 class T38ModemMediaStream : public OpalMediaStream
 {
@@ -144,12 +170,67 @@ class T38ModemMediaStream : public OpalMediaStream
     virtual PBoolean IsSynchronous() const { return FALSE; }
   //@}
 
+    /**Set maximum time (ms) of holding the received packets
+       to restore their order (0 - do not hold).
+      */
+    void SetMaxHoldTime(unsigned ms) { maxHoldTime = ms; }
+
+    /**Enable aggregation of the last data field of a frame with the
+       FCS and sig-end fields in one IFP packet up to the negotiated
+       T38FaxMaxDatagram.
+      */
+    void SetAggregate(PBoolean enable) { aggregate = enable; }
+
+    /**Set the packetization interval of T.38 data
+       (>0 - ms, 0 - selected by bitrate, <0 - default).
+      */
+    void SetMsPerOut(int ms) { msPerOut = ms; }
+
   protected:
+    long PackSequenceNumber(WORD seq) const;
+    PBoolean WriteIFP(WORD seq, const BYTE *payload, PINDEX size, PInt64 now, PBoolean secondary);
+    PBoolean HandleIFP(long seq, const BYTE *payload, PINDEX size);
+    PBoolean HandleLost(long seq, PInt64 timeGap);
+    PBoolean ReleaseHeld(PInt64 now, PBoolean all);
+    void HoldPacket(long seq, PInt64 now, const BYTE *payload, PINDEX size);
+    void OnReorderedPacket(long seq, PInt64 now);
+    void OnLatePacket(long seq, PInt64 now);
+    void UpdateReorderDelay(PInt64 ms);
+    unsigned GetHoldTime() const;
+
+    PDECLARE_NOTIFIER(PTimer, T38ModemMediaStream, OnHoldTimeout);
+
     long currentSequenceNumber;
 #if PTRACING
+    int totalrecovered;
     int totallost;
+    int totalreordered;
+    int totallate;
+    long maxreorderdepth;
 #endif
     T38Engine * t38engine;
+    PBoolean aggregate;
+    int msPerOut;
+
+    // reorder buffer
+    enum { maxHeld = 32, lostWindow = 64 };
+
+    struct HeldPacket {
+      long seq;                 // -1 if not used
+      PInt64 time;              // ms
+      PBYTEArray payload;
+    };
+
+    unsigned maxHoldTime;       // ms
+    unsigned reorderDelay;      // us, adaptive
+    HeldPacket held[maxHeld];
+    PINDEX countHeld;
+    PUInt64 lostMask;           // the bit i is set if currentSequenceNumber - 1 - i was lost
+    PInt64 timeLost[lostWindow];
+    PTimer holdTimer;           // releases the held packets if no packets come
+    PMutex holdMutex;
+
+    T38PerFec *fec;             // created on first received FEC
 };
 /////////////////////////////////////////////////////////////////////////////
 
@@ -68,6 +68,7 @@
  */
 
 #include <ptlib.h>
+#include <math.h>
 #include "pmodem.h"
 #include "drivers.h"
 
@@ -75,23 +76,30 @@
 
 ///////////////////////////////////////////////////////////////
 PLIST(_PseudoModemList, PseudoModem);
+PDICTIONARY(_PseudoModemIndex, PString, PseudoModem);
 
 class PseudoModemList : protected _PseudoModemList
 {
     PCLASSINFO(PseudoModemList, _PseudoModemList);
   public:
+    PseudoModemList();
     PINDEX Append(PseudoModem *modem);
     PseudoModem *Find(const PString &modemToken) const;
   protected:
-    PseudoModem *_Find(const PString &modemToken) const;
+    _PseudoModemIndex index;	// by modem token
     PMutex Mutex;
 };
 
+PseudoModemList::PseudoModemList()
+{
+  index.DisallowDeleteObjects();
+}
+
 PINDEX PseudoModemList::Append(PseudoModem *modem)
 {
   PWaitAndSignal mutexWait(Mutex);
 
-  if (_Find(modem->modemToken())) {
+  if (index.Contains(modem->modemToken())) {
     myPTRACE(1, "PseudoModemList::Append can't add " << modem->ptyName() << " to modem list");
     delete modem;
     return P_MAX_INDEX;
@@ -99,6 +107,8 @@ PINDEX PseudoModemList::Append(PseudoModem *modem)
 
   PINDEX i = _PseudoModemList::Append(modem);
 
+  index.SetAt(modem->modemToken(), modem);
+
   myPTRACE(3, "PseudoModemList::Append " << modem->ptyName() << " (" << i << ") OK");
 
   return i;
@@ -107,22 +117,267 @@ PINDEX PseudoModemList::Append(PseudoModem *modem)
 PseudoModem *PseudoModemList::Find(const PString &modemToken) const
 {
   PWaitAndSignal mutexWait(Mutex);
-  return _Find(modemToken);
+  return index.GetAt(modemToken);
 }
+///////////////////////////////////////////////////////////////
+/*
+ * Policy of selecting a ready modem for incoming call.
+ */
+class PseudoModemPolicy
+{
+  public:
+    virtual ~PseudoModemPolicy() {}
+
+    static PseudoModemPolicy *Create(const PString &name);
+
+    virtual const char *Name() const = 0;
+
+    /*
+     * Returns the selected ready modem from the list of queued modems
+     * or NULL if there are not ready modems
+     */
+    virtual PseudoModem *Select(PseudoModem *first) = 0;
 
-PseudoModem *PseudoModemList::_Find(const PString &modemToken) const
+    static void OnCall(PseudoModem *modem, PInt64 now);
+
+  protected:
+    static PseudoModemQEntry &Entry(PseudoModem *modem) { return modem->qEntry; }
+    static PseudoModem *Next(PseudoModem *modem) { return modem->qEntry.next; }
+    static double RecentCalls(PseudoModem *modem, PInt64 now);
+};
+
+#define msRecentCallsHalfLife (15*60*1000)
+
+void PseudoModemPolicy::OnCall(PseudoModem *modem, PInt64 now)
 {
-  PObject *object;
+  PseudoModemQEntry &entry = Entry(modem);
+
+  entry.recentCalls = RecentCalls(modem, now) + 1;
+  entry.timeLastCall = now;
+}
+
+double PseudoModemPolicy::RecentCalls(PseudoModem *modem, PInt64 now)
+{
+  const PseudoModemQEntry &entry = Entry(modem);
+
+  if (entry.recentCalls == 0)
+    return 0;
+
+  return entry.recentCalls*pow(0.5, double(now - entry.timeLastCall)/msRecentCallsHalfLife);
+}
+///////////////////////////////////////////////////////////////
+/*
+ * The first ready modem (FIFO by enqueueing)
+ */
+class PseudoModemPolicyFifo : public PseudoModemPolicy
+{
+  public:
+    const char *Name() const { return "fifo"; }
+
+    PseudoModem *Select(PseudoModem *first)
+    {
+      for (PseudoModem *modem = first ; modem ; modem = Next(modem)) {
+        if (modem->IsReady())
+          return modem;
+      }
+
+      return NULL;
+    }
+};
+///////////////////////////////////////////////////////////////
+/*
+ * The ready modem next to the last selected one (in order of creation)
+ */
+class PseudoModemPolicyRoundRobin : public PseudoModemPolicy
+{
+  public:
+    PseudoModemPolicyRoundRobin() : seqLast(-1) {}
+
+    const char *Name() const { return "rr"; }
+
+    PseudoModem *Select(PseudoModem *first)
+    {
+      PseudoModem *next = NULL;
+      PseudoModem *lowest = NULL;
+
+      for (PseudoModem *modem = first ; modem ; modem = Next(modem)) {
+        PINDEX seq = Entry(modem).seq;
+
+        if (seq > seqLast && next && Entry(next).seq < seq)
+          continue;
+
+        if (seq <= seqLast && lowest && Entry(lowest).seq < seq)
+          continue;
+
+        if (!modem->IsReady())
+          continue;
+
+        if (seq > seqLast)
+          next = modem;
+        else
+          lowest = modem;
+      }
+
+      if (!next)
+        next = lowest;
+
+      if (next)
+        seqLast = Entry(next).seq;
+
+      return next;
+    }
+
+  protected:
+    PINDEX seqLast;
+};
+///////////////////////////////////////////////////////////////
+/*
+ * The ready modem with the oldest incoming call
+ */
+class PseudoModemPolicyLru : public PseudoModemPolicy
+{
+  public:
+    const char *Name() const { return "lru"; }
+
+    PseudoModem *Select(PseudoModem *first)
+    {
+      PseudoModem *selected = NULL;
+
+      for (PseudoModem *modem = first ; modem ; modem = Next(modem)) {
+        if (selected && Entry(selected).timeLastCall <= Entry(modem).timeLastCall)
+          continue;
+
+        if (modem->IsReady())
+          selected = modem;
+      }
+
+      return selected;
+    }
+};
+///////////////////////////////////////////////////////////////
+/*
+ * Smooth weighted round-robin by tty weights
+ */
+class PseudoModemPolicyWeighted : public PseudoModemPolicy
+{
+  public:
+    const char *Name() const { return "weight"; }
+
+    PseudoModem *Select(PseudoModem *first)
+    {
+      PseudoModem *selected = NULL;
+      int total = 0;
+
+      for (PseudoModem *modem = first ; modem ; modem = Next(modem)) {
+        if (!modem->IsReady())
+          continue;
+
+        PseudoModemQEntry &entry = Entry(modem);
+
+        entry.currentWeight += int(entry.weight);
+        total += int(entry.weight);
+
+        if (!selected || Entry(selected).currentWeight < entry.currentWeight)
+          selected = modem;
+      }
+
+      if (selected)
+        Entry(selected).currentWeight -= total;
+
+      return selected;
+    }
+};
+///////////////////////////////////////////////////////////////
+/*
+ * The ready modem with the least count of recent incoming calls
+ */
+class PseudoModemPolicyLeastLoaded : public PseudoModemPolicy
+{
+  public:
+    const char *Name() const { return "load"; }
+
+    PseudoModem *Select(PseudoModem *first)
+    {
+      PInt64 now = PTimer::Tick().GetMilliSeconds();
+      PseudoModem *selected = NULL;
+      double selectedCalls = 0;
+
+      for (PseudoModem *modem = first ; modem ; modem = Next(modem)) {
+        double calls = RecentCalls(modem, now);
+
+        if (selected && selectedCalls <= calls)
+          continue;
+
+        if (modem->IsReady()) {
+          selected = modem;
+          selectedCalls = calls;
+        }
+      }
+
+      return selected;
+    }
+};
+///////////////////////////////////////////////////////////////
+PseudoModemPolicy *PseudoModemPolicy::Create(const PString &name)
+{
+  if (name == "fifo")
+    return new PseudoModemPolicyFifo();
+
+  if (name == "rr")
+    return new PseudoModemPolicyRoundRobin();
+
+  if (name == "lru")
+    return new PseudoModemPolicyLru();
+
+  if (name == "weight")
+    return new PseudoModemPolicyWeighted();
+
+  if (name == "load")
+    return new PseudoModemPolicyLeastLoaded();
 
-  for (PINDEX i = 0 ; (object = GetAt(i)) != NULL ; i++) {
-    PAssert(PIsDescendant(object, PseudoModem), PInvalidCast);
-    PseudoModem *modem = (PseudoModem *)object;
-    if (modem->modemToken() == modemToken)
-      return modem;
-  }
   return NULL;
 }
 ///////////////////////////////////////////////////////////////
+/*
+ * Node of the route prefix trie.
+ *
+ * The children are linked by sibling pointers (a route prefix is
+ * usually a few digits so the sibling lists are short).
+ */
+class PseudoModemRouteNode
+{
+  public:
+    PseudoModemRouteNode(char _key)
+      : key(_key), child(NULL), sibling(NULL), first(NULL), last(NULL), policy(NULL) {}
+    ~PseudoModemRouteNode() { delete child; delete sibling; delete policy; }
+
+    PseudoModemRouteNode *Child(char _key, PBoolean create);
+
+    const char key;
+    PseudoModemRouteNode *child;
+    PseudoModemRouteNode *sibling;
+
+    PseudoModem *first;		// queued modems with the route of this node
+    PseudoModem *last;
+
+    PseudoModemPolicy *policy;	// NULL for the first ready modem
+};
+
+PseudoModemRouteNode *PseudoModemRouteNode::Child(char _key, PBoolean create)
+{
+  PseudoModemRouteNode **pp;
+
+  for (pp = &child ; *pp ; pp = &(*pp)->sibling) {
+    if ((*pp)->key == _key)
+      return *pp;
+  }
+
+  if (create)
+    *pp = new PseudoModemRouteNode(_key);
+
+  return *pp;
+}
+///////////////////////////////////////////////////////////////
 PObject::Comparison PseudoModem::Compare(const PObject & obj) const
 {
   PAssert(PIsDescendant(&obj, PseudoModem), PInvalidCast);
@@ -133,40 +388,124 @@ PObject::Comparison PseudoModem::Compare(const PObject & obj) const
 PseudoModemQ::PseudoModemQ()
 {
   pmodem_list = new PseudoModemList();
+  routeRoot = new PseudoModemRouteNode('\0');
 }
 
 PseudoModemQ::~PseudoModemQ()
 {
+  delete routeRoot;
   delete pmodem_list;
 }
 
 PBoolean PseudoModemQ::CreateModem(
-    const PString &tty,
-    const PString &route,
+    const PString &_tty,
+    const PString &_route,
     const PConfigArgs &args,
     const PNotifier &callbackEndPoint
 )
 {
+  PString tty = _tty;
+  unsigned weight = 1;
+  PINDEX i = tty.Find('*');
+
+  if (i != P_MAX_INDEX) {
+    weight = tty.Mid(i + 1).AsUnsigned();
+    tty = tty.Left(i);
+
+    if (!weight) {
+      myPTRACE(1, "PseudoModemQ::CreateModem bad weight in " << _tty);
+      return FALSE;
+    }
+  }
+
+  PString route = _route;
+  PseudoModemPolicy *policy = NULL;
+
+  i = route.Find(':');
+
+  if (i != P_MAX_INDEX) {
+    policy = PseudoModemPolicy::Create(route.Mid(i + 1));
+    route = route.Left(i);
+
+    if (!policy) {
+      myPTRACE(1, "PseudoModemQ::CreateModem bad policy in " << _route);
+      return FALSE;
+    }
+  }
+
   PseudoModem *modem = PseudoModemDrivers::CreateModem(tty, route, args, callbackEndPoint);
 
-  if (!modem)
+  if (!modem) {
+      delete policy;
       return FALSE;
+  }
+
+  i = pmodem_list->Append(modem);
 
-  if (pmodem_list->Append(modem) == P_MAX_INDEX)
+  if (i == P_MAX_INDEX) {
+      delete policy;
       return FALSE;
+  }
+
+  modem->qEntry.seq = i;
+  modem->qEntry.weight = weight;
+
+  if (policy) {
+    PWaitAndSignal mutexWait(Mutex);
+
+    PseudoModemRouteNode *node = GetNode(route);
+
+    if (node->policy && strcmp(node->policy->Name(), policy->Name()) != 0) {
+      myPTRACE(1, "PseudoModemQ::CreateModem policy " << node->policy->Name()
+                  << " for route '" << route << "' replaced by " << policy->Name());
+    }
+
+    delete node->policy;
+    node->policy = policy;
+  }
 
   modem->Resume();
 
   return TRUE;
 }
 
+PseudoModemRouteNode *PseudoModemQ::GetNode(const PString &route)
+{
+  PseudoModemRouteNode *node = routeRoot;
+
+  for (PINDEX i = 0 ; i < route.GetLength() ; i++)
+    node = node->Child(route[i], TRUE);
+
+  return node;
+}
+
 void PseudoModemQ::Enqueue(PseudoModem *modem)
 {
   myPTRACE((modem != NULL) ? 3 : 1, "PseudoModemQ::Enqueue "
     << ((modem != NULL) ? modem->ptyName() : "BAD"));
 
+  if (!modem)
+    return;
+
   PWaitAndSignal mutexWait(Mutex);
-  _PseudoModemQ::Enqueue(modem);
+
+  if (modem->qEntry.node) {
+    myPTRACE(1, "PseudoModemQ::Enqueue " << modem->ptyName() << " already in queue");
+    return;
+  }
+
+  PseudoModemRouteNode *node = GetNode(modem->routePrefix());
+
+  modem->qEntry.node = node;
+  modem->qEntry.next = NULL;
+  modem->qEntry.prev = node->last;
+
+  if (node->last)
+    node->last->qEntry.next = modem;
+  else
+    node->first = modem;
+
+  node->last = modem;
 }
 
 PBoolean PseudoModemQ::Enqueue(const PString &modemToken)
@@ -186,42 +525,79 @@ PBoolean PseudoModemQ::Enqueue(const PString &modemToken)
 PseudoModem *PseudoModemQ::DequeueWithRoute(const PString &number)
 {
   PWaitAndSignal mutexWait(Mutex);
-  PObject *object;
-  
-  for( PINDEX i = 0 ; (object = GetAt(i)) != NULL ; i++ ) {
-    PAssert(PIsDescendant(object, PseudoModem), PInvalidCast);
-    PseudoModem *modem = (PseudoModem *)object;
-    if (modem->CheckRoute(number) && modem->IsReady()) {
-      if (!Remove(modem))
-        modem = NULL;
-      myPTRACE(3, "PseudoModemQ::DequeueWithRoute "
-        << ((modem != NULL) ? modem->ptyName() : "BAD"));
-      return modem;
+
+  PseudoModem *modem = DequeueWithRoute(routeRoot, number, 0);
+
+  if (modem)
+    myPTRACE(3, "PseudoModemQ::DequeueWithRoute " << modem->ptyName());
+
+  return modem;
+}
+
+PseudoModem *PseudoModemQ::DequeueWithRoute(PseudoModemRouteNode *node, const PString &number, PINDEX depth)
+{
+  // try the longer route prefixes first
+
+  if (depth < number.GetLength()) {
+    PseudoModemRouteNode *child = node->Child(number[depth], FALSE);
+
+    if (child) {
+      PseudoModem *modem = DequeueWithRoute(child, number, depth + 1);
+
+      if (modem)
+        return modem;
     }
   }
-  return NULL;
+
+  if (!node->first)
+    return NULL;
+
+  static PseudoModemPolicyFifo policyDefault;
+
+  PseudoModem *modem = (node->policy ? node->policy : &policyDefault)->Select(node->first);
+
+  if (modem) {
+    Remove(modem);
+    PseudoModemPolicy::OnCall(modem, PTimer::Tick().GetMilliSeconds());
+  }
+
+  return modem;
+}
+
+void PseudoModemQ::Remove(PseudoModem *modem)
+{
+  PseudoModemRouteNode *node = modem->qEntry.node;
+
+  if (modem->qEntry.prev)
+    modem->qEntry.prev->qEntry.next = modem->qEntry.next;
+  else
+    node->first = modem->qEntry.next;
+
+  if (modem->qEntry.next)
+    modem->qEntry.next->qEntry.prev = modem->qEntry.prev;
+  else
+    node->last = modem->qEntry.prev;
+
+  modem->qEntry.node = NULL;
+  modem->qEntry.prev = modem->qEntry.next = NULL;
 }
 
 PseudoModem *PseudoModemQ::Find(const PString &modemToken) const
 {
-  PObject *object;
+  PseudoModem *modem = pmodem_list->Find(modemToken);
 
-  for( PINDEX i = 0 ; (object = GetAt(i)) != NULL ; i++ ) {
-    PAssert(PIsDescendant(object, PseudoModem), PInvalidCast);
-    PseudoModem *modem = (PseudoModem *)object;
-    if( modem->modemToken() == modemToken ) {
-      return modem;
-    }
-  }
-  return NULL;
+  if (modem != NULL && modem->qEntry.node == NULL)
+    return NULL;
+
+  return modem;
 }
 
 PseudoModem *PseudoModemQ::Dequeue(const PString &modemToken)
 {
   PWaitAndSignal mutexWait(Mutex);
   PseudoModem *modem = Find(modemToken);
-  if (modem != NULL && !Remove(modem))
-    modem = NULL;
+  if (modem != NULL)
+    Remove(modem);
   myPTRACE(1, "PseudoModemQ::Dequeue "
     << ((modem != NULL) ? modem->ptyName() : "BAD"));
   return modem;
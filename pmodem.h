@@ -75,6 +75,29 @@
 class T38Engine;
 class AudioEngine;
 class EngineBase;
+class PseudoModem;
+class PseudoModemRouteNode;
+
+/*
+ * Link and incoming call selection state of a modem in PseudoModemQ.
+ */
+class PseudoModemQEntry
+{
+  public:
+    PseudoModemQEntry()
+      : prev(NULL), next(NULL), node(NULL),
+        seq(0), weight(1), currentWeight(0), timeLastCall(0), recentCalls(0) {}
+
+    PseudoModem *prev;
+    PseudoModem *next;
+    PseudoModemRouteNode *node;	// not NULL if in queue
+
+    PINDEX seq;			// order of creation
+    unsigned weight;
+    int currentWeight;
+    PInt64 timeLastCall;	// ms
+    double recentCalls;		// decaying count of incoming calls
+};
 
 class PseudoModem : public ModemThread
 {
@@ -89,6 +112,7 @@ class PseudoModem : public ModemThread
   /**@name Operations */
     virtual PBoolean IsReady() const = 0;
     virtual PBoolean CheckRoute(const PString &number) const = 0;
+    virtual const PString &routePrefix() const = 0;
     virtual PBoolean Request(PStringToString &request) const = 0;
     virtual T38Engine *NewPtrT38Engine() const = 0;
     virtual AudioEngine *NewPtrAudioEngine() const = 0;
@@ -106,14 +130,28 @@ class PseudoModem : public ModemThread
     PString ttyname;
     PString ptyname;
     PBoolean valid;
+
+  private:
+    PseudoModemQEntry qEntry;
+
+    friend class PseudoModemQ;
+    friend class PseudoModemPolicy;
 };
 ///////////////////////////////////////////////////////////////
 class PseudoModemList;
-PQUEUE(_PseudoModemQ, PseudoModem);
 
-class PseudoModemQ : protected _PseudoModemQ
+/*
+ * Queue of modems ready to get incoming calls.
+ *
+ * The queued modems are kept in the lists of a trie by route
+ * prefix, so an incoming call is routed by longest prefix match
+ * of the called number. The ready modem in the list of the
+ * longest matched prefix is selected by the policy of the prefix
+ * (see PseudoModemPolicy), the default is the first ready one.
+ */
+class PseudoModemQ : public PObject
 {
-    PCLASSINFO(PseudoModemQ, _PseudoModemQ);
+    PCLASSINFO(PseudoModemQ, PObject);
   public:
   /**@name Construction */
   //@{
@@ -122,6 +160,10 @@ class PseudoModemQ : protected _PseudoModemQ
   //@}
 
   /**@name Operations */
+    /*
+     * The format of tty is tty[*weight] and
+     * the format of route is [num][:policy].
+     */
     PBoolean CreateModem(
       const PString &tty,
       const PString &route,
@@ -135,8 +177,12 @@ class PseudoModemQ : protected _PseudoModemQ
   //@}
   protected:
     PseudoModem *Find(const PString &modemToken) const;
+    PseudoModemRouteNode *GetNode(const PString &route);
+    PseudoModem *DequeueWithRoute(PseudoModemRouteNode *node, const PString &number, PINDEX depth);
+    void Remove(PseudoModem *modem);
 
     PseudoModemList *pmodem_list;
+    PseudoModemRouteNode *routeRoot;
     PMutex Mutex;
 };
 ///////////////////////////////////////////////////////////////
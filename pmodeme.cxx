@@ -400,10 +400,9 @@
 #include "fcs.h"
 #include "t38engine.h"
 #include "audio.h"
+#include "vcml.h"
 #include "version.h"
 
-///////////////////////////////////////////////////////////////
-#include "g711.c"
 ///////////////////////////////////////////////////////////////
 static const char Manufacturer[] = "Vyacheslav Frolov";
 static const char Model[] = "T38FAX";
@@ -1067,6 +1066,7 @@ class ModemEngineBody : public PObject
     PDTMFEncoder *pPlayTone;
 
     DLEData dleData;
+    VcmlCodec vcmlCodec;
     PINDEX dataCount;
     PBoolean moreFrames;
     FCS fcs;
@@ -3768,36 +3768,12 @@ void ModemEngineBody::HandleData(const PBYTEArray &buf, PBYTEArray &bresp)
                   dataCount += count;
                   if (P.ModemClassId() == EngineBase::mcAudio) {
                     if (currentClassEngine) {
-                      const signed char *pb = (const signed char *)Buf;
                       PInt16 Buf2[sizeof(Buf)];
-                      PInt16 *ps = Buf2;
-
-                      switch (P.Vcml()) {
-                        case 0:
-                          while (count--)
-                            *ps++ = (PInt16)((PInt16)(*pb++)*256);
-                          break;
-                        case 1:
-                        case 128:
-                        case 130:
-                          while (count--)
-                            *ps++ = (PInt16)((PInt16)(*pb++)*256 - 0x8000);
-                          break;
-                        case 4:
-                        case 131:
-                          while (count--)
-                            *ps++ = (PInt16)ulaw2linear(*pb++);
-                          break;
-                        case 5:
-                        case 132:
-                          while (count--)
-                            *ps++ = (PInt16)alaw2linear(*pb++);
-                          break;
-                      }
 
-                      count = int(pb - (const signed char *)Buf);
+                      vcmlCodec.Select(P.Vcml());
+                      count = vcmlCodec.Decode((const BYTE *)Buf, Buf2, count);
 
-                      currentClassEngine->Send(Buf2, count*sizeof(*ps));
+                      currentClassEngine->Send(Buf2, count*sizeof(Buf2[0]));
                     }
                   }
                   else
@@ -4368,35 +4344,8 @@ void ModemEngineBody::CheckState(PBYTEArray & bresp)
                   myPTRACE(1, "Unexpected dataType=" << dataType);
                 }
               } else {
-                const PInt16 *ps = (const PInt16 *)Buf;
-                signed char *pb = (signed char *)Buf;
-
-                count /= sizeof(*ps);
-
-                switch (P.Vcml()) {
-                  case 0:
-                    while (count--)
-                      *pb++ = (signed char)((*ps++)/256);
-                    break;
-                  case 1:
-                  case 128:
-                  case 130:
-                    while (count--)
-                      *pb++ = (signed char)((*ps++ + 0x8000)/256);
-                    break;
-                  case 4:
-                  case 131:
-                    while (count--)
-                      *pb++ = (signed char)linear2ulaw(*ps++);
-                    break;
-                  case 5:
-                  case 132:
-                    while (count--)
-                      *pb++ = (signed char)linear2alaw(*ps++);
-                    break;
-                }
-
-                count = int(pb - (signed char *)Buf);
+                vcmlCodec.Select(P.Vcml());
+                count = vcmlCodec.Encode((const PInt16 *)Buf, (BYTE *)Buf, count/sizeof(PInt16));
 
                 dleData.PutData(Buf, count);
               }
@@ -95,12 +95,46 @@
 #define new PNEW
 
 ///////////////////////////////////////////////////////////////
-PseudoModemBody::PseudoModemBody(const PString &_tty, const PString &_route, const PNotifier &_callbackEndPoint)
+PseudoModemBody::PseudoModemBody(
+    const PString &_tty,
+    const PString &_route,
+    const PConfigArgs &args,
+    const PNotifier &_callbackEndPoint)
   : PseudoModem(_tty),
     route(_route),
     callbackEndPoint(_callbackEndPoint),
-    engine(NULL)
+    engine(NULL),
+    ptyQHigh(1024*2),
+    ptyQLow(1024)
 {
+  if (args.HasOption("pty-queue")) {
+    // [tty=]high[:low][,...], the last matching value wins
+    PStringArray values = args.GetOptionString("pty-queue").Tokenise(",\r\n ", FALSE);
+
+    for (PINDEX i = 0 ; i < values.GetSize() ; i++) {
+      PString value = values[i];
+      PINDEX eq = value.Find('=');
+
+      if (eq != P_MAX_INDEX) {
+        if (value.Left(eq) != _tty)
+          continue;
+
+        value = value.Mid(eq + 1);
+      }
+
+      PINDEX high = value.AsInteger();
+      PINDEX colon = value.Find(':');
+      PINDEX low = colon != P_MAX_INDEX ? value.Mid(colon + 1).AsInteger() : high/2;
+
+      if (high <= 0 || low < 0 || low >= high) {
+        myPTRACE(1, "PseudoModemBody::PseudoModemBody bad pty-queue value " << values[i]);
+        continue;
+      }
+
+      ptyQHigh = high;
+      ptyQLow = low;
+    }
+  }
 }
 
 PseudoModemBody::~PseudoModemBody()
@@ -152,6 +186,60 @@ EngineBase *PseudoModemBody::NewPtrUserInputEngine() const
   return engine->NewPtrUserInputEngine();
 }
 
+PINDEX PseudoModemBody::InPtyQFree() const
+{
+  PINDEX busy = inPtyQ.GetCount();
+
+  return busy < ptyQHigh ? ptyQHigh - busy : 0;
+}
+
+PBoolean PseudoModemBody::PassToInPtyQ(PBYTEArray *buf)
+{
+  if (buf->GetSize() == 0) {
+    delete buf;
+    return TRUE;
+  }
+
+  if (inPtyQ.GetCount() >= ptyQHigh) {
+    /*
+     * Block till the consumer drains the queue to the low watermark
+     * (the timeout is only to check the stop request)
+     */
+    PTime timeBlocked;
+
+    while (inPtyQ.GetCount() > ptyQLow && !stop)
+      inPtyQDrained.Wait(1000);
+
+    PInt64 msBlocked = (PTime() - timeBlocked).GetMilliSeconds();
+
+    inPtyQBlocked.Add(msBlocked);
+
+    myPTRACE(3, "PseudoModemBody::PassToInPtyQ size=" << buf->GetSize() << " blocked=" << msBlocked << "ms");
+  }
+
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (engine == NULL) {
+    delete buf;
+    return FALSE;
+  }
+
+  inPtyQ.Enqueue(buf);
+  engine->SignalDataReady();
+  return TRUE;
+}
+
+PBoolean PseudoModemBody::SignalOutPtyQ()
+{
+  ModemThreadChild *notify = GetPtyNotifier();
+
+  if (notify == NULL)
+    return FALSE;
+
+  notify->SignalDataReady();
+  return TRUE;
+}
+
 void PseudoModemBody::ToPtyQ(const void *buf, PINDEX count, PBoolean OutQ)
 {
   if( count == 0 )
@@ -159,13 +247,11 @@ void PseudoModemBody::ToPtyQ(const void *buf, PINDEX count, PBoolean OutQ)
 
   PBYTEArrayQ &PtyQ = OutQ ? outPtyQ : inPtyQ;
 
-  for( int delay = 10 ;; delay *= 2 ) {
-    static const PINDEX MAX_qBUF = 1024*2;
-    static const int MAX_delay = ((MAX_qBUF/2)*8*1000)/14400;
+  for (;;) {
     PINDEX busy = PtyQ.GetCount();
 
-    if( busy < MAX_qBUF ) {
-      PINDEX free = MAX_qBUF - busy;
+    if( busy < ptyQHigh ) {
+      PINDEX free = ptyQHigh - busy;
       PINDEX len = count;
       if( len > free )
         len = free;
@@ -176,13 +262,22 @@ void PseudoModemBody::ToPtyQ(const void *buf, PINDEX count, PBoolean OutQ)
 
     {
       PWaitAndSignal mutexWait(Mutex);
-      ModemThreadChild *notify = OutQ ? GetPtyNotifier() : (ModemThreadChild *)engine;
-      if (notify == NULL) {
+      PBoolean notified;
+
+      if (OutQ) {
+        notified = SignalOutPtyQ();
+      } else if (engine != NULL) {
+        engine->SignalDataReady();
+        notified = TRUE;
+      } else {
+        notified = FALSE;
+      }
+
+      if (!notified) {
         myPTRACE(1, "PseudoModemBody::ToPtyQ notify == NULL");
         PtyQ.Clean();
         return;
       }
-      notify->SignalDataReady();
     }
     if( count == 0 )
       return;
@@ -190,16 +285,44 @@ void PseudoModemBody::ToPtyQ(const void *buf, PINDEX count, PBoolean OutQ)
     if (stop)
       break;
 
-    if (delay > MAX_delay) {
-      delay = MAX_delay;
-      myPTRACE(2, "PseudoModemBody::ToPtyQ(" << (OutQ ? "outPtyQ" : "inPtyQ") << ")"
-        << " busy=" << busy << " count=" << count << " delay=" << delay);
-    }
-    PThread::Sleep(delay);
+    /*
+     * Block till the consumer drains the queue to the low watermark
+     * (the timeout is only to check the stop request)
+     */
+    PSyncPoint &drained = OutQ ? outPtyQDrained : inPtyQDrained;
+    PTime timeBlocked;
+
+    while (PtyQ.GetCount() > ptyQLow && !stop)
+      drained.Wait(1000);
+
+    PInt64 msBlocked = (PTime() - timeBlocked).GetMilliSeconds();
+
+    (OutQ ? outPtyQBlocked : inPtyQBlocked).Add(msBlocked);
+
+    myPTRACE(3, "PseudoModemBody::ToPtyQ(" << (OutQ ? "outPtyQ" : "inPtyQ") << ")"
+        << " busy=" << busy << " count=" << count << " blocked=" << msBlocked << "ms");
+
     if( stop ) break;
   }
 }
 
+PBYTEArray *PseudoModemBody::FromPtyQ(PBoolean OutQ)
+{
+  PBYTEArrayQ &PtyQ = OutQ ? outPtyQ : inPtyQ;
+  PBYTEArray *buf = PtyQ.Dequeue();
+
+  if (buf && PtyQ.GetCount() <= ptyQLow) {
+    if (OutQ) {
+      outPtyQDrained.Signal();
+    } else {
+      inPtyQDrained.Signal();
+      SignalInPtyQDrained();
+    }
+  }
+
+  return buf;
+}
+
 PBoolean PseudoModemBody::StartAll()
 {
   if (engine)
@@ -224,7 +347,16 @@ void PseudoModemBody::StopAll()
   }
   outPtyQ.Clean();
   inPtyQ.Clean();
+  outPtyQDrained.Signal();
+  inPtyQDrained.Signal();
   childstop = FALSE;
+
+  PTRACE_IF(2, outPtyQBlocked.count || inPtyQBlocked.count,
+    "PseudoModemBody::StopAll " << ptyName() << " (high=" << ptyQHigh << " low=" << ptyQLow << ")"
+    " outPtyQ blocked " << outPtyQBlocked.count << " times for " << outPtyQBlocked.msTime << "ms"
+    " (max " << outPtyQBlocked.msTimeMax << "ms),"
+    " inPtyQ blocked " << inPtyQBlocked.count << " times for " << inPtyQBlocked.msTime << "ms"
+    " (max " << inPtyQBlocked.msTimeMax << "ms)");
 }
 
 PBoolean PseudoModemBody::AddModem() const
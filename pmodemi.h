@@ -78,18 +78,24 @@ class PseudoModemBody : public PseudoModem
 
   /**@name Construction */
   //@{
-    PseudoModemBody(const PString &_tty, const PString &_route, const PNotifier &_callbackEndPoint);
+    PseudoModemBody(
+      const PString &_tty,
+      const PString &_route,
+      const PConfigArgs &args,
+      const PNotifier &_callbackEndPoint
+    );
     ~PseudoModemBody();
   //@}
 
   /**@name Operations */
   //@{
-    PBYTEArray *FromInPtyQ() { return inPtyQ.Dequeue(); }
+    PBYTEArray *FromInPtyQ() { return FromPtyQ(FALSE); }
     void ToOutPtyQ(const void *buf, PINDEX count) { ToPtyQ(buf, count, TRUE); };
   //@}
 
     virtual PBoolean IsReady() const;
     PBoolean CheckRoute(const PString &number) const;
+    const PString &routePrefix() const { return route; }
     PBoolean Request(PStringToString &request) const;
     virtual T38Engine *NewPtrT38Engine() const;
     virtual AudioEngine *NewPtrAudioEngine() const;
@@ -100,20 +106,25 @@ class PseudoModemBody : public PseudoModem
   protected:
     virtual const PString &ttyPath() const = 0;
     virtual ModemThreadChild *GetPtyNotifier() = 0;
+    virtual PBoolean SignalOutPtyQ();
+    virtual void SignalInPtyQDrained() {}
     virtual PBoolean StartAll();
     virtual void StopAll();
     virtual void MainLoop() = 0;
 
     PBoolean AddModem() const;
-    PBYTEArray *FromOutPtyQ() { return outPtyQ.Dequeue(); }
+    PBYTEArray *FromOutPtyQ() { return FromPtyQ(TRUE); }
     void ToInPtyQ(PBYTEArray *buf) { inPtyQ.Enqueue(buf); }
+    PBoolean PassToInPtyQ(PBYTEArray *buf);
     void ToInPtyQ(const void *buf, PINDEX count) { ToPtyQ(buf, count, FALSE); };
+    PINDEX InPtyQFree() const;
 
     PMutex Mutex;
 
   private:
     void Main();
     void ToPtyQ(const void *buf, PINDEX count, PBoolean OutQ);
+    PBYTEArray *FromPtyQ(PBoolean OutQ);
 
     PString route;
     const PNotifier callbackEndPoint;
@@ -121,6 +132,19 @@ class PseudoModemBody : public PseudoModem
 
     PBYTEArrayQ outPtyQ;
     PBYTEArrayQ inPtyQ;
+
+    PINDEX ptyQHigh;			// producer blocks if reached
+    PINDEX ptyQLow;			// blocked producer resumes if reached
+    PSyncPoint outPtyQDrained;
+    PSyncPoint inPtyQDrained;
+
+    struct BlockedStat {
+      BlockedStat() : count(0), msTime(0), msTimeMax(0) {}
+      void Add(PInt64 ms) { count++; msTime += ms; if (msTimeMax < ms) msTimeMax = ms; }
+      unsigned count;
+      PInt64 msTime;
+      PInt64 msTimeMax;
+    } outPtyQBlocked, inPtyQBlocked;
 };
 ///////////////////////////////////////////////////////////////
 
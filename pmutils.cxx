@@ -119,6 +119,145 @@ void ModemThreadChild::SignalStop()
   parent.SignalChildStop();
 }
 ///////////////////////////////////////////////////////////////
+const FreeListPool *FreeListPool::firstPool = NULL;
+
+FreeListPool::FreeListPool(const char *_name, size_t _blockSize)
+  : name(_name)
+  , blockSize(_blockSize < sizeof(Block) ? sizeof(Block) : _blockSize)
+  , nextPool(firstPool)
+{
+  // the pools are static objects so they are linked before any thread starts
+  firstPool = this;
+}
+
+PINDEX FreeListPool::ShardIndex()
+{
+  unsigned long id = (unsigned long)PThread::GetCurrentThreadId();
+
+  // the low bits of the thread ids can be the same (aligned addresses)
+  id ^= id >> 12;
+  id ^= id >> 5;
+
+  return PINDEX(id % shardCount);
+}
+
+void *FreeListPool::Alloc(size_t size)
+{
+  if (size != blockSize)
+    return ::operator new(size);
+
+  PINDEX index = ShardIndex();
+  Shard &shard = shards[index];
+
+  {
+    PWaitAndSignal mutexWait(shard.mutex);
+
+    shard.countAlloc++;
+    shard.countUsed++;
+
+    Block *block = shard.freeBlocks;
+
+    if (block) {
+      shard.freeBlocks = block->next;
+      return block;
+    }
+  }
+
+  for (PINDEX i = 1 ; i < shardCount ; i++) {
+    Shard &other = shards[(index + i) % shardCount];
+    Block *blocks;
+
+    {
+      PWaitAndSignal mutexWait(other.mutex);
+
+      blocks = other.freeBlocks;
+      other.freeBlocks = NULL;
+    }
+
+    if (!blocks)
+      continue;
+
+    PWaitAndSignal mutexWait(shard.mutex);
+
+    shard.countMoved++;
+
+    if (!shard.freeBlocks) {
+      shard.freeBlocks = blocks->next;
+    }
+    else
+    if (blocks->next) {
+      // the shard was refilled by other threads meanwhile
+      Block *last = blocks->next;
+
+      while (last->next)
+        last = last->next;
+
+      last->next = shard.freeBlocks;
+      shard.freeBlocks = blocks->next;
+    }
+
+    return blocks;
+  }
+
+  {
+    PWaitAndSignal mutexWait(shard.mutex);
+
+    shard.countHeap++;
+  }
+
+  return ::operator new(blockSize);
+}
+
+void FreeListPool::Free(void *ptr, size_t size)
+{
+  if (!ptr)
+    return;
+
+  if (size != blockSize) {
+    ::operator delete(ptr);
+    return;
+  }
+
+  Shard &shard = shards[ShardIndex()];
+
+  PWaitAndSignal mutexWait(shard.mutex);
+
+  shard.countUsed--;
+
+  Block *block = (Block *)ptr;
+
+  block->next = shard.freeBlocks;
+  shard.freeBlocks = block;
+}
+
+void FreeListPool::PrintOn(ostream &strm) const
+{
+  unsigned long countAlloc = 0;
+  unsigned long countHeap = 0;
+  unsigned long countMoved = 0;
+  long countUsed = 0;
+
+  for (PINDEX i = 0 ; i < shardCount ; i++) {
+    const Shard &shard = shards[i];
+
+    PWaitAndSignal mutexWait(shard.mutex);
+
+    countAlloc += shard.countAlloc;
+    countHeap += shard.countHeap;
+    countMoved += shard.countMoved;
+    countUsed += shard.countUsed;
+  }
+
+  // the blocks are never returned to heap so heap is the peak of blocks in use
+  strm << name << " pool: block=" << blockSize
+       << " alloc=" << countAlloc
+       << " heap=" << countHeap
+       << " used=" << countUsed
+       << " moved=" << countMoved;
+}
+///////////////////////////////////////////////////////////////
+FreeListPool ChunkStream::pool("ChunkStream", sizeof(ChunkStream));
+
 int ChunkStream::write(const void *pBuf, PINDEX count)
 {
   int len = sizeof(data) - last;
@@ -151,6 +290,8 @@ int ChunkStream::read(void *pBuf, PINDEX count)
   return len;
 }
 ///////////////////////////////////////////////////////////////
+FreeListPool DataStream::pool("DataStream", sizeof(DataStream));
+
 int DataStream::PutData(const void *_pBuf, PINDEX count)
 {
   if (eof)
@@ -160,15 +301,14 @@ int DataStream::PutData(const void *_pBuf, PINDEX count)
   const BYTE *pBuf = (const BYTE *)_pBuf;
 
   while (count) {
-    if (!lastBuf) {
-      lastBuf = new ChunkStream();
-      bufQ.Enqueue(lastBuf);
-    }
+    if (!lastBuf)
+      firstBuf = lastBuf = new ChunkStream();
 
     int len = lastBuf->write(pBuf, count);
 
     if (len < 0) {
-      lastBuf = NULL;
+      lastBuf->next = new ChunkStream();
+      lastBuf = lastBuf->next;
     } else {
       pBuf += len;
       count -= len;
@@ -193,20 +333,18 @@ int DataStream::GetData(void *_pBuf, PINDEX count)
   int done = 0;
   BYTE *pBuf = (BYTE *)_pBuf;
 
-  while (count) {
-    if (!firstBuf) {
-      firstBuf = bufQ.Dequeue();
-      if (!firstBuf) {
-        lastBuf = NULL;
-        break;
-      }
-    }
-
+  while (count && firstBuf) {
     int len = firstBuf->read(pBuf, count);
 
     if (len < 0) {
-      delete firstBuf;
-      firstBuf = NULL;
+      ChunkStream *buf = firstBuf;
+
+      firstBuf = buf->next;
+
+      if (!firstBuf)
+        lastBuf = NULL;
+
+      delete buf;
     } else {
       if (!len)
         break;
@@ -223,17 +361,175 @@ int DataStream::GetData(void *_pBuf, PINDEX count)
 
 void DataStream::Clean()
 {
-  ChunkStream *buf;
-  while ((buf = bufQ.Dequeue()) != NULL)
+  while (firstBuf) {
+    ChunkStream *buf = firstBuf;
+    firstBuf = buf->next;
     delete buf;
-  if (firstBuf)
-    delete firstBuf;
-  firstBuf = lastBuf = NULL;
+  }
+  lastBuf = NULL;
   busy = 0;
   eof = FALSE;
   diag = 0;
 }
 ///////////////////////////////////////////////////////////////
+RingStream::RingStream(PINDEX size, PINDEX _threshold)
+  : DataStream(_threshold)
+  , head(0)
+  , tail(0)
+  , spillBusy(0)
+  , spilled(FALSE)
+{
+  unsigned capacity = 1;
+
+  while (capacity < unsigned(size))
+    capacity <<= 1;
+
+  data = new BYTE[capacity];
+  mask = capacity - 1;
+}
+
+RingStream::~RingStream()
+{
+  delete [] data;
+}
+
+int RingStream::PutData(const void *_pBuf, PINDEX count)
+{
+  if (eof)
+    return -1;
+
+  const BYTE *pBuf = (const BYTE *)_pBuf;
+
+  if (spilled) {
+    PWaitAndSignal mutexWait(spillMutex);
+
+    if (spilled) {
+      spillBusy += count;
+      return spill.PutData(pBuf, count);
+    }
+  }
+
+  unsigned h = head;
+
+  myMemoryBarrier();	// read tail before overwriting freed data
+
+  PINDEX room = PINDEX(mask + 1 - (h - tail));
+  PINDEX len = count < room ? count : room;
+
+  if (len > 0) {
+    PINDEX first = PINDEX(mask + 1 - (h & mask));
+
+    if (first > len)
+      first = len;
+
+    memcpy(data + (h & mask), pBuf, first);
+    memcpy(data, pBuf + first, len - first);
+
+    myMemoryBarrier();	// write data before moving head
+
+    head = h + len;
+  }
+
+  if (len < count) {
+    /*
+     * The consumer will take the spill after the ring is drained
+     */
+    PWaitAndSignal mutexWait(spillMutex);
+
+    myPTRACE(2, "RingStream::PutData overflow, spilled " << (count - len) << " bytes");
+    spill.PutData(pBuf + len, count - len);
+    spillBusy += count - len;
+    spilled = TRUE;
+  }
+
+  return count;
+}
+
+int RingStream::GetData(void *_pBuf, PINDEX count)
+{
+  PBoolean wasEof = eof;
+
+  myMemoryBarrier();	// read eof before head
+
+  unsigned t = tail;
+  PINDEX busy = PINDEX(head - t);
+
+  if (!busy && spilled) {
+    PWaitAndSignal mutexWait(spillMutex);
+
+    // the producer fills the ring before spilling
+    busy = PINDEX(head - t);
+
+    if (!busy) {
+      if (spillBusy) {
+        int len = spill.GetData(_pBuf, count);
+
+        if (len > 0)
+          spillBusy -= len;
+
+        return len;
+      }
+
+      /*
+       * The spill is drained, so the producer can use the ring again
+       * (it does not put to the ring while the spill is not empty, so
+       * the ring is still empty here)
+       */
+      spilled = FALSE;
+    }
+  }
+
+  if (!busy)
+    return wasEof ? -1 : 0;
+
+  if (count > busy)
+    count = busy;
+
+  if (count <= 0)
+    return 0;
+
+  myMemoryBarrier();	// read head before data
+
+  BYTE *pBuf = (BYTE *)_pBuf;
+  PINDEX first = PINDEX(mask + 1 - (t & mask));
+
+  if (first > count)
+    first = count;
+
+  memcpy(pBuf, data + (t & mask), first);
+  memcpy(pBuf + first, data, count - first);
+
+  myMemoryBarrier();	// read data before moving tail
+
+  tail = t + count;
+
+  return count;
+}
+
+void RingStream::PutEof()
+{
+  myMemoryBarrier();	// move head before eof
+
+  eof = TRUE;
+}
+
+PBoolean RingStream::isFull() const
+{
+  return threshold && (spilled || threshold < PINDEX(head - tail));
+}
+
+void RingStream::Clean()
+{
+  PWaitAndSignal mutexWait(spillMutex);
+
+  head = tail = 0;
+  eof = FALSE;
+  diag = 0;
+  spill.Clean();
+  spillBusy = 0;
+  spilled = FALSE;
+}
+///////////////////////////////////////////////////////////////
 #if PTRACING
 void RenameCurrentThread(const PString &newname)
 {
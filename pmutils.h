@@ -174,70 +174,218 @@ class PBYTEArrayQ : public _PBYTEArrayQ
     PMutex Mutex;
 };
 ///////////////////////////////////////////////////////////////
+/*
+ * Thread safe free list of fixed size memory blocks.
+ *
+ * The freed blocks are kept for reuse and never returned to heap,
+ * so after warming up the pooled objects are created and deleted
+ * without heap allocations.
+ *
+ * The free list is split to shards selected by the current thread,
+ * so the threads of different modems lock different mutexes. If the
+ * shard of the thread is empty (a producer allocates the blocks freed
+ * by a consumer thread) all free blocks of another shard are moved to
+ * it at once.
+ *
+ * All pools are linked to a list (see First() and Next()) so their
+ * statistics can be traced by any engine.
+ */
+class FreeListPool
+{
+  public:
+    FreeListPool(const char *_name, size_t _blockSize);
+
+    void *Alloc(size_t size);
+    void Free(void *ptr, size_t size);
+
+    void PrintOn(ostream &strm) const;
+
+    static const FreeListPool *First() { return firstPool; }
+    const FreeListPool *Next() const { return nextPool; }
+
+  protected:
+    struct Block { Block *next; };
+
+    enum { shardCount = 8 };
+
+    struct Shard {
+      Shard()
+        : freeBlocks(NULL)
+        , countAlloc(0)
+        , countHeap(0)
+        , countMoved(0)
+        , countUsed(0)
+      {}
+
+      Block *freeBlocks;
+      PMutex mutex;
+
+      unsigned long countAlloc;	// all allocations
+      unsigned long countHeap;	// allocations from heap
+      unsigned long countMoved;	// free lists moved from other shards
+      long countUsed;		// allocations minus frees (by this shard)
+    };
+
+    static PINDEX ShardIndex();
+
+    const char *name;
+    size_t blockSize;
+    Shard shards[shardCount];
+
+    const FreeListPool *nextPool;
+    static const FreeListPool *firstPool;
+};
+
+inline ostream & operator<<(ostream & strm, const FreeListPool & pool)
+{
+  pool.PrintOn(strm);
+  return strm;
+}
+
+/*
+ * Allocates objects of class cls from the pool cls::pool.
+ * Objects of derived classes with other sizes are allocated from heap.
+ */
+#if PMEMORY_CHECK
+  #define POOL_NEW_DELETE_MEMORY_CHECK(cls) \
+    void *operator new(size_t nSize, const char *, int) { return pool.Alloc(nSize); } \
+    void operator delete(void *ptr, const char *, int) { pool.Free(ptr, sizeof(cls)); }
+#else
+  #define POOL_NEW_DELETE_MEMORY_CHECK(cls)
+#endif
+
+#define POOL_NEW_DELETE(cls) \
+  public: \
+    static FreeListPool pool; \
+    void *operator new(size_t nSize) { return pool.Alloc(nSize); } \
+    void operator delete(void *ptr, size_t nSize) { pool.Free(ptr, nSize); } \
+    POOL_NEW_DELETE_MEMORY_CHECK(cls) \
+  private:
+///////////////////////////////////////////////////////////////
 class ChunkStream : public PObject
 {
     PCLASSINFO(ChunkStream, PObject);
+    POOL_NEW_DELETE(ChunkStream)
   public:
-    ChunkStream() : first(0), last(0) {}
+    ChunkStream() : next(NULL), first(0), last(0) {}
 
     int write(const void *pBuf, PINDEX count);
     int read(void *pBuf, PINDEX count);
 
+    ChunkStream *next;
+
   private:
     BYTE data[256];
     PINDEX first;
     PINDEX last;
 };
-
-PQUEUE(ChunkStreamQ, ChunkStream);
 ///////////////////////////////////////////////////////////////
 class DataStream : public PObject
 {
     PCLASSINFO(DataStream, PObject);
+    POOL_NEW_DELETE(DataStream)
   public:
     DataStream(PINDEX _threshold = 0)
-      : firstBuf(NULL), lastBuf(NULL), busy(0),
+      : firstBuf(NULL), lastBuf(NULL), busy(0), nextInQ(NULL),
         threshold(_threshold), eof(FALSE), diag(0) {}
     ~DataStream() { DataStream::Clean(); }
 
-    int PutData(const void *pBuf, PINDEX count);
-    int GetData(void *pBuf, PINDEX count);
-    void PutEof() { eof = TRUE; }
-    int GetDiag() const { return diag; }
-    DataStream &SetDiag(int _diag) { diag = _diag; return *this; }
-    PBoolean isFull() const { return threshold && threshold < busy; }
+    virtual int PutData(const void *pBuf, PINDEX count);
+    virtual int GetData(void *pBuf, PINDEX count);
+    virtual void PutEof() { eof = TRUE; }
+    virtual int GetDiag() const { return diag; }
+    virtual DataStream &SetDiag(int _diag) { diag = _diag; return *this; }
+    virtual PBoolean isFull() const { return threshold && threshold < busy; }
     virtual void Clean();
 
   private:
     ChunkStream *firstBuf;
-    ChunkStreamQ bufQ;
-    ChunkStream *lastBuf;	// if not NULL then it should be in bufQ or firstBuf
+    ChunkStream *lastBuf;	// if not NULL then it should be in firstBuf chain
     PINDEX busy;
 
+    DataStream *nextInQ;
+    friend class DataStreamQ;
+
+  protected:
     PINDEX threshold;
     PBoolean eof;
     int diag;
 };
 ///////////////////////////////////////////////////////////////
-PQUEUE(_DataStreamQ, DataStream);
+/*
+ * Fixed-capacity single producer / single consumer byte ring.
+ *
+ * PutData(), PutEof() and SetDiag() can be called by one thread
+ * while GetData() is called by another one without any locking.
+ * Clean() can be called only if the other side is not active.
+ *
+ * The capacity should cover the threshold plus the largest data
+ * chunk that can be put while isFull() is not checked. If the ring
+ * overflows, the rest of the data and all following data up to the
+ * moment the consumer drains it are put to the growable spill stream
+ * under spillMutex, so the data is never lost.
+ */
+class RingStream : public DataStream
+{
+    PCLASSINFO(RingStream, DataStream);
+  public:
+    RingStream(PINDEX size, PINDEX _threshold = 0);
+    ~RingStream();
 
-class DataStreamQ : public _DataStreamQ
+    virtual int PutData(const void *pBuf, PINDEX count);
+    virtual int GetData(void *pBuf, PINDEX count);
+    virtual void PutEof();
+    virtual PBoolean isFull() const;
+    virtual void Clean();
+
+  private:
+    RingStream(const RingStream &);
+    RingStream &operator=(const RingStream &);
+
+    BYTE *data;
+    unsigned mask;
+    volatile unsigned head;	// changed by producer only
+    volatile unsigned tail;	// changed by consumer only
+
+    DataStream spill;
+    PINDEX spillBusy;
+    volatile PBoolean spilled;	// set by producer and reset by consumer under spillMutex
+    PMutex spillMutex;
+};
+///////////////////////////////////////////////////////////////
+class DataStreamQ : public PObject
 {
-    PCLASSINFO(DataStreamQ, _DataStreamQ);
+    PCLASSINFO(DataStreamQ, PObject);
   public:
-    DataStreamQ() {}
+    DataStreamQ() : first(NULL), last(NULL), size(0) {}
     ~DataStreamQ() { Clean(); }
 
     virtual void Enqueue(DataStream *buf) {
       PWaitAndSignal mutexWait(Mutex);
-      _DataStreamQ::Enqueue(buf);
+      buf->nextInQ = NULL;
+      if (last)
+        last->nextInQ = buf;
+      else
+        first = buf;
+      last = buf;
+      size++;
     }
 
     virtual DataStream *Dequeue() {
       PWaitAndSignal mutexWait(Mutex);
-      return _DataStreamQ::Dequeue();
+      DataStream *buf = first;
+      if (buf) {
+        first = buf->nextInQ;
+        if (!first)
+          last = NULL;
+        buf->nextInQ = NULL;
+        size--;
+      }
+      return buf;
     }
 
+    PINDEX GetSize() const { return size; }
+
     void Clean() {
       DataStream *buf;
       while( (buf = Dequeue()) != NULL ) {
@@ -245,6 +393,9 @@ class DataStreamQ : public _DataStreamQ
       }
     }
   protected:
+    DataStream *first;
+    DataStream *last;
+    PINDEX size;
     PMutex Mutex;
 };
 ///////////////////////////////////////////////////////////////
@@ -276,6 +427,14 @@ class DataStreamQ : public _DataStreamQ
 #define myPTRACE(level, args) _myPTRACE(level, args)
 #endif // MYPTRACE_LEVEL
 
+#if defined(_MSC_VER)
+#define myMemoryBarrier() MemoryBarrier()
+#elif defined(__GNUC__)
+#define myMemoryBarrier() __sync_synchronize()
+#else
+#error "myMemoryBarrier() is not defined for this compiler"
+#endif
+
 #define PRTHEX(data) " {\n" << setprecision(2) << hex << setfill('0') << data << dec << setfill(' ') << " }"
 ///////////////////////////////////////////////////////////////
 #if PTRACING
@@ -67,26 +67,34 @@ typedef	PInt16                    SIMPLE_TYPE;
 #define BYTES_PER_SIMPLE          sizeof(SIMPLE_TYPE)
 #define SIMPLES_PER_SEC           8000
 ///////////////////////////////////////////////////////////////
-#define CNG_HZ                    1100
+#define BLOCK_MSEC                20
+#define BLOCK_LEN                 ((SIMPLES_PER_SEC*BLOCK_MSEC)/1000)
+///////////////////////////////////////////////////////////////
 #define CNG_ON_MSEC               500
 #define CNG_OFF_MSEC              3000
+#define CED_ON_MSEC               200
+#define V21_ON_MSEC               200
+#define TONE_GAP_MSEC             20          // ignored drop out (ANSam phase reversal)
 ///////////////////////////////////////////////////////////////
-#define CNG_FILTER_BUF_LEN ((((SIMPLES_PER_SEC + CNG_HZ - 1)/CNG_HZ + 1)/2)*2)
-
-#define tone_trace(cng_filter_buf, power, cng_power, cng_power_norm)
-#ifndef tone_trace
-static void tone_trace(const long *cng_filter_buf, long power, long cng_power, long cng_power_norm)
-{
-  PString str;
-
-  for (PINDEX i = 0 ; i < CNG_FILTER_BUF_LEN ; i++) {
-    str += PString(cng_filter_buf[i]);
-    str += " ";
-  }
-
-  myPTRACE(1, str << " pw=" << power << " cng_pw=" << cng_power << " norm=" << cng_power_norm);
-}
-#endif
+#define CNG_ON_BLOCKS_MIN         ((CNG_ON_MSEC*60)/(BLOCK_MSEC*100))
+#define CNG_ON_BLOCKS_MAX         ((CNG_ON_MSEC*140)/(BLOCK_MSEC*100))
+#define CNG_OFF_BLOCKS_MIN        ((CNG_OFF_MSEC*30)/(BLOCK_MSEC*100))
+#define CED_ON_BLOCKS             (CED_ON_MSEC/BLOCK_MSEC)
+#define V21_ON_BLOCKS             (V21_ON_MSEC/BLOCK_MSEC)
+#define TONE_GAP_BLOCKS           (TONE_GAP_MSEC/BLOCK_MSEC)
+///////////////////////////////////////////////////////////////
+#define MIN_POWER                 10000.0     // per simple (about -44 dBm0)
+///////////////////////////////////////////////////////////////
+/*
+ * Goertzel coefficients 2*cos(2*PI*hz/SIMPLES_PER_SEC) in the order
+ * of T30ToneDetect::toneXxx
+ */
+static const float coeffs[T30ToneDetect::numTones] = {
+  1.298896f,    // 1100 Hz - CNG
+  -0.156918f,   // 2100 Hz - CED, ANSam
+  0.542881f,    // 1650 Hz - V.21 ch2 mark
+  0.235075f,    // 1850 Hz - V.21 ch2 space
+};
 
 enum {
   cng_phase_off_head,
@@ -96,176 +104,171 @@ enum {
 
 T30ToneDetect::T30ToneDetect()
 {
-  cng_filter_buf = new long[CNG_FILTER_BUF_LEN];
-  memset(cng_filter_buf, 0, CNG_FILTER_BUF_LEN*sizeof(cng_filter_buf[0]));
+  for (PINDEX t = 0 ; t < numTones ; t++)
+    s1[t] = s2[t] = 0;
 
-  index = 0;
-  power = 0;
+  energy = 0;
+  count = 0;
 
   cng_on_count = 0;
   cng_off_count = 0;
   cng_phase = cng_phase_off_head;
-}
 
-T30ToneDetect::~T30ToneDetect()
-{
-  delete [] cng_filter_buf;
-}
+  ced_on_count = 0;
+  ced_off_count = 0;
 
-#define CNG_FILTER_CHUNK_LEN	20
-#define CNG_ON_CHUNKS_MIN	(((CNG_HZ*CNG_ON_MSEC)*60)/((CNG_FILTER_CHUNK_LEN*1000)*100))
-#define CNG_ON_CHUNKS_MAX	(((CNG_HZ*CNG_ON_MSEC)*140)/((CNG_FILTER_CHUNK_LEN*1000)*100))
-#define CNG_OFF_CHUNKS_MIN	(((CNG_HZ*CNG_OFF_MSEC)*30)/((CNG_FILTER_CHUNK_LEN*1000)*100))
+  v21_on_count = 0;
+  v21_off_count = 0;
+  v21_space_count = 0;
+}
 
-PBoolean T30ToneDetect::Write(const void * buffer, PINDEX len)
+PString T30ToneDetect::Write(const void * buffer, PINDEX len)
 {
-  PBoolean detected = FALSE;
+  PString events;
 
-  SIMPLE_TYPE *pBuf = (SIMPLE_TYPE *)buffer;
+  const SIMPLE_TYPE *pBuf = (const SIMPLE_TYPE *)buffer;
   len /= BYTES_PER_SIMPLE;
 
-  while (len) {
-    PINDEX iBuf = 0;
-
-    // filter CNG and calculate total power
-
-    PINDEX index0 = index;
+  while (len > 0) {
+    PINDEX lenBlock = BLOCK_LEN - count;
 
-    while (index < CNG_FILTER_BUF_LEN*CNG_FILTER_CHUNK_LEN) {
-      iBuf = ((index - index0)*SIMPLES_PER_SEC)/(CNG_FILTER_BUF_LEN*CNG_HZ);
+    if (lenBlock > len)
+      lenBlock = len;
 
-      if (iBuf >= len)
-        return detected;
+    // one pass of all filters over the samples
 
-      SIMPLE_TYPE pw = pBuf[iBuf];
+    for (PINDEX i = 0 ; i < lenBlock ; i++) {
+      float x = pBuf[i];
 
-      cng_filter_buf[index%CNG_FILTER_BUF_LEN] += pw;
+      energy += x*x;
 
-      if (pw < 0)
-        power -= pw;
-      else
-        power += pw;
+      for (PINDEX t = 0 ; t < numTones ; t++) {
+        float s = x + coeffs[t]*s1[t] - s2[t];
 
-      index++;
+        s2[t] = s1[t];
+        s1[t] = s;
+      }
     }
 
-    // calculate CNG power
+    pBuf += lenBlock;
+    len -= lenBlock;
+    count += lenBlock;
 
-    PINDEX i;
-    long cng_power_cur = 0;
+    if (count >= BLOCK_LEN)
+      OnBlock(events);
+  }
 
-    for (i = 0 ; i < CNG_FILTER_BUF_LEN/2 ; i++)
-      cng_power_cur += cng_filter_buf[i];
+  return events;
+}
 
-    for (; i < CNG_FILTER_BUF_LEN ; i++)
-      cng_power_cur -= cng_filter_buf[i];
+void T30ToneDetect::OnBlock(PString &events)
+{
+  // relative power of the tones (1.0 for the pure tone)
 
-    long cng_power;
+  float power[numTones];
 
-    if (cng_power_cur < 0)
-      cng_power = -cng_power_cur;
+  for (PINDEX t = 0 ; t < numTones ; t++) {
+    if (energy >= MIN_POWER*BLOCK_LEN)
+      power[t] = (s1[t]*s1[t] + s2[t]*s2[t] - coeffs[t]*s1[t]*s2[t])*2/(energy*BLOCK_LEN);
     else
-      cng_power = cng_power_cur;
-
-    for (i = 1 ; i < CNG_FILTER_BUF_LEN/2 ; i++) {
-      cng_power_cur -= cng_filter_buf[i]*2;
-      cng_power_cur += cng_filter_buf[i + CNG_FILTER_BUF_LEN/2]*2;
-
-      if (cng_power_cur < 0) {
-        if (cng_power < -cng_power_cur)
-          cng_power = -cng_power_cur;
-      } else {
-        if (cng_power < cng_power_cur)
-          cng_power = cng_power_cur;
-      }
-    }
+      power[t] = 0;
 
-    long cng_power_norm = cng_power * 1000;
+    s1[t] = s2[t] = 0;
+  }
 
-    if (power > 1)
-      cng_power_norm /= power;
+  energy = 0;
+  count = 0;
 
-    if (cng_on_count > 1)
-      cng_power_norm = (cng_power_norm*140)/100;
-    if (cng_off_count > 1)
-      cng_power_norm = (cng_power_norm*80)/100;
+  // CNG
 
-    if (cng_power_norm > 500) {
-      cng_on_count++;
+  if (power[toneCng] > (cng_on_count > 1 ? 0.35 : 0.5)) {
+    cng_on_count++;
 
-      switch (cng_phase) {
-        case cng_phase_off_head:
-          if (cng_off_count >= CNG_OFF_CHUNKS_MIN)
-            cng_phase = cng_phase_on;
-          else
-            cng_phase = cng_phase_off_head;
-          break;
+    switch (cng_phase) {
+      case cng_phase_off_head:
+        if (cng_off_count >= CNG_OFF_BLOCKS_MIN)
+          cng_phase = cng_phase_on;
+        break;
 
-        case cng_phase_on:
-          break;
+      case cng_phase_on:
+        break;
 
-        case cng_phase_off_tail:
-          cng_phase = cng_phase_off_head;
-          break;
+      default:
+        cng_phase = cng_phase_off_head;
+    }
 
-        default:
-          cng_phase = cng_phase_off_head;
-      }
+    if (cng_off_count) {
+      myPTRACE(2, "cng_off_count=" << cng_off_count);
+      cng_off_count = 0;
+    }
+  } else {
+    cng_off_count++;
 
-      if (cng_off_count) {
-        myPTRACE(2, "cng_off_count=" << cng_off_count);
-        cng_off_count = 0;
-      }
+    switch (cng_phase) {
+      case cng_phase_off_head:
+        break;
 
-      tone_trace(cng_filter_buf, power, cng_power, cng_power_norm);
-    } else {
-      cng_off_count++;
-
-      switch (cng_phase) {
-        case cng_phase_off_head:
-          break;
-
-        case cng_phase_on:
-          if (cng_on_count >= CNG_ON_CHUNKS_MIN && cng_on_count <= CNG_ON_CHUNKS_MAX)
-            cng_phase = cng_phase_off_tail;
-          else
-            cng_phase = cng_phase_off_head;
-          break;
-
-        case cng_phase_off_tail:
-          if (cng_off_count >= CNG_OFF_CHUNKS_MIN) {
-            myPTRACE(1, "Detected CNG");
-            cng_phase = cng_phase_off_head;
-            detected = TRUE;
-          }
-          break;
-
-        default:
+      case cng_phase_on:
+        if (cng_on_count >= CNG_ON_BLOCKS_MIN && cng_on_count <= CNG_ON_BLOCKS_MAX)
+          cng_phase = cng_phase_off_tail;
+        else
           cng_phase = cng_phase_off_head;
-      }
+        break;
 
-      if (cng_on_count) {
-        myPTRACE(2, "cng_on_count=" << cng_on_count);
-        tone_trace(cng_filter_buf, power, cng_power, cng_power_norm);
+      case cng_phase_off_tail:
+        if (cng_off_count >= CNG_OFF_BLOCKS_MIN) {
+          myPTRACE(1, "Detected CNG");
+          cng_phase = cng_phase_off_head;
+          events += 'c';
+        }
+        break;
 
-        cng_on_count = 0;
-      }
+      default:
+        cng_phase = cng_phase_off_head;
     }
 
-    // reatart filter
+    if (cng_on_count) {
+      myPTRACE(2, "cng_on_count=" << cng_on_count);
+      cng_on_count = 0;
+    }
+  }
+
+  // CED or ANSam
 
-    memset(cng_filter_buf, 0, CNG_FILTER_BUF_LEN*sizeof(cng_filter_buf[0]));
-    index = 0;
-    power = 0;
+  if (power[toneCed] > 0.5) {
+    if (ced_off_count > TONE_GAP_BLOCKS)
+      ced_on_count = 0;
 
-    // next chunk
+    ced_off_count = 0;
 
-    iBuf++;
-    pBuf += iBuf;
-    len -= iBuf;
+    if (ced_on_count < CED_ON_BLOCKS && ++ced_on_count == CED_ON_BLOCKS) {
+      myPTRACE(1, "Detected CED");
+      events += 'a';
+    }
+  } else {
+    ced_off_count++;
   }
 
-  return detected;
+  // V.21 preamble flags (six marks and two spaces per flag so
+  // some blocks can have marks only)
+
+  if (power[toneV21Mark] + power[toneV21Space] > 0.25) {
+    if (v21_off_count > TONE_GAP_BLOCKS)
+      v21_on_count = v21_space_count = 0;
+
+    v21_off_count = 0;
+
+    if (power[toneV21Space] > 0.02)
+      v21_space_count++;
+
+    if (v21_on_count < V21_ON_BLOCKS && ++v21_on_count == V21_ON_BLOCKS) {
+      if (v21_space_count >= V21_ON_BLOCKS/2) {
+        myPTRACE(1, "Detected V.21 flags");
+        events += 'F';
+      }
+    }
+  } else {
+    v21_off_count++;
+  }
 }
 ///////////////////////////////////////////////////////////////
-
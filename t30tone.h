@@ -51,25 +51,59 @@
 #define _T30TONE_H
 
 ///////////////////////////////////////////////////////////////
+/*
+ * Detector of the fax tones.
+ *
+ * It runs a bank of Goertzel filters over 20 ms blocks of the
+ * received 16-bit linear audio and reports the detected tones by
+ * the event characters:
+ *
+ *   'c' - CNG (1100 Hz with 0.5 s on / 3 s off cadence)
+ *   'a' - CED or ANSam (2100 Hz)
+ *   'F' - V.21 channel 2 preamble flags (1650/1850 Hz)
+ */
 class T30ToneDetect : public PObject
 {
   PCLASSINFO(T30ToneDetect, PObject);
 
   public:
 
+    enum {
+      toneCng,
+      toneCed,
+      toneV21Mark,
+      toneV21Space,
+      numTones
+    };
+
     T30ToneDetect();
-    ~T30ToneDetect();
 
-    PBoolean Write(const void * buffer, PINDEX len);
+    /*
+     * Returns the event characters of the tones detected in the
+     * buffer (empty if none)
+     */
+    PString Write(const void * buffer, PINDEX len);
 
   protected:
 
-    long *cng_filter_buf;
-    PINDEX index;
-    long power;
+    void OnBlock(PString &events);
+
+    // Goertzel filters state of the current block
+    float s1[numTones];
+    float s2[numTones];
+    float energy;
+    PINDEX count;
+
     int cng_on_count;
     int cng_off_count;
     int cng_phase;
+
+    int ced_on_count;
+    int ced_off_count;
+
+    int v21_on_count;
+    int v21_off_count;
+    int v21_space_count;
 };
 ///////////////////////////////////////////////////////////////
 
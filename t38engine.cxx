@@ -280,13 +280,6 @@
 #define T38I(t30_indicator) T38_Type_of_msg_t30_indicator::t30_indicator
 #define T38D(msg_data) T38_Type_of_msg_data::msg_data
 #define T38F(field_type) T38_Data_Field_subtype_field_type::field_type
-#define msMaxOutDelay (msPerOut*5)
-
-#ifdef P_LINUX
-  #define mySleep(ms) usleep((ms) * 1000L)
-#else
-  #define mySleep(ms) PThread::Sleep(ms)
-#endif
 ///////////////////////////////////////////////////////////////
 enum StateOut {
   stOutIdle,
@@ -315,8 +308,11 @@ enum StateModem {
 #define isStateModemOut() (stateModem >= stmOutMoreData && stateModem <= stmOutNoMoreData)
 #define isStateModemIn() (stateModem >= stmInWaitData && stateModem <= stmInRecvData)
 ///////////////////////////////////////////////////////////////
+#undef new
+
 class ModStream
 {
+    POOL_NEW_DELETE(ModStream)
   public:
     ModStream(const MODPARS &_ModPars);
     ~ModStream();
@@ -338,6 +334,10 @@ class ModStream
     HDLC hdlc;
 };
 
+#define new PNEW
+
+FreeListPool ModStream::pool("ModStream", sizeof(ModStream));
+
 ModStream::ModStream(const MODPARS &_ModPars) : firstBuf(NULL), lastBuf(NULL), ModPars(_ModPars)
 {
 }
@@ -468,27 +468,31 @@ void ModStream::Move(ModStream &from)
   from.lastBuf = NULL;
 }
 ///////////////////////////////////////////////////////////////
-MODPARS::MODPARS(int _val, unsigned _ind, int _lenInd, unsigned _msgType, int _br)
+MODPARS::MODPARS(int _val, unsigned _ind, int _lenInd, unsigned _msgType, int _br, int _msPerOut)
       : dataType(EngineBase::dtNone), dataTypeT38(EngineBase::dtNone),
         val(_val), ind(_ind), lenInd(_lenInd),
-        msgType(_msgType), br(_br)
+        msgType(_msgType), br(_br), msPerOut(_msPerOut)
 {
 }
 
+/*
+ * The packetization intervals selected by bitrate give about
+ * 36 bytes per packet for the high speed modulations
+ */
 static const MODPARS mods[] = {
-MODPARS(   3, T38I(e_v21_preamble),              900, T38D(e_v21),         300 ),
-MODPARS(  24, T38I(e_v27_2400_training),        1100, T38D(e_v27_2400),   2400 ),
-MODPARS(  48, T38I(e_v27_4800_training),         900, T38D(e_v27_4800),   4800 ),
-MODPARS(  72, T38I(e_v29_7200_training),         300, T38D(e_v29_7200),   7200 ),
-MODPARS(  73, T38I(e_v17_7200_long_training),   1500, T38D(e_v17_7200),   7200 ),
-MODPARS(  74, T38I(e_v17_7200_short_training),   300, T38D(e_v17_7200),   7200 ),
-MODPARS(  96, T38I(e_v29_9600_training),         300, T38D(e_v29_9600),   9600 ),
-MODPARS(  97, T38I(e_v17_9600_long_training),   1500, T38D(e_v17_9600),   9600 ),
-MODPARS(  98, T38I(e_v17_9600_short_training),   300, T38D(e_v17_9600),   9600 ),
-MODPARS( 121, T38I(e_v17_12000_long_training),  1500, T38D(e_v17_12000), 12000 ),
-MODPARS( 122, T38I(e_v17_12000_short_training),  300, T38D(e_v17_12000), 12000 ),
-MODPARS( 145, T38I(e_v17_14400_long_training),  1500, T38D(e_v17_14400), 14400 ),
-MODPARS( 146, T38I(e_v17_14400_short_training),  300, T38D(e_v17_14400), 14400 ),
+MODPARS(   3, T38I(e_v21_preamble),              900, T38D(e_v21),         300, 60 ),
+MODPARS(  24, T38I(e_v27_2400_training),        1100, T38D(e_v27_2400),   2400, 60 ),
+MODPARS(  48, T38I(e_v27_4800_training),         900, T38D(e_v27_4800),   4800, 60 ),
+MODPARS(  72, T38I(e_v29_7200_training),         300, T38D(e_v29_7200),   7200, 40 ),
+MODPARS(  73, T38I(e_v17_7200_long_training),   1500, T38D(e_v17_7200),   7200, 40 ),
+MODPARS(  74, T38I(e_v17_7200_short_training),   300, T38D(e_v17_7200),   7200, 40 ),
+MODPARS(  96, T38I(e_v29_9600_training),         300, T38D(e_v29_9600),   9600, 30 ),
+MODPARS(  97, T38I(e_v17_9600_long_training),   1500, T38D(e_v17_9600),   9600, 30 ),
+MODPARS(  98, T38I(e_v17_9600_short_training),   300, T38D(e_v17_9600),   9600, 30 ),
+MODPARS( 121, T38I(e_v17_12000_long_training),  1500, T38D(e_v17_12000), 12000, 20 ),
+MODPARS( 122, T38I(e_v17_12000_short_training),  300, T38D(e_v17_12000), 12000, 20 ),
+MODPARS( 145, T38I(e_v17_14400_long_training),  1500, T38D(e_v17_14400), 14400, 20 ),
+MODPARS( 146, T38I(e_v17_14400_short_training),  300, T38D(e_v17_14400), 14400, 20 ),
 };
 
 static const MODPARS invalidMods;
@@ -522,20 +526,15 @@ static void t38indicator(T38_IFP &ifp, unsigned type)
     (T38_Type_of_msg_t30_indicator &)ifp.m_type_of_msg = type;
 }
 
-#ifdef OPTIMIZE_CORRIGENDUM_IFP
-  #define T38_DATA_FIELD T38_Data_Field_subtype
-#else
-  #define T38_DATA_FIELD T38_PreCorrigendum_Data_Field_subtype
-#endif
-
 static T38_DATA_FIELD &t38data(T38_IFP &ifp, unsigned type, unsigned field_type)
 {
     ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_data);
     (T38_Type_of_msg_data &)ifp.m_type_of_msg = type;
 
     ifp.IncludeOptionalField(T38_IFPPacket::e_data_field);
-    ifp.m_data_field.SetSize(ifp.m_data_field.GetSize()+1);
-    T38_DATA_FIELD &Data_Field = ifp.m_data_field[0];
+    PINDEX count = ifp.m_data_field.GetSize();
+    ifp.m_data_field.SetSize(count + 1);
+    T38_DATA_FIELD &Data_Field = ifp.m_data_field[count];
     Data_Field.m_field_type = field_type;
     return Data_Field;
 }
@@ -549,6 +548,29 @@ static void t38data(T38_IFP &ifp, unsigned type, unsigned field_type, const PBYT
         Data_Field.m_field_data = data;
     }
 }
+
+/*
+ * Returns the upper bound of PER encoded size of ifp
+ */
+static PINDEX t38size(const T38_IFP &ifp)
+{
+    PINDEX size = 1;
+
+    if (ifp.HasOptionalField(T38_IFPPacket::e_data_field)) {
+      size++;
+
+      for (PINDEX i = 0 ; i < ifp.m_data_field.GetSize() ; i++) {
+        const T38_DATA_FIELD &Data_Field = ifp.m_data_field[i];
+
+        size++;
+
+        if (Data_Field.HasOptionalField(T38_Data_Field_subtype::e_field_data))
+          size += 2 + Data_Field.m_field_data.GetSize();
+      }
+    }
+
+    return size;
+}
 ///////////////////////////////////////////////////////////////
 class FakePreparePacketThread : public PThread
 {
@@ -609,10 +631,13 @@ void FakePreparePacketThread::Main()
 ///////////////////////////////////////////////////////////////
 T38Engine::T38Engine(const PString &_name)
   : EngineBase(_name + " T38Engine")
-  , bufOut(2048)
+  , bufOut(4096, 2048)
   , preparePacketTimeout(-1)
   , preparePacketPeriod(-1)
   , preparePacketDelay()
+  , maxDatagramOut(0)
+  , msPerOutMode(-1)
+  , msPerOut(msPerOutDefault)
   , stateOut(stOutNoSig)
   , onIdleOut(dtNone)
   , callbackParamOut(cbpReset)
@@ -658,6 +683,9 @@ void T38Engine::OnOpenIn()
 void T38Engine::OnOpenOut()
 {
   EngineBase::OnOpenOut();
+  maxDatagramOut = 0;
+  msPerOutMode = -1;
+  msPerOut = msPerOutDefault;
 }
 
 void T38Engine::OnCloseIn()
@@ -762,7 +790,6 @@ void T38Engine::OnResetModemState() {
 
 PBoolean T38Engine::isOutBufFull() const
 {
-  PWaitAndSignal mutexWait(Mutex);
   return bufOut.isFull();
 }
 ///////////////////////////////////////////////////////////////
@@ -845,7 +872,11 @@ int T38Engine::Send(const void *pBuf, PINDEX count)
     return -1;
   }
 
-  PWaitAndSignal mutexWait(Mutex);
+  /*
+   * bufOut is a single producer / single consumer ring and it's
+   * cleaned by consumer only if stateModem != stmOutMoreData,
+   * so there is no need to lock Mutex here
+   */
   int res = bufOut.PutData(pBuf, count);
   if (res < 0) {
     myPTRACE(1, name << " Send res(" << res << ") < 0");
@@ -1108,6 +1139,42 @@ void T38Engine::SetPreparePacketTimeout(HOWNEROUT hOwner, int timeout, int perio
     preparePacketDelay.Restart();
 }
 ///////////////////////////////////////////////////////////////
+void T38Engine::SetMsPerOut(HOWNEROUT hOwner, int ms)
+{
+  if (hOwnerOut != hOwner)
+    return;
+
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (hOwnerOut != hOwner)
+    return;
+
+  msPerOutMode = ms;
+
+  if (msPerOutMode > 0)
+    msPerOut = msPerOutMode;
+  else
+  if (msPerOutMode < 0)
+    msPerOut = msPerOutDefault;
+
+  myPTRACE(3, name << " SetMsPerOut " << msPerOutMode);
+}
+
+void T38Engine::SetMaxDatagram(HOWNEROUT hOwner, PINDEX maxDatagram)
+{
+  if (hOwnerOut != hOwner)
+    return;
+
+  PWaitAndSignal mutexWait(Mutex);
+
+  if (hOwnerOut != hOwner)
+    return;
+
+  maxDatagramOut = maxDatagram;
+
+  myPTRACE(3, name << " SetMaxDatagram " << maxDatagramOut);
+}
+///////////////////////////////////////////////////////////////
 int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
 {
   if (hOwnerOut != hOwner || !IsModemOpen())
@@ -1148,9 +1215,29 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
       return 0;
   }
 
+  /*
+   * The delays below are not polling but waiting for outDataReadySyncPoint
+   * with timeout, so any event that can change the output state (new data,
+   * closing, detaching, dropping carrier) wakes up this thread immediately.
+   * If wakeUpOnEvent is FALSE then the delay paces the data and it's
+   * continued up to timeDelayEndOut after the events.
+   */
+  PBoolean wakeUpOnEvent = FALSE;
+
+  /*
+   * If aggregate is TRUE then the last data field of the frame was
+   * added to ifp and the FCS and sig-end fields will be added to the
+   * same ifp without delay (if they fit maxDatagramOut).
+   */
+  PBoolean aggregate = FALSE;
+  PBoolean aggregated = FALSE;
+
   for(;;) {
     PBoolean redo = FALSE;
 
+    if (aggregate)
+      doDalay = FALSE;
+
     if (doDalay) {
       //PTRACE(1, name << " +++++ stM=" << stateModem << " stO=" << stateOut << " "
       //       << timeDelayEndOut.AsString("hh:mm:ss.uuu\t", PTime::Local));
@@ -1174,13 +1261,13 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
             delay = timeout;
         }
 
-        if (delay.GetMilliSeconds() > msMaxOutDelay)
-          delay = msMaxOutDelay;
-
-        mySleep(delay.GetMilliSeconds());
+        PBoolean event = WaitOutDataReady(delay);
 
         if (hOwnerOut != hOwner || !IsModemOpen())
           return 0;
+
+        if (event && wakeUpOnEvent)
+          break;
       }
     } else {
       doDalay = TRUE;
@@ -1293,6 +1380,12 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
               stateOut = stOutData;
               countOut = 0;
               startedTimeOutBufEmpty = FALSE;
+
+              if (msPerOutMode == 0) {
+                msPerOut = ModParsOut.msPerOut > 0 ? ModParsOut.msPerOut : int(msPerOutDefault);
+                myPTRACE(3, name << " PreparePacket msPerOut=" << msPerOut << " for br=" << ModParsOut.br);
+              }
+
               timeBeginOut = PTime();
               hdlcOut = HDLC();
               if (ModParsOut.msgType == T38D(e_v21))
@@ -1331,10 +1424,10 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
             ////////////////////////////////////////////////////
             case stOutData:
               {
-                BYTE b[(msPerOut * 14400)/(8*1000)];
                 PINDEX len = (msPerOut * ModParsOut.br)/(8*1000);
-                if (len > PINDEX(sizeof(b)))
-                  len = sizeof(b);
+                if (len < 1)
+                  len = 1;
+                BYTE *b = dataOut.GetPointer(len);
                 PBoolean wasFull = bufOut.isFull();
                 int count = hdlcOut.GetData(b, len);
                 if (wasFull && !bufOut.isFull()) {
@@ -1404,6 +1497,12 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
                         return 0;
                     }
                     countOut += count;
+
+                    if (maxDatagramOut > 0 && t38size(ifp) + 2 <= maxDatagramOut && hdlcOut.GetData(NULL, 0) == -1) {
+                      // the last data of the frame
+                      aggregate = TRUE;
+                      redo = TRUE;
+                    }
                 }
               }
               break;
@@ -1463,6 +1562,15 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
                   stateOut = stOutDataNoSig;
                 }
               }
+
+              if (aggregate) {
+                aggregated = TRUE;
+
+                if (stateOut == stOutDataNoSig && t38size(ifp) + 1 <= maxDatagramOut)
+                  redo = TRUE;
+                else
+                  aggregate = FALSE;
+              }
               break;
             ////////////////////////////////////////////////////
             case stOutDataNoSig:
@@ -1492,6 +1600,12 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
               }
               stateOut = stOutNoSig;
               stateModem = stmIdle;
+
+              if (aggregate) {
+                aggregated = TRUE;
+                aggregate = FALSE;
+              }
+
               ModemCallbackWithUnlock(callbackParamOut);
 
               if (hOwnerOut != hOwner || !IsModemOpen())
@@ -1570,8 +1684,18 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
       }
     }
 
+    wakeUpOnEvent = FALSE;
+
     switch (stateOut) {
-      case stOutIdle:          timeDelayEndOut = PTime() + msPerOut; break;
+      case stOutIdle:
+        if (redo && timeBeginOut > PTime()) {
+          // waiting for delayed signal or for dropping carrier
+          timeDelayEndOut = timeBeginOut;
+          wakeUpOnEvent = TRUE;
+        } else {
+          timeDelayEndOut = PTime() + msPerOut;
+        }
+        break;
       case stOutCedWait:       timeDelayEndOut = PTime() + ModParsOut.lenInd; break;
       case stOutSilenceWait:   timeDelayEndOut = PTime() + ModParsOut.lenInd; break;
       case stOutIndWait:       timeDelayEndOut = PTime() + ModParsOut.lenInd; break;
@@ -1580,7 +1704,17 @@ int T38Engine::PreparePacket(HOWNEROUT hOwner, T38_IFP & ifp)
         timeDelayEndOut = timeBeginOut + (PInt64(hdlcOut.getRawCount()) * 8 * 1000)/ModParsOut.br + msPerOut;
         break;
       case stOutDataNoSig:     timeDelayEndOut = PTime() + msPerOut; break;
-      case stOutNoSig:         timeDelayEndOut = PTime() + msPerOut; break;
+      case stOutNoSig:
+        timeDelayEndOut = PTime() + msPerOut;
+
+        if (aggregated && ModParsOut.br) {
+          // the sig-end was sent with the data, so wait for the end of the data
+          PTime timeEndData = timeBeginOut + (PInt64(hdlcOut.getRawCount()) * 8 * 1000)/ModParsOut.br + msPerOut;
+
+          if (timeDelayEndOut < timeEndData)
+            timeDelayEndOut = timeEndData;
+        }
+        break;
       default:                 timeDelayEndOut = PTime();
     }
 
@@ -1679,6 +1813,7 @@ PBoolean T38Engine::HandlePacket(HOWNERIN hOwner, const T38_IFP & ifp)
       switch (type_of_msg) {
         case T38I(e_no_signal):
           isCarrierIn = 0;
+          SignalOutDataReady();	// wake up the waiting for dropping carrier
 
           if (stateModem == stmInWaitSilence) {
             stateModem = stmIdle;
@@ -1691,6 +1826,7 @@ PBoolean T38Engine::HandlePacket(HOWNERIN hOwner, const T38_IFP & ifp)
         case T38I(e_ced):
           OnUserInput('a');
           isCarrierIn = 0;
+          SignalOutDataReady();
 
           if (stateModem == stmInWaitSilence) {
             stateModem = stmIdle;
@@ -1703,6 +1839,7 @@ PBoolean T38Engine::HandlePacket(HOWNERIN hOwner, const T38_IFP & ifp)
         case T38I(e_cng):
           OnUserInput('c');
           isCarrierIn = 0;
+          SignalOutDataReady();
 
           if (stateModem == stmInWaitSilence) {
             stateModem = stmIdle;
@@ -1850,6 +1987,7 @@ PBoolean T38Engine::HandlePacket(HOWNERIN hOwner, const T38_IFP & ifp)
                     }
 
                     isCarrierIn = 0;
+                    SignalOutDataReady();
 
                     if (stateModem == stmInWaitSilence) {
                       stateModem = stmIdle;
@@ -181,7 +181,8 @@ class MODPARS
           unsigned _ind = unsigned(-1),
           int _lenInd = -1,
           unsigned _msgType = unsigned(-1),
-          int _br = -1
+          int _br = -1,
+          int _msPerOut = -1
     );
 
     PBoolean IsModValid() const { return val >= 0; }
@@ -194,14 +195,19 @@ class MODPARS
     int lenInd;
     unsigned msgType;
     int br;
+    int msPerOut;		// packetization interval selected by bitrate
 };
 ///////////////////////////////////////////////////////////////
 #ifdef OPTIMIZE_CORRIGENDUM_IFP
-  #define T38_IFP       T38_IFPPacket
-  #define T38_IFP_NAME  "IFP"
+  #define T38_IFP                     T38_IFPPacket
+  #define T38_IFP_NAME                "IFP"
+  #define T38_DATA_FIELD              T38_Data_Field_subtype
+  #define T38_FIELD_TYPE_EXTENDABLE   TRUE
 #else
-  #define T38_IFP       T38_PreCorrigendum_IFPPacket
-  #define T38_IFP_NAME  "Pre-corrigendum IFP"
+  #define T38_IFP                     T38_PreCorrigendum_IFPPacket
+  #define T38_IFP_NAME                "Pre-corrigendum IFP"
+  #define T38_DATA_FIELD              T38_PreCorrigendum_Data_Field_subtype
+  #define T38_FIELD_TYPE_EXTENDABLE   FALSE
 #endif
 ///////////////////////////////////////////////////////////////
 class ModStream;
@@ -213,7 +219,7 @@ class T38Engine : public EngineBase
 
   public:
 
-    enum { msPerOut = 30 };
+    enum { msPerOutDefault = 30 };
 
   /**@name Construction */
   //@{
@@ -255,6 +261,30 @@ class T38Engine : public EngineBase
       int period = -1
     );
 
+    /**Set the packetization interval of outgoing T.38 data
+       (>0 - ms, 0 - selected by bitrate of modulation,
+       <0 - msPerOutDefault).
+       It's reset to msPerOutDefault by opening.
+      */
+    void SetMsPerOut(
+      HOWNEROUT hOwner,
+      int ms
+    );
+
+    /**Get the current packetization interval of outgoing T.38 data.
+      */
+    int GetMsPerOut() const { return msPerOut; }
+
+    /**Set the maximum size of outgoing T.38 packet for aggregation
+       of the last data field of a frame with the FCS and sig-end
+       fields in one IFP packet (0 - do not aggregate).
+       It's reset to 0 by opening.
+      */
+    void SetMaxDatagram(
+      HOWNEROUT hOwner,
+      PINDEX maxDatagram
+    );
+
     /**Handle incoming T.38 packet.
 
        If returns FALSE, then the reading loop should be terminated.
@@ -294,12 +324,16 @@ class T38Engine : public EngineBase
     }
 
   private:
-    DataStream bufOut;
+    RingStream bufOut;
 
     int preparePacketTimeout;
     int preparePacketPeriod;
 
     PAdaptiveDelay preparePacketDelay;
+    PINDEX maxDatagramOut;
+    int msPerOutMode;
+    int msPerOut;
+    PBYTEArray dataOut;
 
     int stateOut;
     DataType onIdleOut;
@@ -0,0 +1,247 @@
+/*
+ * t38modem.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef USE_OPAL
+  #include <opal/buildopts.h>
+#endif
+
+#include "version.h"
+#include "t38modem.h"
+#include "t38modem_api.h"
+#include "mediaclock.h"
+
+#ifdef USE_OPAL
+  #include "opal/manager.h"
+#else
+  #include "h323lib/h323ep.h"
+#endif
+
+#define new PNEW
+
+/////////////////////////////////////////////////////////////////////////////
+PString GetListOfLibs()
+{
+  return
+#ifdef USE_OPAL
+    PString("OPAL-")
+    + PString(OPAL_VERSION)
+    + PString("/")
+    + OpalGetVersion()
+#else
+  #if OPENH323_MAJOR < 1 || (OPENH323_MAJOR == 1 && OPENH323_MINOR <= 19)
+    PString("OpenH323-") + PString(OPENH323_VERSION)
+  #else
+    PString("H323plus-") + PString(OPENH323_VERSION)
+  #endif
+#endif
+#ifdef PTLIB_VERSION
+    + PString(", PTLIB-")
+    + PString(PTLIB_VERSION)
+  #if PTLIB_MAJOR > 2 || (PTLIB_MAJOR == 2 && PTLIB_MINOR >= 6)
+    + PString("/")
+    + PProcess::GetLibVersion()
+  #endif
+#endif
+#ifdef PWLIB_VERSION
+    + PString(", PWLIB-") + PString(PWLIB_VERSION)
+#endif
+  ;
+}
+
+PBoolean InitialiseT38Modem(PProcess &process)
+{
+  PConfigArgs args(process.GetArguments());
+
+  args.Parse(
+#ifdef USE_OPAL
+             MyManager::ArgSpec() +
+#else
+             MyH323EndPoint::ArgSpec() +
+#endif
+             "-media-clock:"
+             "h-help."
+             "v-version."
+#if PMEMORY_CHECK
+             "-setallocationbreakpoint:"
+#endif
+#if PTRACING
+             "t-trace."
+             "o-output:"
+#endif
+             "-save."
+          , FALSE);
+
+#if PMEMORY_CHECK
+  if (args.HasOption("setallocationbreakpoint"))
+    PMemoryHeap::SetAllocationBreakpoint(args.GetOptionString("setallocationbreakpoint").AsInteger());
+#endif
+
+#if PTRACING
+  PTrace::Initialise(args.GetOptionCount('t'),
+                     args.HasOption('o') ? (const char *)args.GetOptionString('o') : NULL,
+                     PTrace::DateAndTime | PTrace::Thread | PTrace::Blocks);
+#endif
+
+  if (args.HasOption('h')) {
+    cout <<
+        "Usage:\n"
+        "  " << process.GetName() << " [options]\n"
+        "\n"
+        "Options:\n"
+#if PTRACING
+        "  -t --trace                : Enable trace, use multiple times for more detail.\n"
+        "  -o --output file          : File for trace output, default is stderr.\n"
+#endif
+        "     --media-clock ms       : Pace the audio streams of all modems by one shared\n"
+        "                              media clock with ms milliseconds tick instead of\n"
+        "                              own timer of each stream.\n"
+        "     --save                 : Save arguments in configuration file and exit.\n"
+        "  -v --version              : Display version.\n"
+        "  -h --help                 : Display this help message.\n"
+        "\n";
+
+    PStringArray descriptions =
+#ifdef USE_OPAL
+        MyManager::Descriptions();
+#else
+        MyH323EndPoint::Descriptions();
+#endif
+
+    for (PINDEX i = 0 ; i < descriptions.GetSize() ; i++)
+      cout << descriptions[i] << endl;
+
+    return FALSE;
+  }
+
+  PStringArray info =
+#ifdef USE_OPAL
+      MyManager::Descriptions(args);
+#else
+      MyH323EndPoint::Descriptions(args);
+#endif
+
+  if (info.GetSize() > 0) {
+    for (PINDEX i = 0 ; i < info.GetSize() ; i++)
+      cout << info[i] << endl;
+
+    return FALSE;
+  }
+
+  if (args.HasOption('v'))
+    return FALSE;
+
+  if (args.HasOption("save")) {
+    args.Save("save");
+    cout << "Arguments were saved in configuration file" << endl;
+    return FALSE;
+  }
+
+  PTRACE(1, process.GetName()
+      << " Version " << process.GetVersion(TRUE)
+      << " (" << GetListOfLibs() << ")"
+      << " on " << process.GetOSClass() << " " << process.GetOSName()
+      << " (" << process.GetOSVersion() << '-' << process.GetOSHardware() << ")");
+
+#if PTRACING
+  if (PTrace::CanTrace(3)) {
+    PTRACE(3, "Options: " << args);
+
+    const PConfig config;
+    const PStringArray keys = config.GetKeys();
+
+    if (!keys.IsEmpty()) {
+      PTRACE(3, "Config:");
+      for (PINDEX iK = 0 ; iK < keys.GetSize() ; iK++) {
+        const PStringArray values = config.GetString(keys[iK]).Lines();
+
+        for (PINDEX iV = 0 ; iV < values.GetSize() ; iV++) {
+          PTRACE(3, "  --" << keys[iK] << "=" << values[iV]);
+        }
+      }
+    }
+  }
+#endif
+
+  if (args.HasOption("media-clock")) {
+    if (!MediaClock::Start(args.GetOptionString("media-clock").AsUnsigned())) {
+      cerr << "Can't start media clock" << endl;
+      return FALSE;
+    }
+  }
+
+#ifdef USE_OPAL
+  MyManager *manager = new MyManager();
+
+  if (!manager->Initialise(args))
+    return FALSE;
+#else
+  if (!MyH323EndPoint::Create(args))
+    return FALSE;
+#endif
+
+  return TRUE;
+}
+/////////////////////////////////////////////////////////////////////////////
+/*
+ * The process of the applications linked with libt38modem.a
+ */
+class T38ModemLibrary : public PLibraryProcess
+{
+  PCLASSINFO(T38ModemLibrary, PLibraryProcess)
+
+  public:
+    T38ModemLibrary()
+      : PLibraryProcess("Frolov,Holtschneider,Davidson", "T38Modem",
+                        MAJOR_VERSION, MINOR_VERSION, BUILD_TYPE, BUILD_NUMBER)
+    {
+    }
+};
+
+static PMutex libraryMutex;
+static T38ModemLibrary *libraryProcess = NULL;
+
+extern "C" {
+
+int t38modem_start(int argc, const char * const argv[])
+{
+  PWaitAndSignal mutexWait(libraryMutex);
+
+  if (libraryProcess != NULL)
+    return -1;
+
+  // never deleted, the endpoints and the modems live till exit
+  libraryProcess = new T38ModemLibrary();
+
+  if (argc > 1)
+    libraryProcess->GetArguments().SetArgs(argc - 1, (char **)argv + 1);
+
+  return InitialiseT38Modem(*libraryProcess) ? 0 : -1;
+}
+
+} // extern "C"
+/////////////////////////////////////////////////////////////////////////////
+
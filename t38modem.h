@@ -0,0 +1,54 @@
+/*
+ * t38modem.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Initialisation of t38modem shared by the t38modem program
+ * (main_process.cxx) and the applications linked with libt38modem.a
+ * (see t38modem_start() in t38modem_api.h).
+ */
+
+#ifndef _T38MODEM_H
+#define _T38MODEM_H
+
+///////////////////////////////////////////////////////////////
+/*
+ * Returns the versions of the used libraries
+ */
+PString GetListOfLibs();
+
+/*
+ * Parses the t38modem options from the arguments of process and
+ * creates the endpoints and the modems.
+ * Returns FALSE on error or if t38modem should not run (help,
+ * version, save).
+ *
+ * A PTLib application linked with libt38modem.a can call it with
+ * its own process instead of t38modem_start().
+ */
+PBoolean InitialiseT38Modem(PProcess &process);
+///////////////////////////////////////////////////////////////
+
+#endif  // _T38MODEM_H
+
@@ -0,0 +1,114 @@
+/*
+ * t38modem_api.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+/*
+ * Plain C interface of t38modem embedded in a fax application and
+ * of the in-process DTE (the modems created with the tty api:name,
+ * see drv_api.h).
+ *
+ * The application is linked with libt38modem.a (make lib) and the
+ * PTLib and OPAL (or H323) libraries, starts t38modem by
+ * t38modem_start() with the t38modem options (for example
+ * "--ptty api:fax0") and then finds its modems by t38modem_dte_find().
+ *
+ * The buffers are handed off without copying: the buffer passed to
+ * t38modem_dte_write() is owned by the modem and the buffer returned
+ * by t38modem_dte_read() is owned by the caller (should be freed by
+ * t38modem_buf_free()).
+ */
+
+#ifndef _T38MODEM_API_H
+#define _T38MODEM_API_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct t38modem_dte t38modem_dte;
+typedef struct t38modem_buf t38modem_buf;
+
+/*
+ * Starts t38modem in the calling process with the command line
+ * options argv[1] ... argv[argc - 1] of the t38modem program
+ * (argv[0] is ignored). The endpoints and the modems run in their
+ * own threads till the process exits.
+ * Returns 0 on success or -1 on error, for the help, version and
+ * save options, or if t38modem is already started.
+ *
+ * A PTLib application should call InitialiseT38Modem() (t38modem.h)
+ * with its own process instead.
+ */
+int t38modem_start(int argc, const char * const argv[]);
+
+/*
+ * Returns the modem created for the tty api:name or NULL
+ */
+t38modem_dte *t38modem_dte_find(const char *name);
+
+/*
+ * Allocates a buffer of size bytes and returns its data in *data
+ */
+t38modem_buf *t38modem_buf_alloc(int size, unsigned char **data);
+
+/*
+ * Returns the data of the buffer and its size in *size
+ */
+const unsigned char *t38modem_buf_data(const t38modem_buf *buf, int *size);
+
+void t38modem_buf_free(t38modem_buf *buf);
+
+/*
+ * Hands off the first size bytes of buf to the modem.
+ * Blocks while the modem queue is at the pty-queue high watermark
+ * till it's drained to the low one.
+ * Returns 0 on success or -1 if the modem is not started
+ * (buf is freed in both cases).
+ */
+int t38modem_dte_write(t38modem_dte *dte, t38modem_buf *buf, int size);
+
+/*
+ * Returns the number of bytes the modem can accept without blocking
+ * t38modem_dte_write()
+ */
+int t38modem_dte_write_free(t38modem_dte *dte);
+
+/*
+ * Returns the next buffer from the modem or NULL if there is no data
+ * within timeout_ms
+ */
+t38modem_buf *t38modem_dte_read(t38modem_dte *dte, int timeout_ms);
+
+/*
+ * Sets the function called by the modem engine thread when the data
+ * from the modem is ready to read (should not block)
+ */
+void t38modem_dte_set_notify(t38modem_dte *dte, void (*notify)(void *arg), void *arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* _T38MODEM_API_H */
+
@@ -0,0 +1,798 @@
+/*
+ * t38per.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#include <ptlib.h>
+
+#ifdef USE_OPAL
+  #include <opal/buildopts.h>
+  #include <asn/t38.h>
+#else
+  #include <t38.h>
+#endif
+
+#include "t38per.h"
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+/*
+ * The encoding rules are the same as of PPER_Stream (aligned).
+ */
+static unsigned CountBits(unsigned range)
+{
+  unsigned nBits = 0;
+
+  while (nBits < 32 && range > (1U << nBits))
+    nBits++;
+
+  return nBits;
+}
+///////////////////////////////////////////////////////////////
+class PerEncoder
+{
+  public:
+    PerEncoder(BYTE *_buf, PINDEX _size)
+      : buf(_buf), size(_size), pos(0), bit(8), ok(TRUE) {}
+
+    void Bits(unsigned value, unsigned nBits);
+    void Align() { if (bit != 8) { pos++; bit = 8; } }
+    void Unsigned(unsigned value, unsigned range);
+    void Length(unsigned len);
+    void Bytes(const BYTE *data, PINDEX len);
+    void Enumeration(unsigned value, unsigned maxValue, PBoolean extendable);
+    PINDEX Complete() { Align(); return ok ? pos : 0; }
+
+    void Fail() { ok = FALSE; }
+
+  protected:
+    BYTE *buf;
+    PINDEX size;
+    PINDEX pos;
+    unsigned bit;   // free bits in buf[pos]
+    PBoolean ok;
+};
+
+void PerEncoder::Bits(unsigned value, unsigned nBits)
+{
+  while (nBits) {
+    if (bit == 8) {
+      if (pos >= size) {
+        ok = FALSE;
+        return;
+      }
+      buf[pos] = 0;
+    }
+
+    unsigned n = nBits < bit ? nBits : bit;
+
+    nBits -= n;
+    bit -= n;
+    buf[pos] |= BYTE(((value >> nBits) & ((1U << n) - 1)) << bit);
+
+    if (!bit) {
+      pos++;
+      bit = 8;
+    }
+  }
+}
+
+void PerEncoder::Unsigned(unsigned value, unsigned range)
+{
+  if (range <= 1)
+    return;
+
+  unsigned nBits = CountBits(range);
+
+  if (range > 255) {
+    if (nBits > 16) {
+      ok = FALSE;
+      return;
+    }
+
+    nBits = nBits > 8 ? 16 : 8;
+    Align();
+  }
+
+  Bits(value, nBits);
+}
+
+void PerEncoder::Length(unsigned len)
+{
+  Align();
+
+  if (len < 0x80)
+    Bits(len, 8);
+  else
+  if (len < 0x4000)
+    Bits(0x8000 | len, 16);
+  else
+    ok = FALSE;     // fragmentation
+}
+
+void PerEncoder::Bytes(const BYTE *data, PINDEX len)
+{
+  Align();
+
+  if (len > size - pos) {
+    ok = FALSE;
+    return;
+  }
+
+  memcpy(buf + pos, data, len);
+  pos += len;
+}
+
+void PerEncoder::Enumeration(unsigned value, unsigned maxValue, PBoolean extendable)
+{
+  if (value > maxValue) {
+    ok = FALSE;     // extension
+    return;
+  }
+
+  if (extendable)
+    Bits(0, 1);
+
+  Unsigned(value, maxValue + 1);
+}
+///////////////////////////////////////////////////////////////
+class PerDecoder
+{
+  public:
+    PerDecoder(const BYTE *_buf, PINDEX _size)
+      : buf(_buf), size(_size), pos(0), bit(8), ok(TRUE) {}
+
+    unsigned Bits(unsigned nBits);
+    void Align() { if (bit != 8) { pos++; bit = 8; } }
+    unsigned Unsigned(unsigned range);
+    unsigned Length();
+    const BYTE *Bytes(PINDEX len);
+    unsigned Enumeration(unsigned maxValue, PBoolean extendable);
+    PINDEX Remaining() const { return pos < size ? size - pos : 0; }
+
+    void Fail() { ok = FALSE; }
+    PBoolean IsOK() const { return ok; }
+
+  protected:
+    const BYTE *buf;
+    PINDEX size;
+    PINDEX pos;
+    unsigned bit;   // not read bits in buf[pos]
+    PBoolean ok;
+};
+
+unsigned PerDecoder::Bits(unsigned nBits)
+{
+  unsigned value = 0;
+
+  while (nBits) {
+    if (pos >= size) {
+      ok = FALSE;
+      return 0;
+    }
+
+    unsigned n = nBits < bit ? nBits : bit;
+
+    nBits -= n;
+    bit -= n;
+    value = (value << n) | ((buf[pos] >> bit) & ((1U << n) - 1));
+
+    if (!bit) {
+      pos++;
+      bit = 8;
+    }
+  }
+
+  return value;
+}
+
+unsigned PerDecoder::Unsigned(unsigned range)
+{
+  if (range <= 1)
+    return 0;
+
+  unsigned nBits = CountBits(range);
+
+  if (range > 255) {
+    if (nBits > 16) {
+      ok = FALSE;
+      return 0;
+    }
+
+    nBits = nBits > 8 ? 16 : 8;
+    Align();
+  }
+
+  return Bits(nBits);
+}
+
+unsigned PerDecoder::Length()
+{
+  Align();
+
+  unsigned len = Bits(8);
+
+  if (len & 0x80) {
+    if (len & 0x40) {
+      ok = FALSE;   // fragmentation
+      return 0;
+    }
+
+    len = ((len & 0x3F) << 8) | Bits(8);
+  }
+
+  return len;
+}
+
+const BYTE *PerDecoder::Bytes(PINDEX len)
+{
+  Align();
+
+  if (!ok || len > Remaining()) {
+    ok = FALSE;
+    return NULL;
+  }
+
+  const BYTE *data = buf + pos;
+
+  pos += len;
+
+  return data;
+}
+
+unsigned PerDecoder::Enumeration(unsigned maxValue, PBoolean extendable)
+{
+  if (extendable && Bits(1)) {
+    ok = FALSE;     // extension
+    return 0;
+  }
+
+  unsigned value = Unsigned(maxValue + 1);
+
+  if (value > maxValue)
+    ok = FALSE;
+
+  return value;
+}
+///////////////////////////////////////////////////////////////
+static PINDEX EncodeIFPPacket(
+    const T38_IFP &ifp,
+    BYTE *buf,
+    PINDEX size,
+    PBoolean fieldTypeExtendable)
+{
+  PerEncoder strm(buf, size);
+
+  if (ifp.IsExtendable())
+    strm.Bits(0, 1);
+
+  PBoolean hasDataField = ifp.HasOptionalField(T38_IFPPacket::e_data_field);
+
+  strm.Bits(hasDataField, 1);
+
+  unsigned tag = ifp.m_type_of_msg.GetTag();
+
+  if (tag > T38_Type_of_msg::e_data)
+    return 0;
+
+  if (ifp.m_type_of_msg.IsExtendable())
+    strm.Bits(0, 1);
+
+  strm.Bits(tag, 1);
+
+  const PASN_Enumeration &type = (const PASN_Enumeration &)ifp.m_type_of_msg.GetObject();
+
+  strm.Enumeration(type.GetValue(), type.GetMaximum(), type.IsExtendable());
+
+  if (hasDataField) {
+    PINDEX count = ifp.m_data_field.GetSize();
+
+    strm.Length(count);
+
+    for (PINDEX i = 0 ; i < count ; i++) {
+      const T38_DATA_FIELD &field = ifp.m_data_field[i];
+
+      if (field.IsExtendable())
+        strm.Bits(0, 1);
+
+      PBoolean hasFieldData = field.HasOptionalField(T38_Data_Field_subtype::e_field_data);
+
+      strm.Bits(hasFieldData, 1);
+      strm.Enumeration(field.m_field_type.GetValue(), field.m_field_type.GetMaximum(), fieldTypeExtendable);
+
+      if (hasFieldData) {
+        PINDEX len = field.m_field_data.GetSize();
+
+        if (len < 1 || len > 65535)
+          return 0;
+
+        strm.Unsigned(len - 1, 65535);
+        strm.Bytes(field.m_field_data, len);
+      }
+    }
+  }
+
+  return strm.Complete();
+}
+///////////////////////////////////////////////////////////////
+/*
+ * Pre-encoded indicator packets and data packets with one data
+ * field without data (e.g. hdlc-fcs-OK or t4-non-ecm-sig-end).
+ */
+class T38PerCache
+{
+  public:
+    static const T38PerCache &Get();
+
+    PINDEX Copy(
+      const T38_IFP &ifp,
+      BYTE *buf,
+      PINDEX size,
+      PBoolean fieldTypeExtendable
+    ) const;
+
+  protected:
+    T38PerCache();
+
+    enum {
+      maxIndicators = 32,
+      maxDataTypes = 16,
+      maxFieldTypes = 8,
+      maxLen = 4
+    };
+
+    struct Entry {
+      PINDEX len;
+      BYTE data[maxLen];
+    };
+
+    Entry indicators[maxIndicators];
+    Entry data[2][maxDataTypes][maxFieldTypes];
+};
+
+const T38PerCache &T38PerCache::Get()
+{
+  static PMutex mutex;
+  static T38PerCache * volatile cache = NULL;
+
+  T38PerCache *c = cache;
+
+  // don't read the tables before the pointer
+  myMemoryBarrier();
+
+  if (!c) {
+    PWaitAndSignal mutexWait(mutex);
+
+    c = cache;
+
+    if (!c) {
+      c = new T38PerCache();
+
+      // publish the pointer after the tables are written
+      myMemoryBarrier();
+      cache = c;
+    }
+  }
+
+  return *c;
+}
+
+T38PerCache::T38PerCache()
+{
+  T38_IFP ifp;
+
+  ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_t30_indicator);
+
+  PASN_Enumeration &indicator = (PASN_Enumeration &)ifp.m_type_of_msg.GetObject();
+
+  for (unsigned i = 0 ; i < maxIndicators ; i++) {
+    indicator.SetValue(i);
+    indicators[i].len = EncodeIFPPacket(ifp, indicators[i].data, maxLen, FALSE);
+  }
+
+  ifp.m_type_of_msg.SetTag(T38_Type_of_msg::e_data);
+  ifp.IncludeOptionalField(T38_IFPPacket::e_data_field);
+  ifp.m_data_field.SetSize(1);
+
+  PASN_Enumeration &type = (PASN_Enumeration &)ifp.m_type_of_msg.GetObject();
+  T38_DATA_FIELD &field = ifp.m_data_field[0];
+
+  for (unsigned e = 0 ; e < 2 ; e++) {
+    for (unsigned t = 0 ; t < maxDataTypes ; t++) {
+      type.SetValue(t);
+
+      for (unsigned f = 0 ; f < maxFieldTypes ; f++) {
+        field.m_field_type.SetValue(f);
+        data[e][t][f].len = EncodeIFPPacket(ifp, data[e][t][f].data, maxLen, e != 0);
+      }
+    }
+  }
+}
+
+PINDEX T38PerCache::Copy(
+    const T38_IFP &ifp,
+    BYTE *buf,
+    PINDEX size,
+    PBoolean fieldTypeExtendable) const
+{
+  const Entry *entry;
+  unsigned tag = ifp.m_type_of_msg.GetTag();
+
+  if (tag > T38_Type_of_msg::e_data)
+    return 0;
+
+  unsigned value = ((const PASN_Enumeration &)ifp.m_type_of_msg.GetObject()).GetValue();
+  PBoolean hasDataField = ifp.HasOptionalField(T38_IFPPacket::e_data_field);
+
+  if (tag == T38_Type_of_msg::e_t30_indicator) {
+    if (hasDataField || value >= maxIndicators)
+      return 0;
+
+    entry = &indicators[value];
+  } else {
+    if (!hasDataField || ifp.m_data_field.GetSize() != 1 || value >= maxDataTypes)
+      return 0;
+
+    const T38_DATA_FIELD &field = ifp.m_data_field[0];
+    unsigned fieldType = field.m_field_type.GetValue();
+
+    if (field.HasOptionalField(T38_Data_Field_subtype::e_field_data) || fieldType >= maxFieldTypes)
+      return 0;
+
+    entry = &data[fieldTypeExtendable ? 1 : 0][value][fieldType];
+  }
+
+  if (!entry->len || entry->len > size)
+    return 0;
+
+  memcpy(buf, entry->data, entry->len);
+
+  return entry->len;
+}
+///////////////////////////////////////////////////////////////
+PINDEX T38Per::EncodeIFP(
+    const T38_IFP &ifp,
+    BYTE *buf,
+    PINDEX size,
+    PBoolean fieldTypeExtendable)
+{
+  PINDEX len = T38PerCache::Get().Copy(ifp, buf, size, fieldTypeExtendable);
+
+  if (len)
+    return len;
+
+  return EncodeIFPPacket(ifp, buf, size, fieldTypeExtendable);
+}
+
+PBoolean T38Per::DecodeIFP(
+    const BYTE *buf,
+    PINDEX size,
+    T38_IFP &ifp,
+    PBoolean fieldTypeExtendable)
+{
+  PerDecoder strm(buf, size);
+
+  if (ifp.IsExtendable() && strm.Bits(1))
+    return FALSE;
+
+  PBoolean hasDataField = strm.Bits(1);
+
+  if (ifp.m_type_of_msg.IsExtendable() && strm.Bits(1))
+    return FALSE;
+
+  unsigned tag = strm.Bits(1);
+
+  if (!strm.IsOK())
+    return FALSE;
+
+  if (ifp.m_type_of_msg.GetTag() != tag)
+    ifp.m_type_of_msg.SetTag(tag);
+
+  PASN_Enumeration &type = (PASN_Enumeration &)ifp.m_type_of_msg.GetObject();
+
+  type.SetValue(strm.Enumeration(type.GetMaximum(), type.IsExtendable()));
+
+  if (!hasDataField) {
+    ifp.RemoveOptionalField(T38_IFPPacket::e_data_field);
+    return strm.IsOK();
+  }
+
+  ifp.IncludeOptionalField(T38_IFPPacket::e_data_field);
+
+  PINDEX count = strm.Length();
+
+  // each data field takes 4 bits at least
+  if (!strm.IsOK() || count > strm.Remaining()*2)
+    return FALSE;
+
+  ifp.m_data_field.SetSize(count);
+
+  for (PINDEX i = 0 ; i < count ; i++) {
+    T38_DATA_FIELD &field = ifp.m_data_field[i];
+
+    if (field.IsExtendable() && strm.Bits(1))
+      return FALSE;
+
+    PBoolean hasFieldData = strm.Bits(1);
+
+    field.m_field_type.SetValue(strm.Enumeration(field.m_field_type.GetMaximum(), fieldTypeExtendable));
+
+    if (hasFieldData) {
+      PINDEX len = strm.Unsigned(65535) + 1;
+      const BYTE *data = strm.Bytes(len);
+
+      if (!data)
+        return FALSE;
+
+      field.IncludeOptionalField(T38_Data_Field_subtype::e_field_data);
+      field.m_field_data.SetValue(data, len);
+    } else {
+      field.RemoveOptionalField(T38_Data_Field_subtype::e_field_data);
+    }
+
+    if (!strm.IsOK())
+      return FALSE;
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+PINDEX T38Per::EncodeUDPTL(
+    const T38PerUDPTL &udptl,
+    BYTE *buf,
+    PINDEX size)
+{
+  PerEncoder strm(buf, size);
+
+  strm.Unsigned(udptl.seq & 0xFFFF, 65536);
+  strm.Length(udptl.primarySize);
+  strm.Bytes(udptl.primary, udptl.primarySize);
+  strm.Bits(udptl.recovery, 1);
+
+  if (udptl.recovery == T38PerUDPTL::e_fec_info) {
+    // fec-npackets is INTEGER (unconstrained)
+    if (udptl.fecNPackets < 0)
+      return 0;
+
+    unsigned nBytes = CountBits(udptl.fecNPackets + 1)/8 + 1;
+
+    strm.Length(nBytes);
+    strm.Bits(udptl.fecNPackets, nBytes*8);
+  }
+
+  if (udptl.count > T38PerUDPTL::maxEntries)
+    return 0;
+
+  strm.Length(udptl.count);
+
+  for (PINDEX i = 0 ; i < udptl.count ; i++) {
+    strm.Length(udptl.entrySize[i]);
+    strm.Bytes(udptl.entry[i], udptl.entrySize[i]);
+  }
+
+  return strm.Complete();
+}
+
+PBoolean T38Per::DecodeUDPTL(
+    const BYTE *buf,
+    PINDEX size,
+    T38PerUDPTL &udptl)
+{
+  PerDecoder strm(buf, size);
+
+  udptl.seq = strm.Unsigned(65536);
+  udptl.primarySize = strm.Length();
+  udptl.primary = strm.Bytes(udptl.primarySize);
+  udptl.recovery = strm.Bits(1);
+  udptl.fecNPackets = 0;
+
+  if (udptl.recovery == T38PerUDPTL::e_fec_info) {
+    unsigned nBytes = strm.Length();
+
+    if (nBytes < 1 || nBytes > 4)
+      return FALSE;
+
+    unsigned value = strm.Bits(nBytes*8);
+
+    // sign extension
+    if (nBytes < 4 && (value & (1U << (nBytes*8 - 1))))
+      value |= ~0U << (nBytes*8);
+
+    udptl.fecNPackets = int(value);
+  }
+
+  PINDEX count = strm.Length();
+
+  // each entry takes 1 byte at least
+  if (!strm.IsOK() || count > strm.Remaining())
+    return FALSE;
+
+  udptl.count = 0;
+
+  for (PINDEX i = 0 ; i < count ; i++) {
+    PINDEX len = strm.Length();
+    const BYTE *data = strm.Bytes(len);
+
+    if (!data)
+      return FALSE;
+
+    if (udptl.count < T38PerUDPTL::maxEntries) {
+      udptl.entry[udptl.count] = data;
+      udptl.entrySize[udptl.count] = len;
+      udptl.count++;
+    }
+  }
+
+  // the truncated FEC data can't be used
+  if (udptl.recovery == T38PerUDPTL::e_fec_info && count > udptl.count)
+    udptl.count = 0;
+
+  // the payload is not UDPTL if something is left
+  return strm.IsOK() && strm.Remaining() == 0;
+}
+///////////////////////////////////////////////////////////////
+void T38PerFec::Reset()
+{
+  for (PINDEX i = 0 ; i < historySize ; i++) {
+    seqs[i] = -1;
+    ifps[i].SetSize(0);
+  }
+}
+
+void T38PerFec::Put(long seq, const BYTE *ifp, PINDEX size)
+{
+  if (seq < 0)
+    return;
+
+  PINDEX i = seq % historySize;
+
+  seqs[i] = seq;
+  ifps[i] = PBYTEArray(ifp, size);
+}
+
+const PBYTEArray *T38PerFec::Find(long seq) const
+{
+  if (seq < 0)
+    return NULL;
+
+  PINDEX i = seq % historySize;
+
+  return seqs[i] == seq ? &ifps[i] : NULL;
+}
+
+void T38PerFec::Encode(long seq, int span, int entries, T38PerUDPTL &udptl)
+{
+  if (entries > T38PerUDPTL::maxEntries)
+    entries = T38PerUDPTL::maxEntries;
+
+  if (entries < 1 || span < 1) {
+    span = 0;
+    entries = 0;
+  }
+  else
+  if (span*entries > historySize) {
+    span = historySize/entries;
+  }
+
+  // wind up smoothly at the beginning
+  if (seq < span*entries) {
+    entries = seq/span;
+
+    if (seq < span)
+      span = 0;
+  }
+
+  udptl.recovery = T38PerUDPTL::e_fec_info;
+  udptl.fecNPackets = span;
+  udptl.count = span ? entries : 0;
+
+  for (PINDEX m = 0 ; m < udptl.count ; m++) {
+    PINDEX len = 0;
+
+    for (int k = 1 ; k <= span ; k++) {
+      const PBYTEArray *ifp = Find(seq + m - k*entries);
+
+      if (ifp && len < ifp->GetSize())
+        len = ifp->GetSize();
+    }
+
+    BYTE *out = fec[m].GetPointer(len + 1);
+
+    memset(out, 0, len);
+
+    for (int k = 1 ; k <= span ; k++) {
+      const PBYTEArray *ifp = Find(seq + m - k*entries);
+
+      if (ifp) {
+        for (PINDEX j = 0 ; j < ifp->GetSize() ; j++)
+          out[j] ^= (*ifp)[j];
+      }
+    }
+
+    udptl.entry[m] = out;
+    udptl.entrySize[m] = len;
+  }
+}
+
+PBoolean T38PerFec::Recover(long seq, long udptlSeq, const T38PerUDPTL &udptl, PBYTEArray &ifp) const
+{
+  if (udptl.recovery != T38PerUDPTL::e_fec_info || udptl.fecNPackets < 1 || udptl.count < 1)
+    return FALSE;
+
+  long entries = udptl.count;
+  long span = udptl.fecNPackets;
+  long m = (udptlSeq - seq) % entries;
+
+  if (m)
+    m = entries - m;
+
+  long k = (udptlSeq + m - seq)/entries;
+
+  if (k < 1 || k > span)
+    return FALSE;
+
+  PINDEX len = udptl.entrySize[m];
+
+  if (len == 0)
+    return FALSE;
+
+  // the previous content of ifp may be longer
+  ifp.SetSize(len);
+
+  BYTE *out = ifp.GetPointer();
+
+  memcpy(out, udptl.entry[m], len);
+
+  for (long j = 1 ; j <= span ; j++) {
+    if (j == k)
+      continue;
+
+    long s = udptlSeq + m - j*entries;
+
+    // the sender winds up FEC at the beginning
+    if (s < 0)
+      continue;
+
+    const PBYTEArray *other = Find(s);
+
+    if (!other)
+      return FALSE;
+
+    PINDEX size = other->GetSize();
+
+    // the recovered packets are padded by zeros
+    while (size > len && (*other)[size - 1] == 0)
+      size--;
+
+    if (size > len)
+      return FALSE;
+
+    for (PINDEX i = 0 ; i < size ; i++)
+      out[i] ^= (*other)[i];
+  }
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+
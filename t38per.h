@@ -0,0 +1,172 @@
+/*
+ * t38per.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#ifndef _T38PER_H
+#define _T38PER_H
+
+#include "t38engine.h"
+
+///////////////////////////////////////////////////////////////
+/*
+ * UDPTL packet with the IFP packets referenced to the encoded
+ * buffer.
+ */
+class T38PerUDPTL
+{
+  public:
+    enum {
+      maxEntries = 16
+    };
+
+    enum {
+      e_secondary_ifp_packets,
+      e_fec_info
+    };
+
+    unsigned seq;
+
+    const BYTE *primary;
+    PINDEX primarySize;
+
+    unsigned recovery;
+    int fecNPackets;
+
+    /*
+     * Secondary IFP packets or FEC data (only the first
+     * maxEntries are referenced)
+     */
+    PINDEX count;
+    const BYTE *entry[maxEntries];
+    PINDEX entrySize[maxEntries];
+};
+///////////////////////////////////////////////////////////////
+/*
+ * PER (aligned variant) codec for the T.38 IFP and UDPTL packets.
+ *
+ * It encodes to and decodes from the caller's buffers without
+ * creating temporary ASN objects. The indicator packets and the data
+ * packets with one data field without data are copied from the
+ * pre-encoded cache. It does not support the values
+ * from the extensions, so if the functions fail then the
+ * generic ASN codec should be used.
+ */
+class T38Per
+{
+  public:
+    /*
+     * Returns the length of encoded ifp or 0
+     */
+    static PINDEX EncodeIFP(
+      const T38_IFP &ifp,
+      BYTE *buf,
+      PINDEX size,
+      PBoolean fieldTypeExtendable = T38_FIELD_TYPE_EXTENDABLE
+    );
+
+    static PBoolean DecodeIFP(
+      const BYTE *buf,
+      PINDEX size,
+      T38_IFP &ifp,
+      PBoolean fieldTypeExtendable = T38_FIELD_TYPE_EXTENDABLE
+    );
+
+    /*
+     * Returns the length of encoded udptl or 0
+     */
+    static PINDEX EncodeUDPTL(
+      const T38PerUDPTL &udptl,
+      BYTE *buf,
+      PINDEX size
+    );
+
+    /*
+     * Succeeds only if the whole buf is the udptl packet
+     */
+    static PBoolean DecodeUDPTL(
+      const BYTE *buf,
+      PINDEX size,
+      T38PerUDPTL &udptl
+    );
+};
+///////////////////////////////////////////////////////////////
+/*
+ * History of the encoded IFP packets for the UDPTL FEC error
+ * recovery.
+ *
+ * The FEC entry m of the packet seq is the XOR of the IFP packets
+ * seq + m - k*entries (k = 1, ..., span) padded by zeros to the
+ * longest one, so a lost IFP packet can be recovered if all other
+ * IFP packets of one of the entries are known.
+ */
+class T38PerFec
+{
+  public:
+    enum {
+      historySize = 64
+    };
+
+    T38PerFec() { Reset(); }
+
+    void Reset();
+
+    void Put(
+      long seq,
+      const BYTE *ifp,
+      PINDEX size
+    );
+
+    /*
+     * Fills the fec-info of the udptl packet seq with the entries
+     * referenced to the internal buffers (valid till next call)
+     */
+    void Encode(
+      long seq,
+      int span,
+      int entries,
+      T38PerUDPTL &udptl
+    );
+
+    /*
+     * Recovers the IFP packet seq (padded by zeros) from the fec-info
+     * of the udptl packet udptlSeq
+     */
+    PBoolean Recover(
+      long seq,
+      long udptlSeq,
+      const T38PerUDPTL &udptl,
+      PBYTEArray &ifp
+    ) const;
+
+  protected:
+    const PBYTEArray *Find(long seq) const;
+
+    long seqs[historySize];
+    PBYTEArray ifps[historySize];
+    PBYTEArray fec[T38PerUDPTL::maxEntries];
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _T38PER_H
+
@@ -42,143 +42,235 @@
 #define new PNEW
 
 ///////////////////////////////////////////////////////////////
-#define CNG_HZ                    1100
-#define CNG_MAX_DIV               100
-#define CNG_AMPLITUDE             5000
-#define CNG_ON_MSEC               500
-#define CNG_OFF_MSEC              3000
+#define TONE_AMPLITUDE            5000
 ///////////////////////////////////////////////////////////////
-#define CED_HZ                    2100
-#define CED_MAX_DIV               100
-#define CED_AMPLITUDE             5000
-#define CED_ON_MSEC               3500
-///////////////////////////////////////////////////////////////
-#define RING_RU_HZ                425
-#define RING_RU_MAX_DIV           25
-#define RING_RU_AMPLITUDE         5000
-#define RING_RU_ON_MSEC           1000
-#define RING_RU_OFF_MSEC          4000
-///////////////////////////////////////////////////////////////
-#define BUSY_RU_HZ                425
-#define BUSY_RU_MAX_DIV           25
-#define BUSY_RU_AMPLITUDE         5000
-#define BUSY_RU_ON_MSEC           350
-#define BUSY_RU_OFF_MSEC          350
+#define CNG_SPEC                  "!0/1000,1100/500,0/3000"   // begin with 1 sec silence
+#define CED_SPEC                  "!0/200,!2100/3500,0"       // begin with 200 ms silence
 ///////////////////////////////////////////////////////////////
 typedef	PInt16                    SIMPLE_TYPE;
 #define BYTES_PER_SIMPLE          sizeof(SIMPLE_TYPE)
 #define SIMPLES_PER_SEC           8000
 ///////////////////////////////////////////////////////////////
 #define TWO_PI                    (3.1415926535897932384626433832795029L*2)
+///////////////////////////////////////////////////////////////
+static const struct {
+  const char *country;
+  const char *ring;
+  const char *busy;
+} countries[] = {
+  { "ru", "425/1000,0/4000",                        "425/350,0/350" },    // default
+  { "au", "400+450/400,0/200,400+450/400,0/2000",   "425/375,0/375" },
+  { "de", "425/1000,0/4000",                        "425/480,0/480" },
+  { "fr", "440/1500,0/3500",                        "440/500,0/500" },
+  { "gb", "400+450/400,0/200,400+450/400,0/2000",   "400/375,0/375" },
+  { "it", "425/1000,0/4000",                        "425/500,0/500" },
+  { "nl", "425/1000,0/4000",                        "425/500,0/500" },
+  { "us", "440+480/2000,0/4000",                    "480+620/500,0/500" },
+};
 
-static PBoolean InitTone(const void *, BYTE *pTone, size_t amount, unsigned hz, SIMPLE_TYPE ampl)
+static const char *GetSpec(ToneGenerator::ToneType tt, PINDEX country)
 {
-  for( size_t i = 0 ; i < amount/BYTES_PER_SIMPLE ; i++ ) {
-    double Sin = sin(double((hz*TWO_PI*i)/SIMPLES_PER_SEC));
-    ((SIMPLE_TYPE *)pTone)[i] = (SIMPLE_TYPE)(Sin * ampl);
+  switch (tt) {
+    case ToneGenerator::ttCng:    return CNG_SPEC;
+    case ToneGenerator::ttCed:    return CED_SPEC;
+    case ToneGenerator::ttRing:   return countries[country].ring;
+    case ToneGenerator::ttBusy:   return countries[country].busy;
+    default:                      break;
   }
 
-  return TRUE;
+  return "0";
+}
+
+static const char *GetName(ToneGenerator::ToneType tt)
+{
+  switch (tt) {
+    case ToneGenerator::ttCng:    return "cng";
+    case ToneGenerator::ttCed:    return "ced";
+    case ToneGenerator::ttRing:   return "ring";
+    case ToneGenerator::ttBusy:   return "busy";
+    default:                      break;
+  }
+
+  return "silence";
 }
 ///////////////////////////////////////////////////////////////
-#define MSEC2BYTES(ms)            (((SIMPLES_PER_SEC*(ms))/1000)*BYTES_PER_SIMPLE)
-#define MAX_DIV2BYTES(maxdiv)     ((SIMPLES_PER_SEC/(maxdiv))*BYTES_PER_SIMPLE)
-///////////////////////////////////////////////////////////////
-ToneGenerator::ToneGenerator(ToneGenerator::ToneType tt)
+ToneGenerator::ToneGenerator(ToneGenerator::ToneType tt, const PString &plan)
   : type(tt)
-  , index(0)
 {
-  switch(tt) {
-    case ttCng: {
-      static BYTE toneOn[MAX_DIV2BYTES(CNG_MAX_DIV)];
-      static const PBoolean initTone = InitTone(&initTone, toneOn, sizeof(toneOn), CNG_HZ, CNG_AMPLITUDE);
-
-      bytesOn = MSEC2BYTES(CNG_ON_MSEC);
-      bytesOff = MSEC2BYTES(CNG_OFF_MSEC);
-      pToneOn = toneOn;
-      bytesToneOn = sizeof(toneOn);
-
-      // begin with 1 sec silence
-      #if CNG_OFF_MSEC < 1000
-        #error CNG_OFF_MSEC < 1000
-      #endif
-      index = bytesOn + bytesOff - MSEC2BYTES(1000);
-      break;
-    }
-    case ttCed: {
-      static BYTE toneOn[MAX_DIV2BYTES(CED_MAX_DIV)];
-      static const PBoolean initTone = InitTone(&initTone, toneOn, sizeof(toneOn), CED_HZ, CED_AMPLITUDE);
+  PString spec = GetSpec(tt, 0);
+  PStringArray items = plan.Tokenise(";", FALSE);
 
-      bytesOn = MSEC2BYTES(CED_ON_MSEC);
-      bytesOff = (P_MAX_INDEX/BYTES_PER_SIMPLE)*BYTES_PER_SIMPLE - bytesOn;
-      pToneOn = toneOn;
-      bytesToneOn = sizeof(toneOn);
+  for (PINDEX i = 0 ; i < items.GetSize() ; i++) {
+    PString item = items[i].Trim();
 
-      // begin with 200 ms silence
-      index = bytesOn + bytesOff - MSEC2BYTES(200);
-      break;
+    if (item.IsEmpty())
+      continue;
+
+    PINDEX eq = item.Find('=');
+
+    if (eq == P_MAX_INDEX) {
+      PINDEX c;
+
+      for (c = 0 ; c < PINDEX(sizeof(countries)/sizeof(countries[0])) ; c++) {
+        if (item *= countries[c].country) {
+          spec = GetSpec(tt, c);
+          break;
+        }
+      }
+
+      if (c >= PINDEX(sizeof(countries)/sizeof(countries[0])))
+        myPTRACE(1, "ToneGenerator: unknown country " << item);
+    } else
+    if (item.Left(eq).Trim() *= GetName(tt)) {
+      spec = item.Mid(eq + 1).Trim();
     }
-    case ttRing: {
-      static BYTE toneOn[MAX_DIV2BYTES(RING_RU_MAX_DIV)];
-      static const PBoolean initTone = InitTone(&initTone, toneOn, sizeof(toneOn), RING_RU_HZ, RING_RU_AMPLITUDE);
-
-      bytesOn = MSEC2BYTES(RING_RU_ON_MSEC);
-      bytesOff = MSEC2BYTES(RING_RU_OFF_MSEC);
-      pToneOn = toneOn;
-      bytesToneOn = sizeof(toneOn);
-      break;
+  }
+
+  if (!Parse(spec)) {
+    myPTRACE(1, "ToneGenerator: wrong " << GetName(tt) << " spec " << spec);
+    Parse(GetSpec(tt, 0));
+  }
+
+  for (int f = 0 ; f < maxFreqs ; f++) {
+    re[f] = 1;
+    im[f] = 0;
+  }
+}
+
+PString ToneGenerator::GetCountries()
+{
+  PString res;
+
+  for (PINDEX c = 0 ; c < PINDEX(sizeof(countries)/sizeof(countries[0])) ; c++) {
+    if (c)
+      res += ", ";
+
+    res += countries[c].country;
+  }
+
+  return res;
+}
+
+PBoolean ToneGenerator::Parse(const PString &spec)
+{
+  PStringArray segs = spec.Tokenise(",", FALSE);
+
+  numSegments = 0;
+
+  for (PINDEX i = 0 ; i < segs.GetSize() ; i++) {
+    if (numSegments >= maxSegments)
+      return FALSE;
+
+    Segment &seg = segments[numSegments++];
+    PString str = segs[i].Trim();
+
+    seg.once = (str.Left(1) == "!");
+
+    if (seg.once)
+      str = str.Mid(1);
+
+    PINDEX slash = str.Find('/');
+
+    seg.simples = (slash == P_MAX_INDEX) ? 0 : PINDEX((str.Mid(slash + 1).AsUnsigned()*SIMPLES_PER_SEC)/1000);
+
+    PStringArray hzs = str.Left(slash).Tokenise("+", FALSE);
+
+    seg.freqs = 0;
+
+    for (PINDEX j = 0 ; j < hzs.GetSize() ; j++) {
+      unsigned hz = hzs[j].AsUnsigned();
+
+      if (hz == 0)
+        continue;
+
+      if (hz >= SIMPLES_PER_SEC/2 || seg.freqs >= maxFreqs)
+        return FALSE;
+
+      seg.cosw[seg.freqs] = cos(double((hz*TWO_PI)/SIMPLES_PER_SEC));
+      seg.sinw[seg.freqs] = sin(double((hz*TWO_PI)/SIMPLES_PER_SEC));
+      seg.freqs++;
     }
-    case ttBusy: {
-      static BYTE toneOn[MAX_DIV2BYTES(BUSY_RU_MAX_DIV)];
-      static const PBoolean initTone = InitTone(&initTone, toneOn, sizeof(toneOn), BUSY_RU_HZ, BUSY_RU_AMPLITUDE);
-
-      bytesOn = MSEC2BYTES(BUSY_RU_ON_MSEC);
-      bytesOff = MSEC2BYTES(BUSY_RU_OFF_MSEC);
-      pToneOn = toneOn;
-      bytesToneOn = sizeof(toneOn);
-      break;
+
+    seg.amplitude = seg.freqs ? double(TONE_AMPLITUDE)/seg.freqs : 0;
+  }
+
+  segment = 0;
+  repeating = FALSE;
+  index = 0;
+
+  return numSegments > 0;
+}
+
+void ToneGenerator::NextSegment()
+{
+  index = 0;
+
+  for (int skipped = 0 ; skipped <= numSegments ; skipped++) {
+    if (++segment >= numSegments) {
+      segment = 0;
+      repeating = TRUE;
     }
-    default:
-      bytesOn = 0;
-      bytesOff = (P_MAX_INDEX/BYTES_PER_SIMPLE)*BYTES_PER_SIMPLE - bytesOn;
-      pToneOn = NULL;
-      bytesToneOn = 0;
+
+    if (!repeating || !segments[segment].once)
+      return;
   }
+
+  // all segments are played once
+  segment = numSegments;
 }
 
 void ToneGenerator::Read(void * buffer, PINDEX amount)
 {
-  BYTE *pBuf = (BYTE *)buffer;
-  PINDEX bytesOnOff = bytesOn + bytesOff;
-
-  while(amount) {
-    if (index >= bytesOnOff)
-      index = 0;
+  SIMPLE_TYPE *pBuf = (SIMPLE_TYPE *)buffer;
+  PINDEX count = amount/BYTES_PER_SIMPLE;
 
-    PINDEX len;
+  memset(pBuf + count, 0, amount%BYTES_PER_SIMPLE);
 
-    if (bytesOn > index) {
-      PINDEX i = index % bytesToneOn;
+  while (count > 0) {
+    if (segment >= numSegments) {
+      memset(pBuf, 0, count*BYTES_PER_SIMPLE);
+      break;
+    }
 
-      len = bytesToneOn - i;
+    const Segment &seg = segments[segment];
+    PINDEX len = count;
 
-      if (len > amount)
-        len = amount;
+    if (seg.simples && len > seg.simples - index)
+      len = seg.simples - index;
 
-      memcpy(pBuf, pToneOn + i, len);
+    if (seg.freqs == 0) {
+      memset(pBuf, 0, len*BYTES_PER_SIMPLE);
     } else {
-      len = bytesOnOff - index;
+      for (PINDEX i = 0 ; i < len ; i++) {
+        double val = 0;
+
+        for (int f = 0 ; f < seg.freqs ; f++) {
+          double r = re[f]*seg.cosw[f] - im[f]*seg.sinw[f];
+
+          im[f] = re[f]*seg.sinw[f] + im[f]*seg.cosw[f];
+          re[f] = r;
+          val += im[f];
+        }
 
-      if (len > amount)
-        len = amount;
+        pBuf[i] = (SIMPLE_TYPE)(val*seg.amplitude);
+      }
 
-      memset(pBuf, 0, len);
+      // compensate the rounding drift of the amplitude
+
+      for (int f = 0 ; f < seg.freqs ; f++) {
+        double k = (3 - re[f]*re[f] - im[f]*im[f])/2;
+
+        re[f] *= k;
+        im[f] *= k;
+      }
     }
 
     pBuf += len;
-    amount -= len;
+    count -= len;
     index += len;
+
+    if (seg.simples && index >= seg.simples)
+      NextSegment();
   }
 }
 ///////////////////////////////////////////////////////////////
-
@@ -36,6 +36,28 @@
 #define _TONE_GEN_H
 
 ///////////////////////////////////////////////////////////////
+/*
+ * Generator of the call progress and fax tones.
+ *
+ * The tones are generated by the recursive oscillators (up to two
+ * frequencies per tone) with the phase continuity across the Read()
+ * calls.
+ *
+ * The tone plan is a list of items separated by ';'. An item is a
+ * country code (see ToneGenerator::GetCountries()) or tone=spec,
+ * where tone is cng, ced, ring or busy and spec is a list of
+ * segments separated by ',':
+ *
+ *   [!]hz[+hz][/ms]
+ *
+ * The hz 0 is silence, the segment without ms lasts forever and the
+ * segment with prefix ! is not repeated (as in indications.conf of
+ * Asterisk). For example:
+ *
+ *   us
+ *   de;busy=425/480,0/480
+ *   ring=400+450/400,0/200,400+450/400,0/2000
+ */
 class ToneGenerator : public PObject
 {
   PCLASSINFO(ToneGenerator, PObject);
@@ -50,17 +72,41 @@ class ToneGenerator : public PObject
       ttBusy,
     };
 
-    ToneGenerator(ToneType tt = ttSilence);
+    ToneGenerator(ToneType tt = ttSilence, const PString &plan = PString());
     void Read(void * buffer, PINDEX amount);
     ToneType Type() const { return type; }
 
+    static PString GetCountries();
+
   protected:
+
+    PBoolean Parse(const PString &spec);
+    void NextSegment();
+
+    enum {
+      maxSegments = 8,
+      maxFreqs = 2,
+    };
+
+    struct Segment {
+      PBoolean once;
+      PINDEX simples;           // 0 - forever
+      int freqs;                // 0 - silence
+      double cosw[maxFreqs];
+      double sinw[maxFreqs];
+      double amplitude;
+    };
+
     ToneType type;
-    PINDEX bytesOn;
-    PINDEX bytesOff;
-    const BYTE *pToneOn;
-    PINDEX bytesToneOn;
-    PINDEX index;
+    Segment segments[maxSegments];
+    int numSegments;
+    int segment;                // numSegments - finished
+    PBoolean repeating;
+    PINDEX index;               // simples of the current segment
+
+    // oscillators
+    double re[maxFreqs];
+    double im[maxFreqs];
 };
 ///////////////////////////////////////////////////////////////
 
@@ -0,0 +1,157 @@
+/*
+ * vcml.cxx
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#include <ptlib.h>
+#include "vcml.h"
+
+///////////////////////////////////////////////////////////////
+#include "g711.c"
+///////////////////////////////////////////////////////////////
+
+#define new PNEW
+
+///////////////////////////////////////////////////////////////
+static PInt16 ulawDecode[256];
+static PInt16 alawDecode[256];
+static BYTE ulawEncode[0x10000 >> 2];     // by linear >> 2
+static BYTE alawEncode[0x10000 >> 3];     // by linear >> 3
+
+static PBoolean InitTables(const void *)
+{
+  int i;
+
+  for (i = 0 ; i < 256 ; i++) {
+    ulawDecode[i] = (PInt16)ulaw2linear(i);
+    alawDecode[i] = (PInt16)alaw2linear(i);
+  }
+
+  for (i = 0 ; i < int(sizeof(ulawEncode)) ; i++)
+    ulawEncode[i] = (BYTE)linear2ulaw((i - int(sizeof(ulawEncode)/2)) << 2);
+
+  for (i = 0 ; i < int(sizeof(alawEncode)) ; i++)
+    alawEncode[i] = (BYTE)linear2alaw((i - int(sizeof(alawEncode)/2)) << 3);
+
+  return TRUE;
+}
+///////////////////////////////////////////////////////////////
+enum {
+  fmtLinear,      // 8-bit signed linear
+  fmtULinear,     // 8-bit unsigned linear
+  fmtULaw,
+  fmtALaw,
+};
+
+template <int fmt> struct Format;
+
+template <> struct Format<fmtLinear> {
+  static PInt16 Decode(BYTE b) { return (PInt16)((PInt16)(signed char)b*256); }
+  static BYTE Encode(PInt16 s) { return (BYTE)(s/256); }
+};
+
+template <> struct Format<fmtULinear> {
+  static PInt16 Decode(BYTE b) { return (PInt16)(b*256 - 0x8000); }
+  static BYTE Encode(PInt16 s) { return (BYTE)((s + 0x8000)/256); }
+};
+
+template <> struct Format<fmtULaw> {
+  static PInt16 Decode(BYTE b) { return ulawDecode[b]; }
+  static BYTE Encode(PInt16 s) { return ulawEncode[(s >> 2) + int(sizeof(ulawEncode)/2)]; }
+};
+
+template <> struct Format<fmtALaw> {
+  static PInt16 Decode(BYTE b) { return alawDecode[b]; }
+  static BYTE Encode(PInt16 s) { return alawEncode[(s >> 3) + int(sizeof(alawEncode)/2)]; }
+};
+
+template <int fmt> static PINDEX DecodeKernel(const BYTE *pb, PInt16 *ps, PINDEX count)
+{
+  for (PINDEX i = 0 ; i < count ; i++)
+    ps[i] = Format<fmt>::Decode(pb[i]);
+
+  return count;
+}
+
+template <int fmt> static PINDEX EncodeKernel(const PInt16 *ps, BYTE *pb, PINDEX count)
+{
+  // pb can be the same buffer as ps (it's not ahead of ps)
+  for (PINDEX i = 0 ; i < count ; i++)
+    pb[i] = Format<fmt>::Encode(ps[i]);
+
+  return count;
+}
+
+static PINDEX DecodeNone(const BYTE *, PInt16 *, PINDEX)
+{
+  return 0;
+}
+
+static PINDEX EncodeNone(const PInt16 *, BYTE *, PINDEX)
+{
+  return 0;
+}
+///////////////////////////////////////////////////////////////
+VcmlCodec::VcmlCodec()
+  : cml(-1)
+  , decode(DecodeNone)
+  , encode(EncodeNone)
+{
+  static const PBoolean initTables = InitTables(&initTables);
+}
+
+void VcmlCodec::Select(int _cml)
+{
+  if (cml == _cml)
+    return;
+
+  cml = _cml;
+
+  switch (cml) {
+    case 0:
+      decode = DecodeKernel<fmtLinear>;
+      encode = EncodeKernel<fmtLinear>;
+      break;
+    case 1:
+    case 128:
+    case 130:
+      decode = DecodeKernel<fmtULinear>;
+      encode = EncodeKernel<fmtULinear>;
+      break;
+    case 4:
+    case 131:
+      decode = DecodeKernel<fmtULaw>;
+      encode = EncodeKernel<fmtULaw>;
+      break;
+    case 5:
+    case 132:
+      decode = DecodeKernel<fmtALaw>;
+      encode = EncodeKernel<fmtALaw>;
+      break;
+    default:
+      decode = DecodeNone;
+      encode = EncodeNone;
+  }
+}
+///////////////////////////////////////////////////////////////
+
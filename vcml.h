@@ -0,0 +1,72 @@
+/*
+ * vcml.h
+ *
+ * T38FAX Pseudo Modem
+ *
+ * Open H323 Project
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.0 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS"
+ * basis, WITHOUT WARRANTY OF ANY KIND, either express or implied. See
+ * the License for the specific language governing rights and limitations
+ * under the License.
+ *
+ * The Original Code is Open H323 Library.
+ *
+ * The Initial Developer of the Original Code is Vyacheslav Frolov
+ *
+ * Contributor(s):
+ *
+ */
+
+#ifndef _VCML_H
+#define _VCML_H
+
+///////////////////////////////////////////////////////////////
+/*
+ * Conversion of the voice samples between 16-bit linear and the
+ * +VSM compression method (8-bit signed or unsigned linear, u-law,
+ * A-law).
+ *
+ * The kernel of each method is instantiated from a template by the
+ * sample format and selected once per the method change. The u-law
+ * and A-law kernels use the lookup tables built from g711.c.
+ */
+class VcmlCodec
+{
+  public:
+    VcmlCodec();
+
+    /*
+     * Selects the kernels for the compression method cml
+     */
+    void Select(int cml);
+
+    /*
+     * Return the count of converted samples (0 if the method is
+     * not supported)
+     */
+    PINDEX Decode(const BYTE *pb, PInt16 *ps, PINDEX count) const {
+      return decode(pb, ps, count);
+    }
+
+    PINDEX Encode(const PInt16 *ps, BYTE *pb, PINDEX count) const {
+      return encode(ps, pb, count);
+    }
+
+  protected:
+    typedef PINDEX (*DecodeFunc)(const BYTE *pb, PInt16 *ps, PINDEX count);
+    typedef PINDEX (*EncodeFunc)(const PInt16 *ps, BYTE *pb, PINDEX count);
+
+    int cml;
+    DecodeFunc decode;
+    EncodeFunc encode;
+};
+///////////////////////////////////////////////////////////////
+
+#endif  // _VCML_H
+